@@ -0,0 +1,191 @@
+#include "concurrent_request_queue.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <thread>
+
+
+using namespace std::string_literals;
+
+static const uint64_t RESETTING = UINT64_MAX;
+
+// Threads take stripes in turn, the first time they record
+static std::atomic<size_t> next_thread_stripe{0};
+static thread_local const size_t thread_stripe = next_thread_stripe.fetch_add(1, std::memory_order_relaxed);
+
+ConcurrentRequestQueue::ConcurrentRequestQueue(const SearchServer& search_server, const ConcurrentRequestQueueOptions& options)
+    : search_server_(search_server)
+    , start_time_(std::chrono::steady_clock::now())
+    , bucket_duration_(options.bucket_duration) {
+    if (options.bucket_duration.count() <= 0 || options.bucket_count == 0) {
+        throw std::invalid_argument("bucket duration and count must be positive"s);
+    }
+    const size_t stripe_count = options.stripe_count != 0
+            ? options.stripe_count
+            : std::max<size_t>(1, std::thread::hardware_concurrency());
+    stripes_ = std::vector<Stripe>(stripe_count);
+    for (Stripe& stripe : stripes_) {
+        stripe.buckets = std::vector<Bucket>(options.bucket_count);
+    }
+}
+
+std::vector<Document> ConcurrentRequestQueue::AddFindRequest(const std::string& raw_query, DocumentStatus status) {
+    const auto start_time = std::chrono::steady_clock::now();
+    std::vector<Document> result = search_server_.FindTopDocuments(raw_query, status);
+    Record(result.size(), std::chrono::steady_clock::now() - start_time);
+    return result;
+}
+
+std::vector<Document> ConcurrentRequestQueue::AddFindRequest(const std::string& raw_query) {
+    return AddFindRequest(raw_query, DocumentStatus::ACTUAL);
+}
+
+void ConcurrentRequestQueue::Record(size_t result_count, std::chrono::nanoseconds latency) {
+    const uint64_t period = GetPeriod(std::chrono::steady_clock::now());
+    std::vector<Bucket>& buckets = stripes_[thread_stripe % stripes_.size()].buckets;
+    Bucket& bucket = buckets[period % buckets.size()];
+    uint64_t bucket_period = bucket.period.load(std::memory_order_acquire);
+    while (bucket_period != period + 1) {
+        if (bucket_period == RESETTING) {
+            std::this_thread::yield();
+            bucket_period = bucket.period.load(std::memory_order_acquire);
+            continue;
+        }
+        if (bucket_period > period + 1) {
+            // the thread was preempted for the whole ring, the period is gone
+            return;
+        }
+        // the bucket still counts an old period, whoever swaps it clears it
+        if (bucket.period.compare_exchange_weak(bucket_period, RESETTING, std::memory_order_acquire)) {
+            bucket.request_count.store(0, std::memory_order_relaxed);
+            bucket.no_result_count.store(0, std::memory_order_relaxed);
+            for (std::atomic<uint64_t>& count : bucket.result_counts) {
+                count.store(0, std::memory_order_relaxed);
+            }
+            for (std::atomic<uint64_t>& count : bucket.latencies) {
+                count.store(0, std::memory_order_relaxed);
+            }
+            bucket_period = period + 1;
+            bucket.period.store(bucket_period, std::memory_order_release);
+        }
+    }
+    bucket.request_count.fetch_add(1, std::memory_order_relaxed);
+    if (result_count == 0) {
+        bucket.no_result_count.fetch_add(1, std::memory_order_relaxed);
+    }
+    bucket.result_counts[std::min(result_count, RESULT_COUNT_BIN_COUNT - 1)].fetch_add(1, std::memory_order_relaxed);
+    bucket.latencies[GetLatencyBin(latency)].fetch_add(1, std::memory_order_relaxed);
+}
+
+int ConcurrentRequestQueue::GetNoResultRequests() const {
+    return static_cast<int>(GetStats().no_result_count);
+}
+
+RequestQueueStats ConcurrentRequestQueue::GetStats(std::chrono::nanoseconds window) const {
+    if (window.count() <= 0) {
+        throw std::invalid_argument("window must be positive"s);
+    }
+    const auto now = std::chrono::steady_clock::now();
+    const uint64_t last_period = GetPeriod(now);
+    const size_t bucket_count = stripes_.front().buckets.size();
+    // the current period is counted as a whole, it holds the latest requests
+    const uint64_t period_count = std::min<uint64_t>({
+        static_cast<uint64_t>(window / bucket_duration_ + (window % bucket_duration_ != std::chrono::nanoseconds(0))),
+        bucket_count,
+        last_period + 1
+    });
+    const uint64_t first_period = last_period + 1 - period_count;
+
+    RequestQueueStats stats;
+    stats.result_count_histogram.assign(RESULT_COUNT_BIN_COUNT, 0);
+    std::vector<uint64_t> latencies(LATENCY_BIN_COUNT, 0);
+    std::vector<uint64_t> result_counts(RESULT_COUNT_BIN_COUNT);
+    std::vector<uint64_t> bucket_latencies(LATENCY_BIN_COUNT);
+    for (const Stripe& stripe : stripes_) {
+        for (uint64_t period = first_period; period <= last_period; ++period) {
+            const Bucket& bucket = stripe.buckets[period % bucket_count];
+            if (bucket.period.load(std::memory_order_acquire) != period + 1) {
+                continue;
+            }
+            const uint64_t request_count = bucket.request_count.load(std::memory_order_relaxed);
+            const uint64_t no_result_count = bucket.no_result_count.load(std::memory_order_relaxed);
+            for (size_t i = 0; i < RESULT_COUNT_BIN_COUNT; ++i) {
+                result_counts[i] = bucket.result_counts[i].load(std::memory_order_relaxed);
+            }
+            for (size_t i = 0; i < LATENCY_BIN_COUNT; ++i) {
+                bucket_latencies[i] = bucket.latencies[i].load(std::memory_order_relaxed);
+            }
+            // skipped if the bucket was taken for a new period meanwhile
+            if (bucket.period.load(std::memory_order_acquire) != period + 1) {
+                continue;
+            }
+            stats.request_count += request_count;
+            stats.no_result_count += no_result_count;
+            for (size_t i = 0; i < RESULT_COUNT_BIN_COUNT; ++i) {
+                stats.result_count_histogram[i] += result_counts[i];
+            }
+            for (size_t i = 0; i < LATENCY_BIN_COUNT; ++i) {
+                latencies[i] += bucket_latencies[i];
+            }
+        }
+    }
+
+    stats.window = std::min<std::chrono::nanoseconds>(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(now - start_time_),
+            bucket_duration_ * static_cast<int64_t>(period_count));
+    if (stats.window.count() > 0) {
+        stats.requests_per_second = stats.request_count / std::chrono::duration<double>(stats.window).count();
+    }
+    if (stats.request_count == 0) {
+        return stats;
+    }
+    stats.no_result_rate = static_cast<double>(stats.no_result_count) / stats.request_count;
+    // the bin where the requests up to the rank end
+    auto get_percentile = [&latencies, &stats](double share) {
+        const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(share * stats.request_count + 0.5));
+        uint64_t request_count = 0;
+        for (size_t bin = 0; bin < LATENCY_BIN_COUNT; ++bin) {
+            request_count += latencies[bin];
+            if (request_count >= rank) {
+                return GetLatencyBinBound(bin);
+            }
+        }
+        return GetLatencyBinBound(LATENCY_BIN_COUNT - 1);
+    };
+    stats.latency_p50 = get_percentile(0.5);
+    stats.latency_p90 = get_percentile(0.9);
+    stats.latency_p99 = get_percentile(0.99);
+    stats.latency_max = get_percentile(1.0);
+    return stats;
+}
+
+RequestQueueStats ConcurrentRequestQueue::GetStats() const {
+    return GetStats(bucket_duration_ * static_cast<int64_t>(stripes_.front().buckets.size()));
+}
+
+uint64_t ConcurrentRequestQueue::GetPeriod(std::chrono::steady_clock::time_point time) const {
+    return static_cast<uint64_t>((time - start_time_) / bucket_duration_);
+}
+
+// Below 4 us a bin per microsecond, then four bins per octave
+size_t ConcurrentRequestQueue::GetLatencyBin(std::chrono::nanoseconds latency) {
+    const uint64_t microseconds = static_cast<uint64_t>(std::max<int64_t>(0,
+            std::chrono::duration_cast<std::chrono::microseconds>(latency).count()));
+    if (microseconds < 4) {
+        return static_cast<size_t>(microseconds);
+    }
+    size_t octave = 0;
+    while ((microseconds >> (octave + 1)) != 0) {
+        ++octave;
+    }
+    const size_t quarter = static_cast<size_t>((microseconds >> (octave - 2)) & 3);
+    return std::min(4 * (octave - 1) + quarter, LATENCY_BIN_COUNT - 1);
+}
+
+std::chrono::microseconds ConcurrentRequestQueue::GetLatencyBinBound(size_t bin) {
+    if (bin < 4) {
+        return std::chrono::microseconds(bin + 1);
+    }
+    const size_t octave = bin / 4 + 1;
+    return std::chrono::microseconds(static_cast<int64_t>(5 + bin % 4) << (octave - 2));
+}
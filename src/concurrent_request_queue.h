@@ -0,0 +1,109 @@
+#pragma once
+
+#include "document.h"
+#include "search_server.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+struct ConcurrentRequestQueueOptions {
+    // Requests are counted in periods of bucket_duration, the last bucket_count
+    // of them are kept, which bounds the longest window of the statistics.
+    // A bucket takes about 1 KB in every stripe
+    std::chrono::milliseconds bucket_duration{1000};
+    size_t bucket_count = 300;
+    // Separate sets of buckets, a thread records into one of them;
+    // 0 for std::thread::hardware_concurrency()
+    size_t stripe_count = 0;
+};
+
+struct RequestQueueStats {
+    // The time the statistics cover, shorter than asked while the queue is young
+    std::chrono::nanoseconds window{0};
+    uint64_t request_count = 0;
+    uint64_t no_result_count = 0;
+    double requests_per_second = 0.0;
+    // Share of the requests without results
+    double no_result_rate = 0.0;
+    // [i] is the number of requests with i results, the last element also
+    // counts the requests with more
+    std::vector<uint64_t> result_count_histogram;
+    // Upper bounds of the latencies, accurate to a quarter of an octave
+    std::chrono::microseconds latency_p50{0};
+    std::chrono::microseconds latency_p90{0};
+    std::chrono::microseconds latency_p99{0};
+    std::chrono::microseconds latency_max{0};
+};
+
+// RequestQueue for many query threads, which keeps statistics over wall-clock
+// windows. A thread records into its own stripe of buckets with relaxed atomic
+// increments, a bucket is reused for a new period by the thread which first
+// records into it, so no lock is taken on either side. GetStats sums the
+// buckets of the window over all stripes
+class ConcurrentRequestQueue {
+public:
+    // Throws std::invalid_argument for a zero bucket duration or count
+    explicit ConcurrentRequestQueue(const SearchServer& search_server, const ConcurrentRequestQueueOptions& options = {});
+
+    ConcurrentRequestQueue(const ConcurrentRequestQueue&) = delete;
+
+    ConcurrentRequestQueue& operator=(const ConcurrentRequestQueue&) = delete;
+
+    template <typename DocumentPredicate>
+    std::vector<Document> AddFindRequest(const std::string& raw_query, DocumentPredicate document_predicate) {
+        const auto start_time = std::chrono::steady_clock::now();
+        std::vector<Document> result = search_server_.FindTopDocuments(raw_query, document_predicate);
+        Record(result.size(), std::chrono::steady_clock::now() - start_time);
+        return result;
+    }
+
+    std::vector<Document> AddFindRequest(const std::string& raw_query, DocumentStatus status);
+
+    std::vector<Document> AddFindRequest(const std::string& raw_query);
+
+    // Counts a request served another way, e.g. with a prepared query
+    void Record(size_t result_count, std::chrono::nanoseconds latency);
+
+    // Requests without results within the longest window
+    int GetNoResultRequests() const;
+
+    // Throws std::invalid_argument for a window which isn't positive,
+    // a window longer than the buckets keep is cut down to them
+    RequestQueueStats GetStats(std::chrono::nanoseconds window) const;
+
+    RequestQueueStats GetStats() const;
+
+private:
+    static const size_t RESULT_COUNT_BIN_COUNT = MAX_RESULT_DOCUMENT_COUNT + 1;
+    // four per octave of microseconds, the last one counts everything from about two minutes
+    static const size_t LATENCY_BIN_COUNT = 104;
+
+    struct Bucket {
+        // the period counted plus one, 0 before the first use, RESETTING while it is cleared
+        std::atomic<uint64_t> period{0};
+        std::atomic<uint64_t> request_count{0};
+        std::atomic<uint64_t> no_result_count{0};
+        std::atomic<uint64_t> result_counts[RESULT_COUNT_BIN_COUNT] = {};
+        std::atomic<uint64_t> latencies[LATENCY_BIN_COUNT] = {};
+    };
+
+    struct alignas(64) Stripe {
+        std::vector<Bucket> buckets;
+    };
+
+    const SearchServer& search_server_;
+    const std::chrono::steady_clock::time_point start_time_;
+    const std::chrono::nanoseconds bucket_duration_;
+    std::vector<Stripe> stripes_;
+
+    uint64_t GetPeriod(std::chrono::steady_clock::time_point time) const;
+
+    static size_t GetLatencyBin(std::chrono::nanoseconds latency);
+
+    static std::chrono::microseconds GetLatencyBinBound(size_t bin);
+};
@@ -0,0 +1,65 @@
+#include "concurrent_search_server.h"
+
+#include <utility>
+
+
+ConcurrentSearchServer::ConcurrentSearchServer(SearchServer server)
+    : working_(std::move(server)) {
+    published_.store(new SearchServer(working_));
+}
+
+ConcurrentSearchServer::~ConcurrentSearchServer() {
+    EpochDomain::Instance().Retire(published_.load());
+}
+
+std::vector<Document> ConcurrentSearchServer::FindTopDocuments(std::string_view raw_query, DocumentStatus status,
+        size_t limit, size_t offset) const {
+    return Read([raw_query, status, limit, offset](const SearchServer& server) {
+        return server.FindTopDocuments(raw_query, status, limit, offset);
+    });
+}
+
+std::vector<Document> ConcurrentSearchServer::FindTopDocuments(std::string_view raw_query) const {
+    return FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
+}
+
+std::tuple<std::vector<std::string_view>, DocumentStatus> ConcurrentSearchServer::MatchDocument(
+        std::string_view raw_query, int document_id) const {
+    // the words are views into the query and into the dictionary shared by all versions
+    return Read([raw_query, document_id](const SearchServer& server) {
+        return server.MatchDocument(raw_query, document_id);
+    });
+}
+
+int ConcurrentSearchServer::GetDocumentCount() const {
+    return Read([](const SearchServer& server) {
+        return server.GetDocumentCount();
+    });
+}
+
+void ConcurrentSearchServer::AddDocument(int document_id, std::string_view document, DocumentStatus status,
+        const std::vector<int>& ratings) {
+    std::lock_guard lock(writer_mutex_);
+    working_.AddDocument(document_id, document, status, ratings);
+}
+
+IndexingStats ConcurrentSearchServer::AddDocuments(const std::vector<RawDocument>& documents) {
+    std::lock_guard lock(writer_mutex_);
+    return working_.AddDocuments(std::execution::par, documents);
+}
+
+void ConcurrentSearchServer::RemoveDocument(int document_id) {
+    std::lock_guard lock(writer_mutex_);
+    working_.RemoveDocument(document_id);
+}
+
+void ConcurrentSearchServer::RemoveDocuments(const std::vector<int>& document_ids) {
+    std::lock_guard lock(writer_mutex_);
+    working_.RemoveDocuments(std::execution::par, document_ids);
+}
+
+void ConcurrentSearchServer::Publish() {
+    std::lock_guard lock(writer_mutex_);
+    const SearchServer* version = new SearchServer(working_);
+    EpochDomain::Instance().Retire(published_.exchange(version));
+}
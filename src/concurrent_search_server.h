@@ -0,0 +1,92 @@
+#pragma once
+
+#include "document.h"
+#include "epoch_domain.h"
+#include "search_server.h"
+
+#include <atomic>
+#include <mutex>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+
+// SearchServer for concurrent readers and writers. Readers search the last
+// published version of the index without locks; writers are serialized and change
+// a working copy, which becomes visible to readers on Publish(). A replaced version
+// is deleted by epoch-based reclamation once the readers which still see it leave.
+// Versions share the postings, the term bytes and the word lists, and the tables
+// of the index chunk by chunk; a writer copies only the chunks and the posting
+// lists it modifies, so an idle server keeps about one index.
+class ConcurrentSearchServer {
+public:
+    explicit ConcurrentSearchServer(SearchServer server);
+
+    ConcurrentSearchServer(const ConcurrentSearchServer&) = delete;
+
+    ConcurrentSearchServer& operator=(const ConcurrentSearchServer&) = delete;
+
+    // No reader may be inside the server
+    ~ConcurrentSearchServer();
+
+    // Calls function(const SearchServer&) on the published version, which doesn't
+    // change during the call. Views returned by the server are valid only inside
+    template<typename Function>
+    auto Read(Function function) const;
+
+    template<typename Predicate>
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, Predicate predicate,
+            size_t limit = MAX_RESULT_DOCUMENT_COUNT, size_t offset = 0) const;
+
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status,
+            size_t limit = MAX_RESULT_DOCUMENT_COUNT, size_t offset = 0) const;
+
+    std::vector<Document> FindTopDocuments(std::string_view raw_query) const;
+
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::string_view raw_query, int document_id) const;
+
+    int GetDocumentCount() const;
+
+    // The changes are visible after Publish()
+    void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+
+    IndexingStats AddDocuments(const std::vector<RawDocument>& documents);
+
+    void RemoveDocument(int document_id);
+
+    void RemoveDocuments(const std::vector<int>& document_ids);
+
+    // Calls function(SearchServer&) on the working copy, e.g. to attach a mutation log
+    template<typename Function>
+    auto Update(Function function);
+
+    // Makes the changes made so far visible to readers. Costs a pointer per chunk of
+    // the tables of the index; the first change of a chunk after a Publish() copies
+    // the chunk, so batch changes
+    void Publish();
+
+private:
+    std::atomic<const SearchServer*> published_;
+    std::mutex writer_mutex_;
+    SearchServer working_;
+};
+
+template<typename Function>
+auto ConcurrentSearchServer::Read(Function function) const {
+    const EpochDomain::Guard guard;
+    return function(*published_.load());
+}
+
+template<typename Predicate>
+std::vector<Document> ConcurrentSearchServer::FindTopDocuments(std::string_view raw_query, Predicate predicate,
+        size_t limit, size_t offset) const {
+    return Read([raw_query, &predicate, limit, offset](const SearchServer& server) {
+        return server.FindTopDocuments(raw_query, predicate, limit, offset);
+    });
+}
+
+template<typename Function>
+auto ConcurrentSearchServer::Update(Function function) {
+    std::lock_guard lock(writer_mutex_);
+    return function(working_);
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+#include "cow_vector.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <unordered_map>
+
+
+// Hash map split into shards by the high bits of the mixed hash; copies of the
+// map share the shards until one of them changes a shard, so a copy costs
+// SHARD_COUNT pointers and a change copies one shard at most
+template <typename Key, typename Value, typename Hash = std::hash<Key>>
+class CowHashMap {
+public:
+    static const size_t SHARD_COUNT = 256;
+
+    // nullptr if there is no such key
+    const Value* Find(const Key& key) const {
+        const std::shared_ptr<Shard>& shard = shards_[GetShardIndex(key)];
+        if (!shard) {
+            return nullptr;
+        }
+        const auto it = shard->find(key);
+        return it == shard->end() ? nullptr : &it->second;
+    }
+
+    bool Contains(const Key& key) const {
+        return Find(key) != nullptr;
+    }
+
+    // Returns false and keeps the value if the key is present
+    bool Insert(const Key& key, Value value) {
+        std::shared_ptr<Shard>& shard = shards_[GetShardIndex(key)];
+        if (!shard) {
+            shard = std::make_shared<Shard>();
+        } else if (shard->count(key) > 0) {
+            return false;
+        }
+        MakeChunkWritable(shard).emplace(key, std::move(value));
+        ++size_;
+        return true;
+    }
+
+    // Returns false if there was no such key
+    bool Erase(const Key& key) {
+        std::shared_ptr<Shard>& shard = shards_[GetShardIndex(key)];
+        if (!shard || shard->count(key) == 0) {
+            return false;
+        }
+        MakeChunkWritable(shard).erase(key);
+        --size_;
+        return true;
+    }
+
+    void clear() {
+        shards_ = {};
+        size_ = 0;
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+    bool empty() const {
+        return size_ == 0;
+    }
+
+    // Calls function(const Key&, const Value&) for every entry, in no particular order
+    template <typename Function>
+    void ForEach(Function function) const {
+        for (const std::shared_ptr<Shard>& shard : shards_) {
+            if (shard) {
+                for (const auto& [key, value] : *shard) {
+                    function(key, value);
+                }
+            }
+        }
+    }
+
+private:
+    using Shard = std::unordered_map<Key, Value, Hash>;
+
+    std::array<std::shared_ptr<Shard>, SHARD_COUNT> shards_;
+    size_t size_ = 0;
+
+    // std::hash of an integer is the integer itself, the product spreads it over the high bits
+    static size_t GetShardIndex(const Key& key) {
+        const uint64_t hash = static_cast<uint64_t>(Hash{}(key)) * 0x9e3779b97f4a7c15ULL;
+        return static_cast<size_t>(hash >> 56);
+    }
+};
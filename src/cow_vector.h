@@ -0,0 +1,153 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <vector>
+
+
+// Makes a chunk shared between copies of a container owned by the caller alone,
+// copying it if another copy still refers to it
+template <typename Chunk>
+Chunk& MakeChunkWritable(std::shared_ptr<Chunk>& chunk) {
+    if (chunk.use_count() > 1) {
+        chunk = std::make_shared<Chunk>(*chunk);
+    } else {
+        // the copies which shared the chunk are gone, their reads come before the writes
+        std::atomic_thread_fence(std::memory_order_acquire);
+    }
+    return *chunk;
+}
+
+// Vector whose elements are stored in fixed-size chunks shared by all copies of
+// the vector until one of them changes a chunk, so a copy costs a pointer per
+// chunk and a change copies one chunk at most. Elements don't move in memory
+// while their chunk isn't copied.
+// Mutable() on elements of different chunks may run in parallel; elements of
+// one chunk only once the chunk is writable, e.g. after a Mutable() on one of them.
+template <typename T>
+class CowVector {
+public:
+    static const size_t CHUNK_SIZE = 1024;
+
+    class Iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = T;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const T*;
+        using reference = const T&;
+
+        Iterator(const CowVector* vector, size_t index)
+            : vector_(vector)
+            , index_(index) {
+        }
+
+        reference operator*() const {
+            return (*vector_)[index_];
+        }
+
+        Iterator& operator++() {
+            ++index_;
+            return *this;
+        }
+
+        bool operator==(const Iterator& other) const {
+            return index_ == other.index_;
+        }
+
+        bool operator!=(const Iterator& other) const {
+            return index_ != other.index_;
+        }
+
+    private:
+        const CowVector* vector_;
+        size_t index_;
+    };
+
+    const T& operator[](size_t index) const {
+        return (*chunks_[index / CHUNK_SIZE])[index % CHUNK_SIZE];
+    }
+
+    // The element for writing, its chunk is copied first if it is shared
+    T& Mutable(size_t index) {
+        return MakeChunkWritable(chunks_[index / CHUNK_SIZE])[index % CHUNK_SIZE];
+    }
+
+    void push_back(T value) {
+        if (size_ % CHUNK_SIZE == 0) {
+            chunks_.push_back(std::make_shared<Chunk>());
+            chunks_.back()->reserve(CHUNK_SIZE);
+        }
+        MakeChunkWritable(chunks_.back()).push_back(std::move(value));
+        ++size_;
+    }
+
+    // New elements are value-initialized
+    void resize(size_t size) {
+        while (size_ > size) {
+            const size_t last_chunk_size = (size_ - 1) % CHUNK_SIZE + 1;
+            if (size_ - size >= last_chunk_size) {
+                chunks_.pop_back();
+                size_ -= last_chunk_size;
+            } else {
+                MakeChunkWritable(chunks_.back()).resize(last_chunk_size - (size_ - size));
+                size_ = size;
+            }
+        }
+        while (size_ < size) {
+            push_back(T());
+        }
+    }
+
+    // Replaces the elements, new chunks are filled one after another
+    template <typename InputIterator>
+    void assign(InputIterator first, InputIterator last) {
+        clear();
+        while (first != last) {
+            auto chunk = std::make_shared<Chunk>();
+            chunk->reserve(CHUNK_SIZE);
+            for (; first != last && chunk->size() < CHUNK_SIZE; ++first) {
+                chunk->push_back(*first);
+            }
+            size_ += chunk->size();
+            chunks_.push_back(std::move(chunk));
+        }
+    }
+
+    void clear() {
+        chunks_.clear();
+        size_ = 0;
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+    bool empty() const {
+        return size_ == 0;
+    }
+
+    Iterator begin() const {
+        return Iterator(this, 0);
+    }
+
+    Iterator end() const {
+        return Iterator(this, size_);
+    }
+
+    // Calls function(const T* elements, size_t count) for the chunks in order
+    template <typename Function>
+    void ForEachChunk(Function function) const {
+        for (const std::shared_ptr<Chunk>& chunk : chunks_) {
+            function(chunk->data(), chunk->size());
+        }
+    }
+
+private:
+    using Chunk = std::vector<T>;
+
+    std::vector<std::shared_ptr<Chunk>> chunks_;
+    size_t size_ = 0;
+};
@@ -1,5 +1,6 @@
 #include "document.h"
 
+#include <cmath>
 #include <iostream>
 
 using namespace std::string_literals;
@@ -25,6 +26,14 @@ std::ostream& operator<<(std::ostream& output, const Document& document) {
     return output;
 }
 
+bool IsMoreRelevant(const Document& lhs, const Document& rhs) {
+    const double delta = std::abs(lhs.relevance - rhs.relevance);    // compute equality with required precision;
+    if (delta < EPS) {
+        return lhs.rating > rhs.rating;
+    }
+    return lhs.relevance > rhs.relevance;
+}
+
 void PrintDocument(const Document& document) {
     std::cout << "{ "s
          << "document_id = "s << document.id << ", "s
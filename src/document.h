@@ -6,6 +6,8 @@
 #include <vector>
 
 
+const double EPS = 1e-6;    // allowable error;
+
 struct Document {
     Document();
     Document(int doc_id, double doc_relevance, int doc_rating);
@@ -23,6 +25,9 @@ enum class DocumentStatus {
 
 std::ostream& operator<<(std::ostream& output, const Document& document);
 
+// Ranking order: by relevance, documents with equal relevance by rating
+bool IsMoreRelevant(const Document& lhs, const Document& rhs);
+
 void PrintDocument(const Document& document);
 
 void PrintMatchDocumentResult(int document_id, const std::vector<std::string_view>& words, DocumentStatus status);
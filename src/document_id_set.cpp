@@ -0,0 +1,100 @@
+#include "document_id_set.h"
+#include "cow_vector.h"
+
+#include <algorithm>
+
+
+bool DocumentIdSet::Insert(int document_id) {
+    const size_t chunk_index = FindChunk(document_id);
+    if (chunk_index == chunks_.size()) {
+        // ids mostly grow, so a full last chunk is followed by a new one instead of a split
+        if (chunks_.empty() || chunks_.back()->size() == CHUNK_SIZE) {
+            chunks_.push_back(std::make_shared<Chunk>());
+            chunks_.back()->reserve(CHUNK_SIZE);
+        }
+        MakeChunkWritable(chunks_.back()).push_back(document_id);
+        ++size_;
+        return true;
+    }
+    const Chunk& chunk = *chunks_[chunk_index];
+    const auto it = std::lower_bound(chunk.begin(), chunk.end(), document_id);
+    if (*it == document_id) {
+        return false;
+    }
+    const size_t position = it - chunk.begin();
+    Chunk& writable_chunk = MakeChunkWritable(chunks_[chunk_index]);
+    writable_chunk.insert(writable_chunk.begin() + position, document_id);
+    if (writable_chunk.size() > CHUNK_SIZE) {
+        const size_t half = writable_chunk.size() / 2;
+        auto upper_half = std::make_shared<Chunk>(writable_chunk.begin() + half, writable_chunk.end());
+        writable_chunk.resize(half);
+        chunks_.insert(chunks_.begin() + chunk_index + 1, std::move(upper_half));
+    }
+    ++size_;
+    return true;
+}
+
+bool DocumentIdSet::Erase(int document_id) {
+    const size_t chunk_index = FindChunk(document_id);
+    if (chunk_index == chunks_.size()) {
+        return false;
+    }
+    const Chunk& chunk = *chunks_[chunk_index];
+    const auto it = std::lower_bound(chunk.begin(), chunk.end(), document_id);
+    if (*it != document_id) {
+        return false;
+    }
+    const size_t position = it - chunk.begin();
+    Chunk& writable_chunk = MakeChunkWritable(chunks_[chunk_index]);
+    writable_chunk.erase(writable_chunk.begin() + position);
+    --size_;
+    if (writable_chunk.empty()) {
+        chunks_.erase(chunks_.begin() + chunk_index);
+    } else if (writable_chunk.size() < CHUNK_SIZE / 4 && chunk_index + 1 < chunks_.size()
+            && writable_chunk.size() + chunks_[chunk_index + 1]->size() <= CHUNK_SIZE) {
+        // sparse chunks are merged, so that removals don't leave a chunk per id
+        const Chunk& next_chunk = *chunks_[chunk_index + 1];
+        writable_chunk.insert(writable_chunk.end(), next_chunk.begin(), next_chunk.end());
+        chunks_.erase(chunks_.begin() + chunk_index + 1);
+    }
+    return true;
+}
+
+void DocumentIdSet::Assign(const int* sorted_ids, size_t count) {
+    chunks_.clear();
+    for (size_t first = 0; first < count; first += CHUNK_SIZE) {
+        const size_t last = count - first > CHUNK_SIZE ? first + CHUNK_SIZE : count;
+        chunks_.push_back(std::make_shared<Chunk>(sorted_ids + first, sorted_ids + last));
+    }
+    size_ = count;
+}
+
+bool DocumentIdSet::Contains(int document_id) const {
+    const size_t chunk_index = FindChunk(document_id);
+    if (chunk_index == chunks_.size()) {
+        return false;
+    }
+    const Chunk& chunk = *chunks_[chunk_index];
+    return *std::lower_bound(chunk.begin(), chunk.end(), document_id) == document_id;
+}
+
+size_t DocumentIdSet::size() const {
+    return size_;
+}
+
+bool DocumentIdSet::empty() const {
+    return size_ == 0;
+}
+
+DocumentIdSet::Iterator DocumentIdSet::begin() const {
+    return Iterator(this, 0);
+}
+
+DocumentIdSet::Iterator DocumentIdSet::end() const {
+    return Iterator(this, chunks_.size());
+}
+
+size_t DocumentIdSet::FindChunk(int document_id) const {
+    return std::partition_point(chunks_.begin(), chunks_.end(),
+            [document_id](const std::shared_ptr<Chunk>& chunk) { return chunk->back() < document_id; }) - chunks_.begin();
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <vector>
+
+
+// Sorted set of document ids in chunks of at most CHUNK_SIZE ids. Copies of
+// the set share the chunks until one of them changes a chunk, so a copy costs
+// a pointer per chunk and a change copies one chunk at most
+class DocumentIdSet {
+public:
+    static const size_t CHUNK_SIZE = 512;
+
+    class Iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = int;
+        using difference_type = std::ptrdiff_t;
+        using pointer = const int*;
+        using reference = const int&;
+
+        Iterator(const DocumentIdSet* set, size_t chunk_index)
+            : set_(set)
+            , chunk_index_(chunk_index) {
+        }
+
+        reference operator*() const {
+            return (*set_->chunks_[chunk_index_])[position_];
+        }
+
+        Iterator& operator++() {
+            if (++position_ == set_->chunks_[chunk_index_]->size()) {
+                ++chunk_index_;
+                position_ = 0;
+            }
+            return *this;
+        }
+
+        bool operator==(const Iterator& other) const {
+            return chunk_index_ == other.chunk_index_ && position_ == other.position_;
+        }
+
+        bool operator!=(const Iterator& other) const {
+            return !(*this == other);
+        }
+
+    private:
+        const DocumentIdSet* set_;
+        size_t chunk_index_;
+        size_t position_ = 0;
+    };
+
+    // Returns false if the id is present
+    bool Insert(int document_id);
+
+    // Returns false if there was no such id
+    bool Erase(int document_id);
+
+    // Replaces the ids by the ascending sorted_ids, filling the chunks in order
+    void Assign(const int* sorted_ids, size_t count);
+
+    bool Contains(int document_id) const;
+
+    size_t size() const;
+
+    bool empty() const;
+
+    Iterator begin() const;
+
+    Iterator end() const;
+
+private:
+    using Chunk = std::vector<int>;
+
+    // non-empty and sorted, every chunk ends before the next one begins
+    std::vector<std::shared_ptr<Chunk>> chunks_;
+    size_t size_ = 0;
+
+    // first chunk whose last id >= document_id, or chunks_.size()
+    size_t FindChunk(int document_id) const;
+};
@@ -0,0 +1,115 @@
+#include "document_store.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+
+using namespace std::string_literals;
+
+
+int DocumentStore::Add(int document_id, DocumentStatus status, int rating, double inv_word_count) {
+    const int ordinal = static_cast<int>(ids_.size());
+    ordinals_.Insert(document_id, ordinal);
+    ids_.push_back(document_id);
+    statuses_.push_back(status);
+    ratings_.push_back(rating);
+    inv_word_counts_.push_back(inv_word_count);
+    return ordinal;
+}
+
+void DocumentStore::Remove(int document_id) {
+    // The columns keep the slot: postings no longer reference it
+    ordinals_.Erase(document_id);
+}
+
+int DocumentStore::GetOrdinal(int document_id) const {
+    const int* ordinal = ordinals_.Find(document_id);
+    if (ordinal == nullptr) {
+        throw std::out_of_range("unknown document id "s + std::to_string(document_id));
+    }
+    return *ordinal;
+}
+
+bool DocumentStore::Contains(int document_id) const {
+    return ordinals_.Contains(document_id);
+}
+
+size_t DocumentStore::size() const {
+    return ordinals_.size();
+}
+
+std::vector<int> DocumentStore::Compact() {
+    std::vector<int> new_ordinals(ids_.size(), -1);
+    DocumentStore store;
+    for (size_t ordinal = 0; ordinal < ids_.size(); ++ordinal) {
+        // the id of a removed document may be stored again under a newer ordinal
+        const int* stored_ordinal = ordinals_.Find(ids_[ordinal]);
+        if (stored_ordinal != nullptr && static_cast<size_t>(*stored_ordinal) == ordinal) {
+            new_ordinals[ordinal] = store.Add(ids_[ordinal], statuses_[ordinal], ratings_[ordinal], inv_word_counts_[ordinal]);
+        }
+    }
+    *this = std::move(store);
+    return new_ordinals;
+}
+
+std::vector<int> DocumentStore::GetSortedIds() const {
+    std::vector<int> ids;
+    ids.reserve(ordinals_.size());
+    ordinals_.ForEach([&ids](int document_id, int) {
+        ids.push_back(document_id);
+    });
+    std::sort(ids.begin(), ids.end());
+    return ids;
+}
+
+void DocumentStore::Save(SnapshotWriter& writer) const {
+    std::vector<int32_t> statuses;
+    statuses.reserve(statuses_.size());
+    for (DocumentStatus status : statuses_) {
+        statuses.push_back(static_cast<int32_t>(status));
+    }
+    const std::vector<int> live_ids = GetSortedIds();
+    std::vector<int> live_ordinals(live_ids.size());
+    std::transform(live_ids.begin(), live_ids.end(), live_ordinals.begin(),
+            [this](int document_id) { return GetOrdinal(document_id); });
+    writer.WriteValue<uint64_t>(ids_.size());
+    writer.WriteArray(ids_);
+    writer.WriteArray(statuses);
+    writer.WriteArray(ratings_);
+    writer.WriteArray(inv_word_counts_);
+    writer.WriteValue<uint64_t>(live_ids.size());
+    writer.WriteArray(live_ids);
+    writer.WriteArray(live_ordinals);
+}
+
+DocumentStore DocumentStore::Load(SnapshotCursor& cursor, DocumentIdSet& document_ids) {
+    DocumentStore store;
+    const size_t ordinal_count = cursor.ReadValue<uint64_t>();
+    const int* ids = cursor.ReadArray<int>(ordinal_count);
+    const int32_t* statuses = cursor.ReadArray<int32_t>(ordinal_count);
+    const int* ratings = cursor.ReadArray<int>(ordinal_count);
+    const double* inv_word_counts = cursor.ReadArray<double>(ordinal_count);
+    store.ids_.assign(ids, ids + ordinal_count);
+    store.ratings_.assign(ratings, ratings + ordinal_count);
+    store.inv_word_counts_.assign(inv_word_counts, inv_word_counts + ordinal_count);
+    for (size_t i = 0; i < ordinal_count; ++i) {
+        if (statuses[i] < static_cast<int32_t>(DocumentStatus::ACTUAL)
+                || statuses[i] > static_cast<int32_t>(DocumentStatus::REMOVED)) {
+            throw std::runtime_error("corrupted index snapshot"s);
+        }
+        store.statuses_.push_back(static_cast<DocumentStatus>(statuses[i]));
+    }
+    const size_t live_count = cursor.ReadValue<uint64_t>();
+    const int* live_ids = cursor.ReadArray<int>(live_count);
+    const int* live_ordinals = cursor.ReadArray<int>(live_count);
+    for (size_t i = 0; i < live_count; ++i) {
+        if (live_ordinals[i] < 0 || static_cast<size_t>(live_ordinals[i]) >= ordinal_count
+                || store.ids_[live_ordinals[i]] != live_ids[i] || (i > 0 && live_ids[i - 1] >= live_ids[i])) {
+            throw std::runtime_error("corrupted index snapshot"s);
+        }
+        store.ordinals_.Insert(live_ids[i], live_ordinals[i]);
+    }
+    document_ids.Assign(live_ids, live_count);
+    return store;
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "cow_hash_map.h"
+#include "cow_vector.h"
+#include "document.h"
+#include "document_id_set.h"
+#include "index_snapshot.h"
+
+#include <vector>
+
+
+// Document metadata in structure-of-arrays form. Every added document gets a
+// dense internal ordinal (ordinals grow monotonically until Compact renumbers
+// them); the external document id is only translated at the API boundary.
+// Copies of the store share the columns chunk by chunk until they change.
+class DocumentStore {
+public:
+    // Returns ordinal of the new document
+    int Add(int document_id, DocumentStatus status, int rating, double inv_word_count);
+
+    void Remove(int document_id);
+
+    // Throws std::out_of_range for unknown document ids
+    int GetOrdinal(int document_id) const;
+
+    bool Contains(int document_id) const;
+
+    // Number of stored documents
+    size_t size() const;
+
+    // Upper bound of the ordinals handed out so far
+    size_t GetOrdinalCount() const {
+        return ids_.size();
+    }
+
+    int GetId(int ordinal) const {
+        return ids_[ordinal];
+    }
+
+    DocumentStatus GetStatus(int ordinal) const {
+        return statuses_[ordinal];
+    }
+
+    int GetRating(int ordinal) const {
+        return ratings_[ordinal];
+    }
+
+    double GetInvWordCount(int ordinal) const {
+        return inv_word_counts_[ordinal];
+    }
+
+    // Drops the slots of the removed documents and renumbers the stored ones densely
+    // in the same order. Returns the new ordinals indexed by the old ones, -1 for
+    // the removed documents
+    std::vector<int> Compact();
+
+    // Ids of the stored documents in ascending order
+    std::vector<int> GetSortedIds() const;
+
+    // Writes the columns into the current section of the snapshot
+    void Save(SnapshotWriter& writer) const;
+
+    // The columns are copied out of the snapshot, document_ids gets the ids of the
+    // stored documents, which are saved sorted.
+    // Throws std::runtime_error if they are inconsistent.
+    static DocumentStore Load(SnapshotCursor& cursor, DocumentIdSet& document_ids);
+
+private:
+    CowHashMap<int, int> ordinals_;
+    CowVector<int> ids_;
+    CowVector<DocumentStatus> statuses_;
+    CowVector<int> ratings_;
+    CowVector<double> inv_word_counts_;
+};
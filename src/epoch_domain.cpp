@@ -0,0 +1,100 @@
+#include "epoch_domain.h"
+
+#include <algorithm>
+
+
+EpochDomain& EpochDomain::Instance() {
+    // never destroyed, threads release their slots during the exit
+    static EpochDomain* domain = new EpochDomain();
+    return *domain;
+}
+
+EpochDomain::Guard::Guard() {
+    EpochDomain::Instance().Pin();
+}
+
+EpochDomain::Guard::~Guard() {
+    EpochDomain::Instance().Unpin();
+}
+
+void EpochDomain::Reclaim() {
+    std::vector<RetiredObject> reclaimed;
+    {
+        std::lock_guard lock(retired_mutex_);
+        // a reader pinned at epoch e may hold the objects retired at epochs >= e
+        const uint64_t min_pinned_epoch = GetMinPinnedEpoch();
+        const auto it = std::partition(retired_.begin(), retired_.end(),
+                [min_pinned_epoch](const RetiredObject& retired) { return retired.epoch >= min_pinned_epoch; });
+        reclaimed.assign(it, retired_.end());
+        retired_.erase(it, retired_.end());
+    }
+    for (const RetiredObject& retired : reclaimed) {
+        retired.deleter(retired.object);
+    }
+}
+
+EpochDomain::ThreadState::~ThreadState() {
+    if (slot != nullptr) {
+        slot->epoch.store(IDLE);
+        slot->is_used.store(false);
+    }
+}
+
+EpochDomain::ThreadState& EpochDomain::GetThreadState() {
+    thread_local ThreadState state;
+    if (state.slot == nullptr) {
+        state.slot = &AcquireSlot();
+    }
+    return state;
+}
+
+void EpochDomain::Retire(const void* object, void (*deleter)(const void*)) {
+    {
+        std::lock_guard lock(retired_mutex_);
+        retired_.push_back({object, deleter, epoch_.fetch_add(1)});
+    }
+    Reclaim();
+}
+
+EpochDomain::Slot& EpochDomain::AcquireSlot() {
+    for (SlotBlock* block = slot_blocks_.load(); block != nullptr; block = block->next) {
+        for (Slot& slot : block->slots) {
+            bool is_used = false;
+            if (slot.is_used.compare_exchange_strong(is_used, true)) {
+                return slot;
+            }
+        }
+    }
+    SlotBlock* block = new SlotBlock();
+    block->slots[0].is_used.store(true);
+    block->next = slot_blocks_.load();
+    while (!slot_blocks_.compare_exchange_weak(block->next, block)) {
+    }
+    return block->slots[0];
+}
+
+void EpochDomain::Pin() {
+    ThreadState& state = GetThreadState();
+    if (state.depth++ == 0) {
+        // sequentially consistent, so a writer either sees the pin or the reader
+        // sees the objects published before the retirement
+        state.slot->epoch.store(epoch_.load());
+    }
+}
+
+void EpochDomain::Unpin() {
+    ThreadState& state = GetThreadState();
+    if (--state.depth == 0) {
+        state.slot->epoch.store(IDLE);
+    }
+}
+
+uint64_t EpochDomain::GetMinPinnedEpoch() const {
+    uint64_t min_epoch = IDLE;
+    for (SlotBlock* block = slot_blocks_.load(); block != nullptr; block = block->next) {
+        for (const Slot& slot : block->slots) {
+            min_epoch = std::min(min_epoch, slot.epoch.load());
+        }
+    }
+    return min_epoch;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+
+// Epoch-based reclamation of objects shared with lock-free readers.
+// A reader pins the current epoch for the duration of a Guard; an object retired
+// by a writer is deleted once every reader pinned before the retirement has left.
+// Pinning costs two stores into a slot owned by the thread, readers never wait.
+// There is one domain per process, so readers of all structures share the slots.
+class EpochDomain {
+public:
+    static EpochDomain& Instance();
+
+    EpochDomain(const EpochDomain&) = delete;
+
+    EpochDomain& operator=(const EpochDomain&) = delete;
+
+    // Guards nest, only the outermost one pins and unpins the thread
+    class Guard {
+    public:
+        Guard();
+
+        Guard(const Guard&) = delete;
+
+        Guard& operator=(const Guard&) = delete;
+
+        ~Guard();
+    };
+
+    // The object must already be unreachable for new readers
+    template <typename T>
+    void Retire(const T* object) {
+        Retire(object, [](const void* retired) { delete static_cast<const T*>(retired); });
+    }
+
+    // Deletes the retired objects no pinned reader can hold
+    void Reclaim();
+
+private:
+    static const uint64_t IDLE = UINT64_MAX;
+    static const size_t SLOTS_PER_BLOCK = 64;
+
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> epoch{IDLE};
+        std::atomic<bool> is_used{false};
+    };
+
+    // Blocks of slots are only added, a thread gives its slot back on exit
+    struct SlotBlock {
+        Slot slots[SLOTS_PER_BLOCK];
+        SlotBlock* next = nullptr;
+    };
+
+    struct RetiredObject {
+        const void* object;
+        void (*deleter)(const void*);
+        uint64_t epoch;
+    };
+
+    std::atomic<uint64_t> epoch_{0};
+    std::atomic<SlotBlock*> slot_blocks_{nullptr};
+    std::mutex retired_mutex_;
+    std::vector<RetiredObject> retired_;
+
+    struct ThreadState {
+        Slot* slot = nullptr;
+        size_t depth = 0;
+
+        ~ThreadState();
+    };
+
+    EpochDomain() = default;
+
+    ThreadState& GetThreadState();
+
+    void Retire(const void* object, void (*deleter)(const void*));
+
+    Slot& AcquireSlot();
+
+    void Pin();
+
+    void Unpin();
+
+    uint64_t GetMinPinnedEpoch() const;
+};
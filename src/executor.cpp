@@ -0,0 +1,237 @@
+#include "executor.h"
+
+#include <exception>
+#include <utility>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#define THREAD_POOL_HAS_AFFINITY
+#endif
+
+
+void InlineExecutor::Execute(std::function<void()> task) {
+    task();
+}
+
+size_t InlineExecutor::GetConcurrency() const {
+    return 1;
+}
+
+// The pool and the queue index of the current thread, if it belongs to a pool
+static thread_local const ThreadPool* current_pool = nullptr;
+static thread_local size_t current_worker_index = 0;
+
+#ifdef THREAD_POOL_HAS_AFFINITY
+// CPUs the process may run on in ascending order, which need not be 0..N-1
+// under taskset or a cgroup cpuset
+static std::vector<int> GetAllowedCpus() {
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    std::vector<int> cpus;
+    if (sched_getaffinity(0, sizeof(cpu_set), &cpu_set) == 0) {
+        for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &cpu_set)) {
+                cpus.push_back(cpu);
+            }
+        }
+    }
+    return cpus;
+}
+
+static void PinCurrentThread(int cpu) {
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    CPU_SET(cpu, &cpu_set);
+    pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+}
+#endif
+
+ThreadPool::ThreadPool(const ThreadPoolOptions& options) {
+    const size_t thread_count = options.thread_count != 0
+            ? options.thread_count
+            : std::max<size_t>(1, std::thread::hardware_concurrency());
+    for (size_t i = 0; i < thread_count; ++i) {
+        worker_queues_.push_back(std::make_unique<WorkerQueue>());
+    }
+    std::vector<int> cpus;
+#ifdef THREAD_POOL_HAS_AFFINITY
+    if (options.pin_threads) {
+        cpus = GetAllowedCpus();
+    }
+#endif
+    for (size_t i = 0; i < thread_count; ++i) {
+        const int cpu = cpus.empty() ? -1 : cpus[i % cpus.size()];
+        threads_.emplace_back([this, i, cpu]() {
+#ifdef THREAD_POOL_HAS_AFFINITY
+            // by the thread itself, so that it runs no task on another CPU
+            if (cpu >= 0) {
+                PinCurrentThread(cpu);
+            }
+#endif
+            Run(i);
+        });
+    }
+}
+
+ThreadPool::ThreadPool(size_t thread_count)
+    : ThreadPool(ThreadPoolOptions{thread_count, false}) {
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard lock(mutex_);
+        is_stopped_ = true;
+    }
+    has_tasks_.notify_all();
+    for (std::thread& thread : threads_) {
+        thread.join();
+    }
+}
+
+void ThreadPool::Execute(std::function<void()> task) {
+    if (current_pool == this) {
+        WorkerQueue& queue = *worker_queues_[current_worker_index];
+        std::lock_guard lock(queue.mutex);
+        queue.tasks.push_back(std::move(task));
+    } else {
+        std::lock_guard lock(mutex_);
+        shared_tasks_.push_back(std::move(task));
+    }
+    {
+        // under the mutex, so that a thread going to sleep sees the task
+        std::lock_guard lock(mutex_);
+        queued_count_.fetch_add(1);
+    }
+    has_tasks_.notify_one();
+}
+
+size_t ThreadPool::GetConcurrency() const {
+    return threads_.size();
+}
+
+ThreadPoolStats ThreadPool::GetStats() const {
+    return {
+        static_cast<size_t>(std::max<int64_t>(0, queued_count_.load())),
+        executed_count_.load(),
+        steal_count_.load()
+    };
+}
+
+void ThreadPool::Run(size_t worker_index) {
+    current_pool = this;
+    current_worker_index = worker_index;
+    while (true) {
+        if (TryRunTask(worker_index)) {
+            continue;
+        }
+        std::unique_lock lock(mutex_);
+        has_tasks_.wait(lock, [this]() { return is_stopped_ || queued_count_.load() > 0; });
+        if (is_stopped_ && queued_count_.load() <= 0) {
+            return;
+        }
+    }
+}
+
+bool ThreadPool::TryRunTask(size_t worker_index) {
+    std::function<void()> task;
+    {
+        WorkerQueue& queue = *worker_queues_[worker_index];
+        std::lock_guard lock(queue.mutex);
+        if (!queue.tasks.empty()) {
+            task = std::move(queue.tasks.back());
+            queue.tasks.pop_back();
+        }
+    }
+    if (!task) {
+        std::lock_guard lock(mutex_);
+        if (!shared_tasks_.empty()) {
+            task = std::move(shared_tasks_.front());
+            shared_tasks_.pop_front();
+        }
+    }
+    for (size_t i = 1; !task && i < worker_queues_.size(); ++i) {
+        WorkerQueue& queue = *worker_queues_[(worker_index + i) % worker_queues_.size()];
+        std::lock_guard lock(queue.mutex);
+        if (!queue.tasks.empty()) {
+            task = std::move(queue.tasks.front());
+            queue.tasks.pop_front();
+            steal_count_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    if (!task) {
+        return false;
+    }
+    queued_count_.fetch_sub(1);
+    task();
+    executed_count_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+ThreadPool& GetSharedThreadPool() {
+    static ThreadPool pool;
+    return pool;
+}
+
+// Shared by the calling thread and the helper tasks, which may start after the call returns
+struct ParallelForState {
+    std::atomic<size_t> next_index{0};
+    std::mutex mutex;
+    std::condition_variable helpers_finished;
+    size_t active_helper_count = 0;
+    bool is_finished = false;
+    std::exception_ptr error;
+};
+
+static void RunParallelForIndexes(ParallelForState& state, size_t count, size_t grain,
+        const std::function<void(size_t)>& function) {
+    for (size_t begin = state.next_index.fetch_add(grain); begin < count; begin = state.next_index.fetch_add(grain)) {
+        const size_t end = std::min(count, begin + grain);
+        try {
+            for (size_t i = begin; i < end; ++i) {
+                function(i);
+            }
+        } catch (...) {
+            std::lock_guard lock(state.mutex);
+            if (!state.error) {
+                state.error = std::current_exception();
+            }
+            state.next_index.store(count);
+        }
+    }
+}
+
+void ParallelFor(Executor& executor, size_t count, const std::function<void(size_t)>& function) {
+    if (count == 0) {
+        return;
+    }
+    const size_t concurrency = std::max<size_t>(1, executor.GetConcurrency());
+    // a few chunks per thread balance uneven calls without claiming every index
+    const size_t grain = std::max<size_t>(1, count / (concurrency * 8));
+    const size_t helper_count = std::min(concurrency, (count + grain - 1) / grain) - 1;
+    auto state = std::make_shared<ParallelForState>();
+    for (size_t i = 0; i < helper_count; ++i) {
+        executor.Execute([state, count, grain, &function]() {
+            {
+                std::lock_guard lock(state->mutex);
+                if (state->is_finished) {
+                    return;
+                }
+                ++state->active_helper_count;
+            }
+            RunParallelForIndexes(*state, count, grain, function);
+            std::lock_guard lock(state->mutex);
+            if (--state->active_helper_count == 0) {
+                state->helpers_finished.notify_all();
+            }
+        });
+    }
+    RunParallelForIndexes(*state, count, grain, function);
+    std::unique_lock lock(state->mutex);
+    // helpers which haven't started won't touch function any more
+    state->is_finished = true;
+    state->helpers_finished.wait(lock, [&state]() { return state->active_helper_count == 0; });
+    if (state->error) {
+        std::rethrow_exception(state->error);
+    }
+}
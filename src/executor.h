@@ -0,0 +1,155 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <execution>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+
+// Runs tasks for the parallel algorithms of SearchServer and of the query helpers,
+// which accept an executor wherever they accept std::execution::par
+class Executor {
+public:
+    virtual ~Executor() = default;
+
+    // The task must not throw
+    virtual void Execute(std::function<void()> task) = 0;
+
+    // Number of tasks worth running at once
+    virtual size_t GetConcurrency() const = 0;
+};
+
+// Runs every task at once in the calling thread, for deterministic single-threaded runs
+class InlineExecutor : public Executor {
+public:
+    void Execute(std::function<void()> task) override;
+
+    size_t GetConcurrency() const override;
+};
+
+struct ThreadPoolOptions {
+    // 0 for std::thread::hardware_concurrency()
+    size_t thread_count = 0;
+    // Binds thread i to the i-th (cyclically) of the CPUs the process may run on,
+    // before the thread takes a task, where the platform supports it
+    bool pin_threads = false;
+};
+
+struct ThreadPoolStats {
+    // Tasks waiting for a thread
+    size_t queue_depth;
+    uint64_t executed_count;
+    // Tasks taken by a thread from the queue of another one
+    uint64_t steal_count;
+};
+
+// Fixed set of threads with a task queue per thread. A task submitted by a pool
+// thread goes to the back of its own queue, which it takes tasks from (newest
+// first); other tasks go to a shared queue. An idle thread steals the oldest task
+// of another thread's queue.
+class ThreadPool : public Executor {
+public:
+    explicit ThreadPool(const ThreadPoolOptions& options = {});
+
+    explicit ThreadPool(size_t thread_count);
+
+    ThreadPool(const ThreadPool&) = delete;
+
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // Runs the queued tasks, then joins the threads
+    ~ThreadPool() override;
+
+    void Execute(std::function<void()> task) override;
+
+    size_t GetConcurrency() const override;
+
+    ThreadPoolStats GetStats() const;
+
+private:
+    struct alignas(64) WorkerQueue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<WorkerQueue>> worker_queues_;
+    std::mutex mutex_;
+    std::condition_variable has_tasks_;
+    std::deque<std::function<void()>> shared_tasks_;
+    // may drop below zero for a moment, as tasks are counted after they are queued
+    std::atomic<int64_t> queued_count_{0};
+    std::atomic<uint64_t> executed_count_{0};
+    std::atomic<uint64_t> steal_count_{0};
+    bool is_stopped_ = false;
+    std::vector<std::thread> threads_;
+
+    void Run(size_t worker_index);
+
+    bool TryRunTask(size_t worker_index);
+};
+
+// Pool of std::thread::hardware_concurrency() threads started on the first call,
+// for the helpers called without an executor, so that they don't start threads
+// on every call. Like any pool, it must not be waited for from its own tasks
+ThreadPool& GetSharedThreadPool();
+
+// Calls function(i) for every i in [0, count) on the executor and on the calling
+// thread, and returns when all calls have finished. The calling thread takes
+// indexes itself and never waits for a task that hasn't started, so it is safe
+// to call from a task of the same pool. The first exception is rethrown after
+// the calls in progress finish, the remaining indexes are skipped
+void ParallelFor(Executor& executor, size_t count, const std::function<void(size_t)>& function);
+
+// std::for_each, std::transform and std::any_of for either an execution policy
+// or an executor, so that one template serves both
+template <typename ExecutionPolicy, typename RandomIt, typename Function,
+        std::enable_if_t<std::is_execution_policy_v<std::decay_t<ExecutionPolicy>>, int> = 0>
+void ForEach(ExecutionPolicy&& policy, RandomIt first, RandomIt last, Function function) {
+    std::for_each(policy, first, last, function);
+}
+
+template <typename RandomIt, typename Function>
+void ForEach(Executor& executor, RandomIt first, RandomIt last, Function function) {
+    ParallelFor(executor, last - first, [first, &function](size_t i) {
+        function(first[i]);
+    });
+}
+
+template <typename ExecutionPolicy, typename RandomIt, typename OutputIt, typename Function,
+        std::enable_if_t<std::is_execution_policy_v<std::decay_t<ExecutionPolicy>>, int> = 0>
+void Transform(ExecutionPolicy&& policy, RandomIt first, RandomIt last, OutputIt output, Function function) {
+    std::transform(policy, first, last, output, function);
+}
+
+template <typename RandomIt, typename OutputIt, typename Function>
+void Transform(Executor& executor, RandomIt first, RandomIt last, OutputIt output, Function function) {
+    ParallelFor(executor, last - first, [first, output, &function](size_t i) {
+        output[i] = function(first[i]);
+    });
+}
+
+template <typename ExecutionPolicy, typename RandomIt, typename Predicate,
+        std::enable_if_t<std::is_execution_policy_v<std::decay_t<ExecutionPolicy>>, int> = 0>
+bool AnyOf(ExecutionPolicy&& policy, RandomIt first, RandomIt last, Predicate predicate) {
+    return std::any_of(policy, first, last, predicate);
+}
+
+template <typename RandomIt, typename Predicate>
+bool AnyOf(Executor& executor, RandomIt first, RandomIt last, Predicate predicate) {
+    std::atomic<bool> is_found{false};
+    ParallelFor(executor, last - first, [first, &predicate, &is_found](size_t i) {
+        if (!is_found.load(std::memory_order_relaxed) && predicate(first[i])) {
+            is_found.store(true, std::memory_order_relaxed);
+        }
+    });
+    return is_found.load();
+}
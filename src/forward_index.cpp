@@ -0,0 +1,159 @@
+#include "forward_index.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+
+using namespace std::string_literals;
+
+ForwardIndex::ForwardIndex(const ForwardIndex& other)
+    : chunks_(other.chunks_)
+    , current_chunk_(nullptr)
+    , chunk_used_(CHUNK_SIZE)    // the copy never writes into chunks it shares
+    , entries_(other.entries_)
+    , entry_counts_(other.entry_counts_) {
+}
+
+ForwardIndex& ForwardIndex::operator=(const ForwardIndex& other) {
+    if (this != &other) {
+        chunks_ = other.chunks_;
+        current_chunk_ = nullptr;
+        chunk_used_ = CHUNK_SIZE;
+        entries_ = other.entries_;
+        entry_counts_ = other.entry_counts_;
+    }
+    return *this;
+}
+
+// The moved-from index drops its chunk pointer with the chunks, otherwise
+// a later Add on it would write into a chunk now owned by this one
+ForwardIndex::ForwardIndex(ForwardIndex&& other) noexcept
+    : chunks_(std::move(other.chunks_))
+    , current_chunk_(other.current_chunk_)
+    , chunk_used_(other.chunk_used_)
+    , entries_(std::move(other.entries_))
+    , entry_counts_(std::move(other.entry_counts_)) {
+    other.Clear();
+}
+
+ForwardIndex& ForwardIndex::operator=(ForwardIndex&& other) noexcept {
+    if (this != &other) {
+        chunks_ = std::move(other.chunks_);
+        current_chunk_ = other.current_chunk_;
+        chunk_used_ = other.chunk_used_;
+        entries_ = std::move(other.entries_);
+        entry_counts_ = std::move(other.entry_counts_);
+        other.Clear();
+    }
+    return *this;
+}
+
+ForwardIndex::Entry* ForwardIndex::Add(size_t entry_count) {
+    Entry* entries = nullptr;
+    if (entry_count == 0) {
+        // documents of stop words only have no entries
+    } else if (entry_count > CHUNK_SIZE) {
+        // Long documents get a dedicated chunk, current chunk stays in use
+        chunks_.push_back(std::shared_ptr<Entry[]>(new Entry[entry_count]));
+        entries = chunks_.back().get();
+    } else {
+        if (CHUNK_SIZE - chunk_used_ < entry_count) {
+            chunks_.push_back(std::shared_ptr<Entry[]>(new Entry[CHUNK_SIZE]));
+            current_chunk_ = chunks_.back().get();
+            chunk_used_ = 0;
+        }
+        entries = current_chunk_ + chunk_used_;
+        chunk_used_ += entry_count;
+    }
+    entries_.push_back(entries);
+    entry_counts_.push_back(static_cast<uint32_t>(entry_count));
+    return entries;
+}
+
+void ForwardIndex::Remove(int ordinal) {
+    entry_counts_.Mutable(ordinal) = 0;
+}
+
+void ForwardIndex::Compact(const std::vector<int>& new_ordinals) {
+    ForwardIndex index;
+    for (size_t ordinal = 0; ordinal < entries_.size(); ++ordinal) {
+        if (new_ordinals[ordinal] >= 0) {
+            std::copy(entries_[ordinal], entries_[ordinal] + entry_counts_[ordinal], index.Add(entry_counts_[ordinal]));
+        }
+    }
+    *this = std::move(index);
+}
+
+void ForwardIndex::Clear() {
+    chunks_.clear();
+    current_chunk_ = nullptr;
+    chunk_used_ = CHUNK_SIZE;
+    entries_.clear();
+    entry_counts_.clear();
+}
+
+void ForwardIndex::Save(SnapshotWriter& writer) const {
+    std::vector<uint64_t> offsets(1, 0);
+    offsets.reserve(entry_counts_.size() + 1);
+    for (uint32_t entry_count : entry_counts_) {
+        offsets.push_back(offsets.back() + entry_count);
+    }
+    writer.WriteValue<uint64_t>(entries_.size());
+    writer.WriteArray(offsets);
+    for (size_t ordinal = 0; ordinal < entries_.size(); ++ordinal) {
+        writer.Write(entries_[ordinal], entry_counts_[ordinal] * sizeof(Entry));
+    }
+    writer.Align();
+}
+
+ForwardIndex ForwardIndex::Load(SnapshotCursor& cursor) {
+    ForwardIndex index;
+    const size_t ordinal_count = cursor.ReadValue<uint64_t>();
+    const uint64_t* offsets = cursor.ReadArray<uint64_t>(ordinal_count + 1);
+    const Entry* entries = cursor.ReadArray<Entry>(offsets[ordinal_count]);
+    if (offsets[0] != 0) {
+        throw std::runtime_error("corrupted index snapshot"s);
+    }
+    for (size_t ordinal = 0; ordinal < ordinal_count; ++ordinal) {
+        if (offsets[ordinal] > offsets[ordinal + 1]) {
+            throw std::runtime_error("corrupted index snapshot"s);
+        }
+        index.entries_.push_back(entries + offsets[ordinal]);
+        index.entry_counts_.push_back(static_cast<uint32_t>(offsets[ordinal + 1] - offsets[ordinal]));
+    }
+    return index;
+}
+
+WordFrequencies::WordFrequencies(const ForwardIndex::Entry* entries, size_t size, const TermDictionary* dictionary)
+    : entries_(entries)
+    , size_(size)
+    , dictionary_(dictionary) {
+}
+
+WordFrequencies::Iterator WordFrequencies::begin() const {
+    return Iterator(entries_, dictionary_);
+}
+
+WordFrequencies::Iterator WordFrequencies::end() const {
+    return Iterator(entries_ + size_, dictionary_);
+}
+
+size_t WordFrequencies::size() const {
+    return size_;
+}
+
+bool WordFrequencies::empty() const {
+    return size_ == 0;
+}
+
+std::optional<double> WordFrequencies::Find(std::string_view word) const {
+    const ForwardIndex::Entry* const entries_end = entries_ + size_;
+    const ForwardIndex::Entry* it = std::lower_bound(entries_, entries_end, word,
+            [this](const ForwardIndex::Entry& entry, std::string_view value) { return dictionary_->GetTerm(entry.term_id) < value; });
+    if (it == entries_end || dictionary_->GetTerm(it->term_id) != word) {
+        return std::nullopt;
+    }
+    return it->term_freq;
+}
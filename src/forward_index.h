@@ -0,0 +1,147 @@
+#pragma once
+
+#include "cow_vector.h"
+#include "index_snapshot.h"
+#include "term_dictionary.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+
+// Words of every document with their term frequencies, indexed by document ordinal.
+// The entries of a document are sorted by word and stored contiguously in shared
+// fixed-size chunks, so they never move and are shared by all copies of the index;
+// entries of an index loaded from a snapshot stay in the mapped file. The tables
+// of entry pointers and counts are shared by the copies chunk by chunk as well.
+class ForwardIndex {
+public:
+    struct Entry {
+        TermId term_id;
+        uint32_t reserved;
+        double term_freq;
+    };
+
+    ForwardIndex() = default;
+
+    ForwardIndex(const ForwardIndex& other);
+
+    ForwardIndex& operator=(const ForwardIndex& other);
+
+    ForwardIndex(ForwardIndex&& other) noexcept;
+
+    ForwardIndex& operator=(ForwardIndex&& other) noexcept;
+
+    // Storage for the entries of the next ordinal, filled by the caller
+    Entry* Add(size_t entry_count);
+
+    // The entries of a removed document are reclaimed by Compact only,
+    // views of them stay valid until then
+    void Remove(int ordinal);
+
+    // Moves the entries of every ordinal to new_ordinals[ordinal] in new chunks,
+    // ordinals mapped to -1 are dropped. new_ordinals must keep the order
+    void Compact(const std::vector<int>& new_ordinals);
+
+    const Entry* GetEntries(int ordinal) const {
+        return entries_[ordinal];
+    }
+
+    size_t GetEntryCount(int ordinal) const {
+        return entry_counts_[ordinal];
+    }
+
+    size_t GetOrdinalCount() const {
+        return entries_.size();
+    }
+
+    // Writes the entries into the current section of the snapshot
+    void Save(SnapshotWriter& writer) const;
+
+    // Entries point into the snapshot, which must outlive the index.
+    // Throws std::runtime_error if the layout is damaged
+    static ForwardIndex Load(SnapshotCursor& cursor);
+
+private:
+    static const size_t CHUNK_SIZE = 4096;
+
+    std::vector<std::shared_ptr<Entry[]>> chunks_;
+    Entry* current_chunk_ = nullptr;
+    size_t chunk_used_ = CHUNK_SIZE;
+    CowVector<const Entry*> entries_;
+    CowVector<uint32_t> entry_counts_;
+
+    void Clear();
+};
+
+// Read-only view of the word frequencies of a document, ordered by word.
+// Words are views into the term dictionary of the server; the view stays valid
+// until documents are removed from the server, which may compact the index.
+class WordFrequencies {
+public:
+    class Iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = std::pair<std::string_view, double>;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = value_type;
+
+        Iterator(const ForwardIndex::Entry* entry, const TermDictionary* dictionary)
+            : entry_(entry)
+            , dictionary_(dictionary) {
+        }
+
+        value_type operator*() const {
+            return {dictionary_->GetTerm(entry_->term_id), entry_->term_freq};
+        }
+
+        // Id of the word in the dictionary of the server, equal words have equal
+        // ids, so words of two documents are compared without reading them
+        TermId GetTermId() const {
+            return entry_->term_id;
+        }
+
+        Iterator& operator++() {
+            ++entry_;
+            return *this;
+        }
+
+        bool operator==(const Iterator& other) const {
+            return entry_ == other.entry_;
+        }
+
+        bool operator!=(const Iterator& other) const {
+            return entry_ != other.entry_;
+        }
+
+    private:
+        const ForwardIndex::Entry* entry_;
+        const TermDictionary* dictionary_;
+    };
+
+    // No words
+    WordFrequencies() = default;
+
+    WordFrequencies(const ForwardIndex::Entry* entries, size_t size, const TermDictionary* dictionary);
+
+    Iterator begin() const;
+
+    Iterator end() const;
+
+    size_t size() const;
+
+    bool empty() const;
+
+    std::optional<double> Find(std::string_view word) const;
+
+private:
+    const ForwardIndex::Entry* entries_ = nullptr;
+    size_t size_ = 0;
+    const TermDictionary* dictionary_ = nullptr;
+};
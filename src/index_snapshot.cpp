@@ -0,0 +1,245 @@
+#include "index_snapshot.h"
+
+#include <filesystem>
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#define INDEX_SNAPSHOT_HAS_FSYNC
+#endif
+
+
+using namespace std::string_literals;
+
+static const char SNAPSHOT_MAGIC[8] = {'S', 'S', 'I', 'N', 'D', 'E', 'X', '\0'};
+
+static_assert(sizeof(SnapshotHeader) % 8 == 0);
+
+bool SyncParentDirectory(const std::string& path) {
+#ifdef INDEX_SNAPSHOT_HAS_FSYNC
+    std::filesystem::path directory = std::filesystem::path(path).parent_path();
+    if (directory.empty()) {
+        directory = ".";
+    }
+    const int descriptor = open(directory.c_str(), O_RDONLY);
+    if (descriptor < 0) {
+        return false;
+    }
+    const bool is_synced = fsync(descriptor) == 0;
+    return close(descriptor) == 0 && is_synced;
+#else
+    return true;
+#endif
+}
+
+void Checksum::Update(const void* data, size_t size) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+    length_ += size;
+    while (size > 0 && pending_size_ > 0) {
+        pending_ |= static_cast<uint64_t>(*bytes++) << (8 * pending_size_);
+        --size;
+        if (++pending_size_ == 8) {
+            Mix(pending_);
+            pending_ = 0;
+            pending_size_ = 0;
+        }
+    }
+    for (; size >= 8; bytes += 8, size -= 8) {
+        uint64_t word;
+        std::memcpy(&word, bytes, 8);
+        Mix(word);
+    }
+    for (; size > 0; --size) {
+        pending_ |= static_cast<uint64_t>(*bytes++) << (8 * pending_size_++);
+    }
+}
+
+uint64_t Checksum::Get() const {
+    Checksum result = *this;
+    result.Mix(pending_);
+    result.Mix(length_);
+    return result.hash_;
+}
+
+void Checksum::Mix(uint64_t word) {
+    hash_ = (hash_ ^ word) * 0x100000001b3ULL;
+    hash_ ^= hash_ >> 29;
+}
+
+SnapshotWriter::SnapshotWriter(const std::string& path)
+    : path_(path)
+    , temp_path_(path + ".tmp"s)
+    , file_(std::fopen(temp_path_.c_str(), "wb")) {
+    if (file_ == nullptr) {
+        throw std::runtime_error("can't create "s + temp_path_);
+    }
+    // the header is written last, when the sections and the checksum are known
+    const SnapshotHeader placeholder{};
+    if (std::fwrite(&placeholder, sizeof(placeholder), 1, file_) != 1) {
+        throw std::runtime_error("can't write "s + temp_path_);
+    }
+    offset_ = sizeof(SnapshotHeader);
+}
+
+SnapshotWriter::~SnapshotWriter() {
+    if (file_ != nullptr) {
+        std::fclose(file_);
+    }
+    if (!is_committed_) {
+        std::remove(temp_path_.c_str());
+    }
+}
+
+void SnapshotWriter::BeginSection(SnapshotSection section) {
+    EndSection();
+    current_section_ = static_cast<int>(section);
+    header_.sections[current_section_].offset = offset_;
+}
+
+void SnapshotWriter::SetSequenceNumber(uint64_t sequence_number) {
+    header_.sequence_number = sequence_number;
+}
+
+void SnapshotWriter::Write(const void* data, size_t size) {
+    if (size == 0) {
+        return;
+    }
+    if (std::fwrite(data, 1, size, file_) != size) {
+        throw std::runtime_error("can't write "s + temp_path_);
+    }
+    checksum_.Update(data, size);
+    offset_ += size;
+}
+
+void SnapshotWriter::Align() {
+    static const char zeros[8] = {};
+    Write(zeros, (8 - offset_ % 8) % 8);
+}
+
+void SnapshotWriter::Commit() {
+    EndSection();
+    std::copy(SNAPSHOT_MAGIC, SNAPSHOT_MAGIC + 8, header_.magic);
+    header_.version = SNAPSHOT_VERSION;
+    header_.byte_order = SNAPSHOT_BYTE_ORDER;
+    header_.file_size = offset_;
+    header_.checksum = checksum_.Get();
+    if (std::fseek(file_, 0, SEEK_SET) != 0
+            || std::fwrite(&header_, sizeof(header_), 1, file_) != 1
+            || std::fflush(file_) != 0) {
+        throw std::runtime_error("can't write "s + temp_path_);
+    }
+#ifdef INDEX_SNAPSHOT_HAS_FSYNC
+    // the snapshot must be on the disk before it replaces the previous one
+    if (fsync(fileno(file_)) != 0) {
+        throw std::runtime_error("can't write "s + temp_path_);
+    }
+#endif
+    const int close_result = std::fclose(file_);
+    file_ = nullptr;
+    if (close_result != 0 || std::rename(temp_path_.c_str(), path_.c_str()) != 0) {
+        throw std::runtime_error("can't write "s + path_);
+    }
+    is_committed_ = true;
+    if (!SyncParentDirectory(path_)) {
+        throw std::runtime_error("can't write "s + path_);
+    }
+}
+
+void SnapshotWriter::EndSection() {
+    if (current_section_ < 0) {
+        return;
+    }
+    Align();
+    header_.sections[current_section_].size = offset_ - header_.sections[current_section_].offset;
+    current_section_ = -1;
+}
+
+SnapshotCursor::SnapshotCursor(const char* data, size_t size)
+    : data_(data)
+    , size_(size) {
+}
+
+const char* SnapshotCursor::ReadBytes(size_t size) {
+    return Read(size);
+}
+
+StringTable SnapshotCursor::ReadStrings() {
+    StringTable table;
+    table.count = ReadValue<uint64_t>();
+    CheckArraySize(table.count, sizeof(uint64_t));
+    table.offsets = ReadArray<uint64_t>(table.count + 1);
+    if (table.offsets[0] != 0) {
+        throw std::runtime_error("corrupted index snapshot"s);
+    }
+    for (size_t i = 0; i < table.count; ++i) {
+        if (table.offsets[i + 1] < table.offsets[i]) {
+            throw std::runtime_error("corrupted index snapshot"s);
+        }
+    }
+    table.bytes = ReadBytes(table.offsets[table.count]);
+    return table;
+}
+
+const char* SnapshotCursor::Read(size_t size) {
+    if (size > size_ - position_) {
+        throw std::runtime_error("truncated index snapshot"s);
+    }
+    const char* data = data_ + position_;
+    position_ += size;
+    // the writer pads every item to 8 bytes
+    position_ = std::min(size_, (position_ + 7) / 8 * 8);
+    return data;
+}
+
+void SnapshotCursor::CheckArraySize(size_t count, size_t element_size) const {
+    if (count > (size_ - position_) / element_size) {
+        throw std::runtime_error("truncated index snapshot"s);
+    }
+}
+
+SnapshotReader::SnapshotReader(const std::string& path, bool verify_checksum)
+    : file_(std::make_shared<const MappedFile>(path)) {
+    if (file_->size() < sizeof(SnapshotHeader)) {
+        throw std::runtime_error(path + " is not an index snapshot"s);
+    }
+    std::memcpy(&header_, file_->data(), sizeof(header_));
+    if (!std::equal(SNAPSHOT_MAGIC, SNAPSHOT_MAGIC + 8, header_.magic)) {
+        throw std::runtime_error(path + " is not an index snapshot"s);
+    }
+    if (header_.version != SNAPSHOT_VERSION) {
+        throw std::runtime_error("unsupported index snapshot version "s + std::to_string(header_.version));
+    }
+    if (header_.byte_order != SNAPSHOT_BYTE_ORDER) {
+        throw std::runtime_error("index snapshot was written with another byte order"s);
+    }
+    if (header_.file_size != file_->size()) {
+        throw std::runtime_error("truncated index snapshot"s);
+    }
+    for (const auto& section : header_.sections) {
+        if (section.offset % 8 != 0 || section.offset < sizeof(SnapshotHeader)
+                || section.offset > file_->size() || section.size > file_->size() - section.offset) {
+            throw std::runtime_error("corrupted index snapshot"s);
+        }
+    }
+    if (verify_checksum) {
+        Checksum checksum;
+        checksum.Update(file_->data() + sizeof(SnapshotHeader), file_->size() - sizeof(SnapshotHeader));
+        if (checksum.Get() != header_.checksum) {
+            throw std::runtime_error("index snapshot checksum mismatch"s);
+        }
+    }
+}
+
+SnapshotCursor SnapshotReader::GetSection(SnapshotSection section) const {
+    const auto& location = header_.sections[static_cast<size_t>(section)];
+    return SnapshotCursor(file_->data() + location.offset, location.size);
+}
+
+uint64_t SnapshotReader::GetSequenceNumber() const {
+    return header_.sequence_number;
+}
+
+std::shared_ptr<const MappedFile> SnapshotReader::GetFile() const {
+    return file_;
+}
@@ -0,0 +1,207 @@
+#pragma once
+
+#include "cow_vector.h"
+#include "mapped_file.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+
+// Binary index snapshot written by SearchServer::SaveIndex. Values are stored in the
+// byte order of the host; every value and array starts at an 8-byte aligned offset,
+// so the arrays of a mapped snapshot are used in place without deserializing.
+const uint32_t SNAPSHOT_VERSION = 4;
+const uint32_t SNAPSHOT_BYTE_ORDER = 0x01020304;
+
+enum class SnapshotSection : uint32_t {
+    STOP_WORDS,
+    TERMS,
+    POSTINGS,
+    DOCUMENTS,
+    FORWARD_INDEX,
+};
+
+const size_t SNAPSHOT_SECTION_COUNT = 5;
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;    // SNAPSHOT_BYTE_ORDER as written by the host
+    uint64_t file_size;
+    uint64_t checksum;      // of everything after the header
+    uint64_t sequence_number;    // of the last mutation log record in the snapshot
+    struct {
+        uint64_t offset;
+        uint64_t size;
+    } sections[SNAPSHOT_SECTION_COUNT];
+};
+
+// Flushes the directory entry of path to the disk, so that a file renamed to path
+// stays there after a crash. Returns false on I/O errors
+bool SyncParentDirectory(const std::string& path);
+
+// 64-bit checksum computed a word at a time, not cryptographic
+class Checksum {
+public:
+    void Update(const void* data, size_t size);
+
+    uint64_t Get() const;
+
+private:
+    uint64_t hash_ = 0xcbf29ce484222325ULL;
+    uint64_t pending_ = 0;
+    size_t pending_size_ = 0;
+    uint64_t length_ = 0;
+
+    void Mix(uint64_t word);
+};
+
+// Strings of a snapshot: string i is bytes[offsets[i], offsets[i + 1])
+struct StringTable {
+    size_t count = 0;
+    const uint64_t* offsets = nullptr;
+    const char* bytes = nullptr;
+
+    std::string_view Get(size_t index) const {
+        return {bytes + offsets[index], static_cast<size_t>(offsets[index + 1] - offsets[index])};
+    }
+};
+
+// Writes a snapshot into path + ".tmp" and renames it over path on Commit(),
+// so a failed save never damages the previous snapshot.
+// Errors are reported by std::runtime_error.
+class SnapshotWriter {
+public:
+    explicit SnapshotWriter(const std::string& path);
+
+    SnapshotWriter(const SnapshotWriter&) = delete;
+
+    SnapshotWriter& operator=(const SnapshotWriter&) = delete;
+
+    // Removes the temporary file unless the snapshot was committed
+    ~SnapshotWriter();
+
+    void BeginSection(SnapshotSection section);
+
+    void SetSequenceNumber(uint64_t sequence_number);
+
+    template <typename T>
+    void WriteValue(const T& value) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        Write(&value, sizeof(T));
+        Align();
+    }
+
+    template <typename T>
+    void WriteArray(const std::vector<T>& values) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        Write(values.data(), values.size() * sizeof(T));
+        Align();
+    }
+
+    template <typename T>
+    void WriteArray(const CowVector<T>& values) {
+        static_assert(std::is_trivially_copyable_v<T>);
+        values.ForEachChunk([this](const T* elements, size_t count) {
+            Write(elements, count * sizeof(T));
+        });
+        Align();
+    }
+
+    // Writes count, offsets and bytes of the strings
+    template <typename StringRange>
+    void WriteStrings(const StringRange& strings);
+
+    // Raw bytes without alignment, Align() must follow the last of them
+    void Write(const void* data, size_t size);
+
+    void Align();
+
+    // Completes the header, flushes the file to the disk and moves it into place
+    void Commit();
+
+private:
+    std::string path_;
+    std::string temp_path_;
+    std::FILE* file_;
+    SnapshotHeader header_{};
+    Checksum checksum_;
+    uint64_t offset_ = 0;
+    int current_section_ = -1;
+    bool is_committed_ = false;
+
+    void EndSection();
+};
+
+// Bounds-checked sequential reads from a section, mirroring SnapshotWriter.
+// Arrays and bytes point into the snapshot. Throws std::runtime_error on overrun.
+class SnapshotCursor {
+public:
+    SnapshotCursor(const char* data, size_t size);
+
+    template <typename T>
+    T ReadValue() {
+        static_assert(std::is_trivially_copyable_v<T>);
+        T value;
+        std::memcpy(&value, Read(sizeof(T)), sizeof(T));
+        return value;
+    }
+
+    template <typename T>
+    const T* ReadArray(size_t count) {
+        static_assert(std::is_trivially_copyable_v<T> && alignof(T) <= 8);
+        CheckArraySize(count, sizeof(T));
+        return reinterpret_cast<const T*>(Read(count * sizeof(T)));
+    }
+
+    const char* ReadBytes(size_t size);
+
+    StringTable ReadStrings();
+
+private:
+    const char* data_;
+    size_t size_;
+    size_t position_ = 0;
+
+    const char* Read(size_t size);
+
+    void CheckArraySize(size_t count, size_t element_size) const;
+};
+
+// Opens a snapshot and validates its header, and with verify_checksum all its bytes.
+// Throws std::runtime_error if the file is not a snapshot of a supported version.
+class SnapshotReader {
+public:
+    SnapshotReader(const std::string& path, bool verify_checksum);
+
+    SnapshotCursor GetSection(SnapshotSection section) const;
+
+    uint64_t GetSequenceNumber() const;
+
+    // Data read from the sections stays valid while the file is alive
+    std::shared_ptr<const MappedFile> GetFile() const;
+
+private:
+    std::shared_ptr<const MappedFile> file_;
+    SnapshotHeader header_;
+};
+
+template <typename StringRange>
+void SnapshotWriter::WriteStrings(const StringRange& strings) {
+    std::vector<uint64_t> offsets(1, 0);
+    for (std::string_view str : strings) {
+        offsets.push_back(offsets.back() + str.size());
+    }
+    WriteValue<uint64_t>(offsets.size() - 1);
+    WriteArray(offsets);
+    for (std::string_view str : strings) {
+        Write(str.data(), str.size());
+    }
+    Align();
+}
@@ -8,14 +8,44 @@
 #include <string>
 #include <vector>
 
+using namespace std::string_literals;
 
-int main() {
+
+int main(int argc, char* argv[]) {
+    // the timings are printed on request only, they are not checked
+    if (argc > 1 && argv[1] == "--benchmark"s) {
+        BenchmarkFindTopDocumentsParalley();
+        BenchmarkAddDocumentsParalley();
+        return 0;
+    }
     //TestRemoveDuplicates();
+    TestScanWords();
+    TestStopWordSet();
+    TestFindDuplicates();
     TestRequest();
+    TestConcurrentRequestQueue();
+    TestMetricsRegistry();
     TestGetDocumentCount();
     TestProcessQueries();
+    TestProcessQueryStream();
+    TestThreadPool();
     TestRemoveDocumentParalley();
+    TestRemoveDocuments();
     TestMatchDocumentParalley();
+    TestMatchDocuments();
+    TestPreparedQuery();
+    TestFindTopDocumentsParalley();
+    TestAddDocumentsParalley();
+    TestFindTopDocumentsPruned();
+    TestShardedSearchServer();
+    TestPostingList();
+    TestScoreAccumulator();
+    TestForwardIndexMove();
+    TestInverseDocumentFreq();
+    TestSaveLoadIndex();
+    TestMutationLog();
+    TestConcurrentSearchServer();
+    TestQueryResultCache();
 
     std::cout << "All tests are OK";
 }
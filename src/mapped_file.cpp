@@ -0,0 +1,77 @@
+#include "mapped_file.h"
+
+#include <fstream>
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define MAPPED_FILE_HAS_MMAP
+#endif
+
+
+using namespace std::string_literals;
+
+MappedFile::MappedFile(const std::string& path) {
+#ifdef MAPPED_FILE_HAS_MMAP
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error("can't open "s + path);
+    }
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0) {
+        close(fd);
+        throw std::runtime_error("can't read "s + path);
+    }
+    size_ = static_cast<size_t>(file_stat.st_size);
+    if (size_ > 0) {
+        void* address = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (address != MAP_FAILED) {
+            data_ = static_cast<const char*>(address);
+            is_mapped_ = true;
+        }
+    }
+    // the mapping stays valid after the descriptor is closed
+    close(fd);
+    if (is_mapped_ || size_ == 0) {
+        return;
+    }
+#endif
+    ReadIntoBuffer(path);
+}
+
+MappedFile::~MappedFile() {
+#ifdef MAPPED_FILE_HAS_MMAP
+    if (is_mapped_) {
+        munmap(const_cast<char*>(data_), size_);
+    }
+#endif
+}
+
+const char* MappedFile::data() const {
+    return data_;
+}
+
+size_t MappedFile::size() const {
+    return size_;
+}
+
+bool MappedFile::IsMapped() const {
+    return is_mapped_;
+}
+
+void MappedFile::ReadIntoBuffer(const std::string& path) {
+    std::ifstream input(path, std::ios::binary | std::ios::ate);
+    if (!input) {
+        throw std::runtime_error("can't open "s + path);
+    }
+    size_ = static_cast<size_t>(input.tellg());
+    buffer_.reset(new char[size_ > 0 ? size_ : 1]);
+    input.seekg(0);
+    if (!input.read(buffer_.get(), static_cast<std::streamsize>(size_))) {
+        throw std::runtime_error("can't read "s + path);
+    }
+    data_ = buffer_.get();
+}
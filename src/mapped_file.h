@@ -0,0 +1,35 @@
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+
+// Read-only contents of a whole file. The file is mapped into memory where mmap is
+// available, pages are then read on first access; otherwise (or if the mapping
+// fails) the file is read into a buffer. The data is aligned at least to 16 bytes.
+class MappedFile {
+public:
+    // Throws std::runtime_error if the file can't be opened or read
+    explicit MappedFile(const std::string& path);
+
+    MappedFile(const MappedFile&) = delete;
+
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile();
+
+    const char* data() const;
+
+    size_t size() const;
+
+    bool IsMapped() const;
+
+private:
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+    bool is_mapped_ = false;
+    std::unique_ptr<char[]> buffer_;
+
+    void ReadIntoBuffer(const std::string& path);
+};
@@ -0,0 +1,229 @@
+#include "metrics.h"
+
+#include <algorithm>
+#include <memory>
+#include <numeric>
+
+#if defined(__GNUC__)
+#define METRICS_HAS_CLZ
+#endif
+
+using namespace std::string_literals;
+
+
+MetricsRegistry& MetricsRegistry::Instance() {
+    static MetricsRegistry registry;
+    return registry;
+}
+
+void MetricsRegistry::SetEnabled(bool is_enabled) {
+    is_enabled_.store(is_enabled, std::memory_order_relaxed);
+}
+
+// The block has no other writer, so a load and a store don't lose updates
+static void AddToCounter(std::atomic<uint64_t>& counter, uint64_t value) {
+    counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+}
+
+void MetricsRegistry::Record(Metric metric, std::chrono::nanoseconds duration) {
+    const size_t index = static_cast<size_t>(metric);
+    const uint64_t nanoseconds = static_cast<uint64_t>(std::max<int64_t>(0, duration.count()));
+    ThreadBlock& block = GetThreadBlock();
+    AddToCounter(block.counts[index], 1);
+    AddToCounter(block.durations[index], nanoseconds);
+    AddToCounter(block.bins[index][GetDurationBin(nanoseconds)], 1);
+}
+
+std::vector<MetricSnapshot> MetricsRegistry::GetSnapshot() const {
+    auto totals = std::make_unique<Totals>();
+    {
+        std::lock_guard lock(mutex_);
+        AddTotals(*totals);
+        for (size_t metric = 0; metric < METRIC_COUNT; ++metric) {
+            totals->counts[metric] -= reset_totals_.counts[metric];
+            totals->durations[metric] -= reset_totals_.durations[metric];
+            for (size_t bin = 0; bin < DURATION_BIN_COUNT; ++bin) {
+                totals->bins[metric][bin] -= reset_totals_.bins[metric][bin];
+            }
+        }
+    }
+    std::vector<MetricSnapshot> snapshot;
+    for (size_t metric = 0; metric < METRIC_COUNT; ++metric) {
+        MetricSnapshot metric_snapshot;
+        metric_snapshot.name = GetName(static_cast<Metric>(metric));
+        metric_snapshot.count = totals->counts[metric];
+        metric_snapshot.total = std::chrono::nanoseconds(totals->durations[metric]);
+        const uint64_t* bins = totals->bins[metric];
+        // a record may be counted in its bin and not yet in the count, the bins decide
+        const uint64_t count = std::accumulate(bins, bins + DURATION_BIN_COUNT, uint64_t{0});
+        auto get_percentile = [bins, count](double share) {
+            const uint64_t rank = std::max<uint64_t>(1, static_cast<uint64_t>(share * count + 0.5));
+            uint64_t record_count = 0;
+            for (size_t bin = 0; bin < DURATION_BIN_COUNT; ++bin) {
+                record_count += bins[bin];
+                if (record_count >= rank) {
+                    return GetDurationBinBound(bin);
+                }
+            }
+            return GetDurationBinBound(DURATION_BIN_COUNT - 1);
+        };
+        if (count > 0) {
+            metric_snapshot.p50 = get_percentile(0.5);
+            metric_snapshot.p90 = get_percentile(0.9);
+            metric_snapshot.p99 = get_percentile(0.99);
+            metric_snapshot.max = get_percentile(1.0);
+        }
+        snapshot.push_back(std::move(metric_snapshot));
+    }
+    return snapshot;
+}
+
+void MetricsRegistry::Reset() {
+    auto totals = std::make_unique<Totals>();
+    std::lock_guard lock(mutex_);
+    AddTotals(*totals);
+    reset_totals_ = *totals;
+}
+
+// Durations in microseconds with three decimals
+static std::string FormatMicroseconds(std::chrono::nanoseconds duration) {
+    const int64_t nanoseconds = duration.count();
+    std::string fraction = std::to_string(nanoseconds % 1000);
+    return std::to_string(nanoseconds / 1000) + "."s + std::string(3 - fraction.size(), '0') + fraction + " us"s;
+}
+
+void MetricsRegistry::PrintText(std::ostream& output) const {
+    for (const MetricSnapshot& metric : GetSnapshot()) {
+        if (metric.count == 0) {
+            continue;
+        }
+        output << metric.name << ": count "s << metric.count
+               << ", mean "s << FormatMicroseconds(metric.total / metric.count)
+               << ", p50 "s << FormatMicroseconds(metric.p50)
+               << ", p90 "s << FormatMicroseconds(metric.p90)
+               << ", p99 "s << FormatMicroseconds(metric.p99)
+               << ", max "s << FormatMicroseconds(metric.max)
+               << ", total "s << FormatMicroseconds(metric.total) << std::endl;
+    }
+}
+
+void MetricsRegistry::PrintJson(std::ostream& output) const {
+    output << "{\"metrics\":["s;
+    bool is_first = true;
+    for (const MetricSnapshot& metric : GetSnapshot()) {
+        output << (is_first ? ""s : ","s)
+               << "{\"name\":\""s << metric.name
+               << "\",\"count\":"s << metric.count
+               << ",\"total_ns\":"s << metric.total.count()
+               << ",\"p50_ns\":"s << metric.p50.count()
+               << ",\"p90_ns\":"s << metric.p90.count()
+               << ",\"p99_ns\":"s << metric.p99.count()
+               << ",\"max_ns\":"s << metric.max.count() << "}"s;
+        is_first = false;
+    }
+    output << "]}"s << std::endl;
+}
+
+const char* MetricsRegistry::GetName(Metric metric) {
+    switch (metric) {
+        case Metric::FIND_TOP_DOCUMENTS:
+            return "find_top_documents";
+        case Metric::MATCH_DOCUMENT:
+            return "match_document";
+        case Metric::ADD_DOCUMENT:
+            return "add_document";
+        case Metric::REMOVE_DOCUMENT:
+            return "remove_document";
+        case Metric::QUERY_PARSE:
+            return "query_parse";
+        case Metric::TERM_LOOKUP:
+            return "term_lookup";
+        case Metric::POSTING_TRAVERSAL:
+            return "posting_traversal";
+        case Metric::TOP_K_SELECTION:
+            return "top_k_selection";
+        case Metric::RESULT_BUILD:
+            return "result_build";
+        case Metric::DOCUMENT_PARSE:
+            return "document_parse";
+        case Metric::INDEX_UPDATE:
+            return "index_update";
+    }
+    return "unknown";
+}
+
+// Owns the block of a thread, registered on the first record of the thread;
+// the counts are moved to the registry when the thread exits
+struct MetricsRegistry::ThreadRegistration {
+    std::unique_ptr<ThreadBlock> block = std::make_unique<ThreadBlock>();
+
+    ThreadRegistration() {
+        MetricsRegistry& registry = MetricsRegistry::Instance();
+        std::lock_guard lock(registry.mutex_);
+        registry.thread_blocks_.push_back(block.get());
+    }
+
+    ~ThreadRegistration() {
+        MetricsRegistry& registry = MetricsRegistry::Instance();
+        std::lock_guard lock(registry.mutex_);
+        for (size_t metric = 0; metric < METRIC_COUNT; ++metric) {
+            registry.retired_totals_.counts[metric] += block->counts[metric].load(std::memory_order_relaxed);
+            registry.retired_totals_.durations[metric] += block->durations[metric].load(std::memory_order_relaxed);
+            for (size_t bin = 0; bin < DURATION_BIN_COUNT; ++bin) {
+                registry.retired_totals_.bins[metric][bin] += block->bins[metric][bin].load(std::memory_order_relaxed);
+            }
+        }
+        registry.thread_blocks_.erase(std::find(registry.thread_blocks_.begin(), registry.thread_blocks_.end(), block.get()));
+    }
+};
+
+MetricsRegistry::ThreadBlock& MetricsRegistry::GetThreadBlock() {
+    static thread_local ThreadRegistration registration;
+    return *registration.block;
+}
+
+// Adds the counts of the exited threads and the current counts of the running ones,
+// the caller holds the mutex
+void MetricsRegistry::AddTotals(Totals& totals) const {
+    for (size_t metric = 0; metric < METRIC_COUNT; ++metric) {
+        totals.counts[metric] += retired_totals_.counts[metric];
+        totals.durations[metric] += retired_totals_.durations[metric];
+        for (size_t bin = 0; bin < DURATION_BIN_COUNT; ++bin) {
+            totals.bins[metric][bin] += retired_totals_.bins[metric][bin];
+        }
+    }
+    for (const ThreadBlock* block : thread_blocks_) {
+        for (size_t metric = 0; metric < METRIC_COUNT; ++metric) {
+            totals.counts[metric] += block->counts[metric].load(std::memory_order_relaxed);
+            totals.durations[metric] += block->durations[metric].load(std::memory_order_relaxed);
+            for (size_t bin = 0; bin < DURATION_BIN_COUNT; ++bin) {
+                totals.bins[metric][bin] += block->bins[metric][bin].load(std::memory_order_relaxed);
+            }
+        }
+    }
+}
+
+// Below 8 ns a bin per nanosecond, then eight bins per octave
+size_t MetricsRegistry::GetDurationBin(uint64_t nanoseconds) {
+    if (nanoseconds < 8) {
+        return static_cast<size_t>(nanoseconds);
+    }
+#ifdef METRICS_HAS_CLZ
+    const size_t octave = static_cast<size_t>(63 - __builtin_clzll(nanoseconds));
+#else
+    size_t octave = 0;
+    while ((nanoseconds >> (octave + 1)) != 0) {
+        ++octave;
+    }
+#endif
+    const size_t eighth = static_cast<size_t>((nanoseconds >> (octave - 3)) & 7);
+    return std::min(8 * (octave - 2) + eighth, DURATION_BIN_COUNT - 1);
+}
+
+std::chrono::nanoseconds MetricsRegistry::GetDurationBinBound(size_t bin) {
+    if (bin < 8) {
+        return std::chrono::nanoseconds(bin + 1);
+    }
+    const size_t octave = bin / 8 + 2;
+    return std::chrono::nanoseconds(static_cast<int64_t>(9 + bin % 8) << (octave - 3));
+}
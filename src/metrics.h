@@ -0,0 +1,160 @@
+#pragma once
+
+#include "log_duration.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Timing of the search phases is compiled in unless SEARCH_SERVER_NO_METRICS
+// is defined, then METRIC_SCOPE expands to nothing and no clock is read
+#if !defined(SEARCH_SERVER_NO_METRICS)
+#define SEARCH_SERVER_HAS_METRICS
+#endif
+
+#ifdef SEARCH_SERVER_HAS_METRICS
+#define METRIC_SCOPE(metric) MetricTimer PROFILE_CONCAT(metricGuard, __LINE__)(metric)
+#else
+#define METRIC_SCOPE(metric)
+#endif
+
+
+// Operations of SearchServer and the phases they spend their time in. A phase
+// is recorded wherever it runs, e.g. query parsing for both searches and matches.
+// Scoring has no phase of its own: the relevance of a posting is summed up in the
+// loop which walks the list, and timing it apart would read the clock per posting,
+// so it is counted in POSTING_TRAVERSAL
+enum class Metric {
+    FIND_TOP_DOCUMENTS,
+    MATCH_DOCUMENT,
+    ADD_DOCUMENT,
+    REMOVE_DOCUMENT,
+    QUERY_PARSE,
+    TERM_LOOKUP,
+    // walking the posting lists, the relevance is summed up on the way
+    POSTING_TRAVERSAL,
+    TOP_K_SELECTION,
+    RESULT_BUILD,
+    DOCUMENT_PARSE,
+    // the last one, MetricsRegistry counts the metrics up to it
+    INDEX_UPDATE,
+};
+
+struct MetricSnapshot {
+    std::string name;
+    uint64_t count = 0;
+    std::chrono::nanoseconds total{0};
+    // Upper bounds of the durations, accurate to an eighth of an octave
+    std::chrono::nanoseconds p50{0};
+    std::chrono::nanoseconds p90{0};
+    std::chrono::nanoseconds p99{0};
+    std::chrono::nanoseconds max{0};
+};
+
+// Process-wide histograms of the metrics. A thread records into its own block
+// without locks or read-modify-write instructions; the blocks are summed up by
+// GetSnapshot, and a block is merged into the registry when its thread exits
+class MetricsRegistry {
+public:
+    static MetricsRegistry& Instance();
+
+    MetricsRegistry(const MetricsRegistry&) = delete;
+
+    MetricsRegistry& operator=(const MetricsRegistry&) = delete;
+
+    // Recording is off by default: a timed scope then reads no clock, while
+    // on it reads the clock twice, which is noticeable for the smallest queries
+    void SetEnabled(bool is_enabled);
+
+    bool IsEnabled() const {
+        return is_enabled_.load(std::memory_order_relaxed);
+    }
+
+    void Record(Metric metric, std::chrono::nanoseconds duration);
+
+    // Every metric in the order of Metric, including the ones never recorded
+    std::vector<MetricSnapshot> GetSnapshot() const;
+
+    // Later snapshots count only what is recorded after the call
+    void Reset();
+
+    // One line per recorded metric
+    void PrintText(std::ostream& output = std::cout) const;
+
+    // {"metrics":[{"name":...,"count":...,"total_ns":...,"p50_ns":...}, ...]}
+    void PrintJson(std::ostream& output = std::cout) const;
+
+    static const char* GetName(Metric metric);
+
+private:
+    static const size_t METRIC_COUNT = static_cast<size_t>(Metric::INDEX_UPDATE) + 1;
+    // eight per octave of nanoseconds, the last one counts everything from about nine minutes
+    static const size_t DURATION_BIN_COUNT = 304;
+
+    struct Totals {
+        uint64_t counts[METRIC_COUNT] = {};
+        uint64_t durations[METRIC_COUNT] = {};
+        uint64_t bins[METRIC_COUNT][DURATION_BIN_COUNT] = {};
+    };
+
+    // Written by its thread only, read by GetSnapshot
+    struct ThreadBlock {
+        std::atomic<uint64_t> counts[METRIC_COUNT] = {};
+        std::atomic<uint64_t> durations[METRIC_COUNT] = {};
+        std::atomic<uint64_t> bins[METRIC_COUNT][DURATION_BIN_COUNT] = {};
+    };
+
+    struct ThreadRegistration;
+
+    std::atomic<bool> is_enabled_{false};
+    mutable std::mutex mutex_;
+    std::vector<const ThreadBlock*> thread_blocks_;
+    // of the threads which have exited
+    Totals retired_totals_;
+    // subtracted by GetSnapshot after Reset
+    Totals reset_totals_;
+
+    MetricsRegistry() = default;
+
+    ThreadBlock& GetThreadBlock();
+
+    void AddTotals(Totals& totals) const;
+
+    static size_t GetDurationBin(uint64_t nanoseconds);
+
+    static std::chrono::nanoseconds GetDurationBinBound(size_t bin);
+};
+
+// Records the time from its construction to its destruction, as LogDuration
+// prints it; use METRIC_SCOPE, so that the timer is compiled out with the metrics
+class MetricTimer {
+public:
+    explicit MetricTimer(Metric metric)
+        : metric_(metric)
+        , is_enabled_(MetricsRegistry::Instance().IsEnabled())
+    {
+        if (is_enabled_) {
+            start_time_ = LogDuration::Clock::now();
+        }
+    }
+
+    MetricTimer(const MetricTimer&) = delete;
+
+    MetricTimer& operator=(const MetricTimer&) = delete;
+
+    ~MetricTimer() {
+        if (is_enabled_) {
+            MetricsRegistry::Instance().Record(metric_, LogDuration::Clock::now() - start_time_);
+        }
+    }
+
+private:
+    const Metric metric_;
+    const bool is_enabled_;
+    LogDuration::Clock::time_point start_time_;
+};
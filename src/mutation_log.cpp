@@ -0,0 +1,417 @@
+#include "mutation_log.h"
+#include "index_snapshot.h"
+
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#define MUTATION_LOG_HAS_FSYNC
+#endif
+
+
+using namespace std::string_literals;
+
+static const char LOG_MAGIC[8] = {'S', 'S', 'M', 'L', 'O', 'G', '\0', '\0'};
+// version 2 adds batch records, logs of version 1 are read as they are
+static const uint32_t LOG_VERSION = 2;
+
+struct LogHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t base_sequence_number;    // of the last record dropped by Truncate
+};
+
+// A record is: uint32_t payload size, uint64_t checksum of the rest of the record,
+// uint64_t sequence number, MutationType, payload
+static const size_t RECORD_HEADER_SIZE = sizeof(uint32_t) + 2 * sizeof(uint64_t) + sizeof(MutationType);
+static const size_t CHECKSUM_OFFSET = sizeof(uint32_t);
+static const size_t SEQUENCE_NUMBER_OFFSET = CHECKSUM_OFFSET + sizeof(uint64_t);
+
+template <typename T>
+static void WriteValue(std::string& output, T value) {
+    output.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <typename T>
+static bool ReadValue(std::string_view& input, T& value) {
+    if (input.size() < sizeof(T)) {
+        return false;
+    }
+    std::memcpy(&value, input.data(), sizeof(T));
+    input.remove_prefix(sizeof(T));
+    return true;
+}
+
+static bool SyncFile(std::FILE* file) {
+    if (std::fflush(file) != 0) {
+        return false;
+    }
+#ifdef MUTATION_LOG_HAS_FSYNC
+    return fsync(fileno(file)) == 0;
+#else
+    return true;
+#endif
+}
+
+// Atomically replaces path by an empty log
+static void CreateLogFile(const std::string& path, uint64_t base_sequence_number) {
+    const std::string temp_path = path + ".tmp"s;
+    std::FILE* file = std::fopen(temp_path.c_str(), "wb");
+    if (file == nullptr) {
+        throw std::runtime_error("can't create "s + temp_path);
+    }
+    LogHeader header{};
+    std::copy(LOG_MAGIC, LOG_MAGIC + 8, header.magic);
+    header.version = LOG_VERSION;
+    header.base_sequence_number = base_sequence_number;
+    const bool is_written = std::fwrite(&header, sizeof(header), 1, file) == 1 && SyncFile(file);
+    if (std::fclose(file) != 0 || !is_written || std::rename(temp_path.c_str(), path.c_str()) != 0) {
+        std::remove(temp_path.c_str());
+        throw std::runtime_error("can't write "s + path);
+    }
+    // the new log replaces the records of the old one only once the rename is durable
+    if (!SyncParentDirectory(path)) {
+        throw std::runtime_error("can't write "s + path);
+    }
+}
+
+static bool DecodePayload(MutationType type, std::string_view payload, MutationRecord& record) {
+    if (type != MutationType::ADD && type != MutationType::REMOVE) {
+        return false;
+    }
+    record.type = type;
+    if (!ReadValue(payload, record.document_id)) {
+        return false;
+    }
+    if (type == MutationType::REMOVE) {
+        return payload.empty();
+    }
+    int32_t status;
+    uint32_t rating_count;
+    if (type != MutationType::ADD || !ReadValue(payload, status) || !ReadValue(payload, rating_count)
+            || status < static_cast<int32_t>(DocumentStatus::ACTUAL) || status > static_cast<int32_t>(DocumentStatus::REMOVED)
+            || rating_count > payload.size() / sizeof(int)) {
+        return false;
+    }
+    record.status = static_cast<DocumentStatus>(status);
+    record.ratings.resize(rating_count);
+    for (int& rating : record.ratings) {
+        ReadValue(payload, rating);
+    }
+    uint32_t text_size;
+    if (!ReadValue(payload, text_size) || text_size != payload.size()) {
+        return false;
+    }
+    record.text = payload;
+    return true;
+}
+
+// A batch payload is: uint32_t record count, then for every record MutationType,
+// uint32_t payload size and payload
+static bool DecodeBatch(uint64_t sequence_number, std::string_view payload, std::vector<MutationRecord>& records) {
+    uint32_t record_count;
+    if (!ReadValue(payload, record_count) || record_count > payload.size()) {
+        return false;
+    }
+    records.resize(record_count);
+    for (MutationRecord& record : records) {
+        MutationType type;
+        uint32_t record_size;
+        if (!ReadValue(payload, type) || !ReadValue(payload, record_size) || record_size > payload.size()) {
+            return false;
+        }
+        record.sequence_number = sequence_number;
+        if (!DecodePayload(type, payload.substr(0, record_size), record)) {
+            return false;
+        }
+        payload.remove_prefix(record_size);
+    }
+    return payload.empty();
+}
+
+// Reads the records of a log file one at a time up to the first damaged one.
+// Records with sequence numbers greater than sequence_number are decoded and
+// passed to handler, if any. Returns the size of the intact part and sets
+// last_sequence_number.
+static size_t ScanLog(const std::string& path, uint64_t sequence_number,
+        const std::function<void(const MutationRecord&)>* handler, uint64_t& last_sequence_number) {
+    std::ifstream input(path, std::ios::binary);
+    std::error_code error;
+    const uint64_t file_size = std::filesystem::file_size(path, error);
+    if (!input || error) {
+        throw std::runtime_error("can't open "s + path);
+    }
+    LogHeader header;
+    if (file_size < sizeof(header) || !input.read(reinterpret_cast<char*>(&header), sizeof(header))) {
+        throw std::runtime_error(path + " is not a mutation log"s);
+    }
+    if (!std::equal(LOG_MAGIC, LOG_MAGIC + 8, header.magic)) {
+        throw std::runtime_error(path + " is not a mutation log"s);
+    }
+    if (header.version == 0 || header.version > LOG_VERSION) {
+        throw std::runtime_error("unsupported mutation log version "s + std::to_string(header.version));
+    }
+    last_sequence_number = header.base_sequence_number;
+    size_t position = sizeof(header);
+    // the header and the payload of the current record
+    std::string record(RECORD_HEADER_SIZE, '\0');
+    while (file_size - position >= RECORD_HEADER_SIZE && input.read(record.data(), RECORD_HEADER_SIZE)) {
+        std::string_view record_header(record.data(), RECORD_HEADER_SIZE);
+        uint32_t payload_size;
+        uint64_t checksum;
+        uint64_t record_sequence_number;
+        MutationType type;
+        ReadValue(record_header, payload_size);
+        ReadValue(record_header, checksum);
+        ReadValue(record_header, record_sequence_number);
+        ReadValue(record_header, type);
+        // the size of a torn record may be garbage, it is checked before the buffer grows
+        if (payload_size > file_size - position - RECORD_HEADER_SIZE) {
+            break;
+        }
+        record.resize(RECORD_HEADER_SIZE + payload_size);
+        if (!input.read(record.data() + RECORD_HEADER_SIZE, payload_size)) {
+            break;
+        }
+        Checksum actual_checksum;
+        actual_checksum.Update(record.data() + SEQUENCE_NUMBER_OFFSET, record.size() - SEQUENCE_NUMBER_OFFSET);
+        if (actual_checksum.Get() != checksum || record_sequence_number != last_sequence_number + 1) {
+            break;
+        }
+        if (handler != nullptr && record_sequence_number > sequence_number) {
+            const std::string_view payload = std::string_view(record).substr(RECORD_HEADER_SIZE);
+            std::vector<MutationRecord> mutations(1, {record_sequence_number, type, 0, DocumentStatus::ACTUAL, {}, {}});
+            // a batch is decoded as a whole before any of its records is applied
+            const bool is_decoded = type == MutationType::BATCH
+                    ? DecodeBatch(record_sequence_number, payload, mutations)
+                    : DecodePayload(type, payload, mutations.front());
+            if (!is_decoded) {
+                throw std::runtime_error("corrupted mutation log record "s + std::to_string(record_sequence_number));
+            }
+            for (const MutationRecord& mutation : mutations) {
+                (*handler)(mutation);
+            }
+        }
+        last_sequence_number = record_sequence_number;
+        position += RECORD_HEADER_SIZE + payload_size;
+    }
+    return position;
+}
+
+MutationLog::MutationLog(const std::string& path, std::chrono::milliseconds flush_interval)
+    : path_(path)
+    , flush_interval_(flush_interval) {
+    std::error_code error;
+    if (!std::filesystem::exists(path_, error) || std::filesystem::file_size(path_, error) == 0) {
+        CreateLogFile(path_, 0);
+    }
+    const size_t intact_size = ScanLog(path_, 0, nullptr, last_sequence_number_);
+    if (intact_size < std::filesystem::file_size(path_, error)) {
+        // the tail was torn by a crash during the write, the records in it were never committed
+        std::filesystem::resize_file(path_, intact_size, error);
+        if (error) {
+            throw std::runtime_error("can't write "s + path_);
+        }
+    }
+    durable_sequence_number_ = last_sequence_number_;
+    file_ = std::fopen(path_.c_str(), "ab");
+    if (file_ == nullptr) {
+        throw std::runtime_error("can't open "s + path_);
+    }
+    flusher_ = std::thread([this] { RunFlusher(); });
+}
+
+MutationLog::~MutationLog() {
+    {
+        std::lock_guard lock(mutex_);
+        is_stopping_ = true;
+    }
+    flush_requested_.notify_one();
+    flusher_.join();
+    std::fclose(file_);
+}
+
+static void EncodeAdd(std::string& payload, int document_id, std::string_view document, DocumentStatus status,
+        const std::vector<int>& ratings) {
+    payload.reserve(payload.size() + 3 * sizeof(int32_t) + ratings.size() * sizeof(int) + sizeof(uint32_t) + document.size());
+    WriteValue(payload, document_id);
+    WriteValue(payload, static_cast<int32_t>(status));
+    WriteValue(payload, static_cast<uint32_t>(ratings.size()));
+    for (int rating : ratings) {
+        WriteValue(payload, rating);
+    }
+    WriteValue(payload, static_cast<uint32_t>(document.size()));
+    payload.append(document);
+}
+
+void MutationLog::Batch::AddDocument(int document_id, std::string_view document, DocumentStatus status,
+        const std::vector<int>& ratings) {
+    if (record_count_ == 0) {
+        WriteValue<uint32_t>(payload_, 0);
+    }
+    WriteValue(payload_, MutationType::ADD);
+    const size_t size_offset = payload_.size();
+    WriteValue<uint32_t>(payload_, 0);
+    EncodeAdd(payload_, document_id, document, status, ratings);
+    const uint32_t record_size = static_cast<uint32_t>(payload_.size() - size_offset - sizeof(uint32_t));
+    std::memcpy(payload_.data() + size_offset, &record_size, sizeof(record_size));
+    SetRecordCount(record_count_ + 1);
+}
+
+void MutationLog::Batch::RemoveDocument(int document_id) {
+    if (record_count_ == 0) {
+        WriteValue<uint32_t>(payload_, 0);
+    }
+    WriteValue(payload_, MutationType::REMOVE);
+    WriteValue(payload_, static_cast<uint32_t>(sizeof(document_id)));
+    WriteValue(payload_, document_id);
+    SetRecordCount(record_count_ + 1);
+}
+
+void MutationLog::Batch::SetRecordCount(size_t record_count) {
+    record_count_ = record_count;
+    const uint32_t count = static_cast<uint32_t>(record_count);
+    std::memcpy(payload_.data(), &count, sizeof(count));
+}
+
+uint64_t MutationLog::AppendAdd(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
+    std::string payload;
+    EncodeAdd(payload, document_id, document, status, ratings);
+    return Append(MutationType::ADD, payload);
+}
+
+uint64_t MutationLog::AppendRemove(int document_id) {
+    std::string payload;
+    WriteValue(payload, document_id);
+    return Append(MutationType::REMOVE, payload);
+}
+
+uint64_t MutationLog::AppendBatch(const Batch& batch) {
+    if (batch.record_count_ == 0) {
+        throw std::invalid_argument("batch must not be empty"s);
+    }
+    return Append(MutationType::BATCH, batch.payload_);
+}
+
+void MutationLog::WaitDurable(uint64_t sequence_number) {
+    std::unique_lock lock(mutex_);
+    sequence_number = std::min(sequence_number, last_sequence_number_);
+    while (durable_sequence_number_ < sequence_number && !has_failed_) {
+        is_sync_requested_ = true;
+        flush_requested_.notify_one();
+        durable_.wait(lock);
+    }
+    CheckFailure();
+}
+
+void MutationLog::Sync() {
+    WaitDurable(GetLastSequenceNumber());
+}
+
+uint64_t MutationLog::GetLastSequenceNumber() const {
+    std::lock_guard lock(mutex_);
+    return last_sequence_number_;
+}
+
+size_t MutationLog::ForEachRecord(uint64_t sequence_number, const std::function<void(const MutationRecord&)>& handler) {
+    Sync();
+    size_t record_count = 0;
+    const std::function<void(const MutationRecord&)> counting_handler = [&handler, &record_count](const MutationRecord& record) {
+        handler(record);
+        ++record_count;
+    };
+    std::lock_guard file_lock(file_mutex_);
+    uint64_t last_sequence_number;
+    ScanLog(path_, sequence_number, &counting_handler, last_sequence_number);
+    return record_count;
+}
+
+void MutationLog::Truncate(uint64_t sequence_number) {
+    Sync();
+    std::lock_guard file_lock(file_mutex_);
+    std::lock_guard lock(mutex_);
+    if (sequence_number < last_sequence_number_) {
+        throw std::invalid_argument("sequence_number is behind the log"s);
+    }
+    std::fclose(file_);
+    file_ = nullptr;
+    CreateLogFile(path_, sequence_number);
+    file_ = std::fopen(path_.c_str(), "ab");
+    if (file_ == nullptr) {
+        has_failed_ = true;
+        throw std::runtime_error("can't open "s + path_);
+    }
+    last_sequence_number_ = sequence_number;
+    durable_sequence_number_ = sequence_number;
+}
+
+uint64_t MutationLog::Append(MutationType type, const std::string& payload) {
+    std::string record;
+    record.reserve(RECORD_HEADER_SIZE + payload.size());
+    WriteValue(record, static_cast<uint32_t>(payload.size()));
+    WriteValue<uint64_t>(record, 0);
+    WriteValue<uint64_t>(record, 0);
+    WriteValue(record, type);
+    record += payload;
+
+    std::lock_guard lock(mutex_);
+    CheckFailure();
+    const uint64_t sequence_number = ++last_sequence_number_;
+    std::memcpy(record.data() + SEQUENCE_NUMBER_OFFSET, &sequence_number, sizeof(sequence_number));
+    Checksum checksum;
+    checksum.Update(record.data() + SEQUENCE_NUMBER_OFFSET, record.size() - SEQUENCE_NUMBER_OFFSET);
+    const uint64_t checksum_value = checksum.Get();
+    std::memcpy(record.data() + CHECKSUM_OFFSET, &checksum_value, sizeof(checksum_value));
+    pending_ += record;
+    if (pending_.size() >= MAX_PENDING_BYTES) {
+        flush_requested_.notify_one();
+    }
+    return sequence_number;
+}
+
+void MutationLog::RunFlusher() {
+    std::unique_lock lock(mutex_);
+    while (true) {
+        flush_requested_.wait_for(lock, flush_interval_, [this] {
+            return is_stopping_ || is_sync_requested_ || pending_.size() >= MAX_PENDING_BYTES;
+        });
+        is_sync_requested_ = false;
+        if (!pending_.empty() && !has_failed_) {
+            Flush(lock);
+        }
+        if (is_stopping_ && (pending_.empty() || has_failed_)) {
+            return;
+        }
+    }
+}
+
+bool MutationLog::Flush(std::unique_lock<std::mutex>& lock) {
+    std::string data;
+    data.swap(pending_);
+    const uint64_t sequence_number = last_sequence_number_;
+    // appends go on into the new buffer while the group is written
+    lock.unlock();
+    bool is_written;
+    {
+        std::lock_guard file_lock(file_mutex_);
+        is_written = std::fwrite(data.data(), 1, data.size(), file_) == data.size() && SyncFile(file_);
+    }
+    lock.lock();
+    if (is_written) {
+        durable_sequence_number_ = sequence_number;
+    } else {
+        has_failed_ = true;
+    }
+    durable_.notify_all();
+    return is_written;
+}
+
+void MutationLog::CheckFailure() const {
+    if (has_failed_) {
+        throw std::runtime_error("can't write "s + path_);
+    }
+}
@@ -0,0 +1,131 @@
+#pragma once
+
+#include "document.h"
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+
+enum class MutationType : uint8_t {
+    ADD,
+    REMOVE,
+    // records of a batch call written as one, never passed to a handler
+    BATCH
+};
+
+// A logged AddDocument or RemoveDocument, status, ratings and text are set for ADD only
+struct MutationRecord {
+    uint64_t sequence_number;
+    MutationType type;
+    int document_id;
+    DocumentStatus status;
+    std::vector<int> ratings;
+    std::string text;
+};
+
+// Append-only log of index mutations. Every record gets the next sequence number
+// and is checksummed, so a record torn by a crash ends the log on the next open.
+// Appends only copy the record into a buffer; a background thread writes the buffer
+// and fsyncs the file every flush_interval (or once the buffer grows large), so one
+// fsync commits the whole group of records appended meanwhile.
+// I/O errors are reported by std::runtime_error from the next call.
+class MutationLog {
+public:
+    static constexpr std::chrono::milliseconds DEFAULT_FLUSH_INTERVAL{10};
+
+    // Opens or creates the log, a torn record at the end is cut off
+    explicit MutationLog(const std::string& path, std::chrono::milliseconds flush_interval = DEFAULT_FLUSH_INTERVAL);
+
+    MutationLog(const MutationLog&) = delete;
+
+    MutationLog& operator=(const MutationLog&) = delete;
+
+    // Commits the appended records
+    ~MutationLog();
+
+    // Records of a batch call, encoded as they are added
+    class Batch {
+    public:
+        void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+
+        void RemoveDocument(int document_id);
+
+        size_t size() const {
+            return record_count_;
+        }
+
+    private:
+        friend class MutationLog;
+
+        // the record count goes first
+        std::string payload_;
+        size_t record_count_ = 0;
+
+        void SetRecordCount(size_t record_count);
+    };
+
+    // Return the sequence number of the record
+    uint64_t AppendAdd(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+
+    uint64_t AppendRemove(int document_id);
+
+    // Appends the records of the batch as one record, so that a replay applies all
+    // of them or none, even if the write is torn. They share the returned sequence number
+    uint64_t AppendBatch(const Batch& batch);
+
+    // Blocks until the record with sequence_number and all before it are on the disk
+    void WaitDurable(uint64_t sequence_number);
+
+    // Commits every record appended so far
+    void Sync();
+
+    uint64_t GetLastSequenceNumber() const;
+
+    // Calls handler for every committed record with a sequence number greater than
+    // sequence_number, in order; the records are read from the file one at a time,
+    // the records of a batch are passed one after another with its sequence number.
+    // Returns the number of records passed to handler
+    size_t ForEachRecord(uint64_t sequence_number, const std::function<void(const MutationRecord&)>& handler);
+
+    // Drops all records, the next one gets sequence_number + 1. Used after a snapshot
+    // with every record up to sequence_number has been saved, so sequence_number
+    // must not be less than GetLastSequenceNumber() (std::invalid_argument)
+    void Truncate(uint64_t sequence_number);
+
+private:
+    static const size_t MAX_PENDING_BYTES = 1 << 20;
+
+    std::string path_;
+    std::chrono::milliseconds flush_interval_;
+    std::FILE* file_ = nullptr;
+    // guards file_, held by the flusher while it writes
+    std::mutex file_mutex_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable flush_requested_;
+    std::condition_variable durable_;
+    std::string pending_;
+    uint64_t last_sequence_number_ = 0;
+    uint64_t durable_sequence_number_ = 0;
+    bool is_sync_requested_ = false;
+    bool is_stopping_ = false;
+    bool has_failed_ = false;
+    std::thread flusher_;
+
+    uint64_t Append(MutationType type, const std::string& payload);
+
+    void RunFlusher();
+
+    // Writes the pending records, returns false on I/O errors
+    bool Flush(std::unique_lock<std::mutex>& lock);
+
+    void CheckFailure() const;
+};
@@ -0,0 +1,446 @@
+#include "posting_list.h"
+
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <string>
+
+
+using namespace std::string_literals;
+
+
+static void WriteVarint(std::vector<uint8_t>& output, uint32_t value) {
+    while (value >= 0x80) {
+        output.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    output.push_back(static_cast<uint8_t>(value));
+}
+
+static uint32_t ReadVarint(const uint8_t*& input) {
+    uint32_t value = 0;
+    int shift = 0;
+    while (*input & 0x80) {
+        value |= static_cast<uint32_t>(*input++ & 0x7f) << shift;
+        shift += 7;
+    }
+    value |= static_cast<uint32_t>(*input++) << shift;
+    return value;
+}
+
+PostingList::Iterator::Iterator(const PostingList* list, size_t block_index)
+    : list_(list)
+    , block_index_(block_index) {
+    LoadBlock();
+}
+
+Posting PostingList::Iterator::operator*() const {
+    return {ids_[position_], counts_[position_]};
+}
+
+PostingList::Iterator& PostingList::Iterator::operator++() {
+    if (++position_ == block_size_) {
+        ++block_index_;
+        LoadBlock();
+    }
+    return *this;
+}
+
+bool PostingList::Iterator::operator==(const Iterator& other) const {
+    return block_index_ == other.block_index_ && position_ == other.position_;
+}
+
+bool PostingList::Iterator::operator!=(const Iterator& other) const {
+    return !(*this == other);
+}
+
+void PostingList::Iterator::Advance(int target) {
+    if (AtEnd()) {
+        return;
+    }
+    if (ids_[block_size_ - 1] < target) {
+        block_index_ = list_->FindBlock(target, block_index_ + 1);
+        LoadBlock();
+        if (AtEnd()) {
+            return;
+        }
+    }
+    position_ = std::lower_bound(ids_ + position_, ids_ + block_size_, target) - ids_;
+}
+
+PostingList::BlockBound PostingList::Iterator::GetBlockBound(int target) const {
+    if (AtEnd()) {
+        return {std::numeric_limits<int>::max(), 0.0};
+    }
+    const size_t block_index = ids_[block_size_ - 1] >= target ? block_index_ : list_->FindBlock(target, block_index_ + 1);
+    if (block_index == list_->GetBlockCount()) {
+        return {std::numeric_limits<int>::max(), 0.0};
+    }
+    const BlockView block = list_->GetBlock(block_index);
+    return {block.last_id, block.max_term_freq};
+}
+
+bool PostingList::Iterator::AtEnd() const {
+    return block_index_ >= list_->GetBlockCount();
+}
+
+void PostingList::Iterator::LoadBlock() {
+    position_ = 0;
+    block_size_ = AtEnd() ? 0 : DecodeBlock(list_->GetBlock(block_index_), ids_, counts_);
+}
+
+void PostingList::Insert(int document_id, uint32_t count, double term_freq) {
+    std::vector<Block>& blocks = MakeWritable();
+    ++size_;
+    max_term_freq_ = std::max(max_term_freq_, term_freq);
+    if (blocks.empty() || blocks.back().last_id < document_id) {
+        // the common case: ids arrive in ascending order and are appended
+        if (blocks.empty() || blocks.back().size == BLOCK_SIZE) {
+            blocks.push_back({document_id, document_id, 0, 0.0, {}, {}});
+        }
+        Block& block = blocks.back();
+        WriteVarint(block.ids, static_cast<uint32_t>(document_id - block.last_id));
+        WriteVarint(block.counts, count);
+        block.last_id = document_id;
+        block.max_term_freq = std::max(block.max_term_freq, term_freq);
+        ++block.size;
+        return;
+    }
+    const size_t block_index = FindBlock(document_id);
+    const double max_term_freq = std::max(blocks[block_index].max_term_freq, term_freq);
+    int ids[BLOCK_SIZE + 1];
+    uint32_t counts[BLOCK_SIZE + 1];
+    size_t size = DecodeBlock(GetBlock(block_index), ids, counts);
+    const size_t position = std::lower_bound(ids, ids + size, document_id) - ids;
+    if (position < size && ids[position] == document_id) {
+        --size_;
+        counts[position] = count;
+    } else {
+        std::copy_backward(ids + position, ids + size, ids + size + 1);
+        std::copy_backward(counts + position, counts + size, counts + size + 1);
+        ids[position] = document_id;
+        counts[position] = count;
+        ++size;
+    }
+    if (size <= BLOCK_SIZE) {
+        blocks[block_index] = EncodeBlock(ids, counts, size, max_term_freq);
+        return;
+    }
+    const size_t half = size / 2;
+    blocks[block_index] = EncodeBlock(ids, counts, half, max_term_freq);
+    blocks.insert(blocks.begin() + block_index + 1, EncodeBlock(ids + half, counts + half, size - half, max_term_freq));
+}
+
+bool PostingList::Erase(int document_id, const TermFreqFunction& term_freq) {
+    std::vector<Block>& blocks = MakeWritable();
+    const size_t block_index = FindBlock(document_id);
+    if (block_index == blocks.size() || blocks[block_index].first_id > document_id) {
+        return false;
+    }
+    int ids[BLOCK_SIZE];
+    uint32_t counts[BLOCK_SIZE];
+    const size_t size = DecodeBlock(GetBlock(block_index), ids, counts);
+    const size_t position = std::lower_bound(ids, ids + size, document_id) - ids;
+    if (position == size || ids[position] != document_id) {
+        return false;
+    }
+    --size_;
+    const double old_max_term_freq = blocks[block_index].max_term_freq;
+    if (size == 1) {
+        blocks.erase(blocks.begin() + block_index);
+    } else {
+        std::copy(ids + position + 1, ids + size, ids + position);
+        std::copy(counts + position + 1, counts + size, counts + position);
+        blocks[block_index] = EncodeBlock(ids, counts, size - 1, ComputeMaxTermFreq(ids, counts, size - 1, term_freq));
+    }
+    // other blocks can't exceed the list bound, so only its own block may lower it
+    if (old_max_term_freq == max_term_freq_) {
+        max_term_freq_ = 0.0;
+        for (const Block& block : blocks) {
+            max_term_freq_ = std::max(max_term_freq_, block.max_term_freq);
+        }
+    }
+    return true;
+}
+
+size_t PostingList::Erase(const std::vector<int>& document_ids, const TermFreqFunction& term_freq) {
+    std::vector<Block>& blocks = MakeWritable();
+    std::vector<Block> kept_blocks;
+    kept_blocks.reserve(blocks.size());
+    size_t erased_count = 0;
+    double max_term_freq = 0.0;
+    auto id_it = document_ids.begin();
+    for (Block& block : blocks) {
+        id_it = std::lower_bound(id_it, document_ids.end(), block.first_id);
+        if (id_it == document_ids.end() || *id_it > block.last_id) {
+            max_term_freq = std::max(max_term_freq, block.max_term_freq);
+            kept_blocks.push_back(std::move(block));
+            continue;
+        }
+        int ids[BLOCK_SIZE];
+        uint32_t counts[BLOCK_SIZE];
+        const size_t size = DecodeBlock(GetBlock(&block - blocks.data()), ids, counts);
+        size_t kept_size = 0;
+        for (size_t i = 0; i < size; ++i) {
+            while (id_it != document_ids.end() && *id_it < ids[i]) {
+                ++id_it;
+            }
+            if (id_it != document_ids.end() && *id_it == ids[i]) {
+                ++erased_count;
+                continue;
+            }
+            ids[kept_size] = ids[i];
+            counts[kept_size] = counts[i];
+            ++kept_size;
+        }
+        if (kept_size > 0) {
+            const double block_max_term_freq = ComputeMaxTermFreq(ids, counts, kept_size, term_freq);
+            max_term_freq = std::max(max_term_freq, block_max_term_freq);
+            kept_blocks.push_back(EncodeBlock(ids, counts, kept_size, block_max_term_freq));
+        }
+    }
+    blocks.swap(kept_blocks);
+    size_ -= erased_count;
+    max_term_freq_ = max_term_freq;
+    return erased_count;
+}
+
+void PostingList::Remap(const std::vector<int>& new_ids, const TermFreqFunction& term_freq) {
+    auto blocks = std::make_shared<std::vector<Block>>();
+    blocks->reserve(GetBlockCount());
+    size_t size = 0;
+    double max_term_freq = 0.0;
+    int ids[BLOCK_SIZE];
+    uint32_t counts[BLOCK_SIZE];
+    size_t block_size = 0;
+    double block_max_term_freq = 0.0;
+    for (Iterator it = begin(); !it.AtEnd(); ++it) {
+        const Posting posting = *it;
+        const int new_id = new_ids[posting.document_id];
+        if (new_id < 0) {
+            continue;
+        }
+        ids[block_size] = new_id;
+        counts[block_size] = posting.count;
+        block_max_term_freq = std::max(block_max_term_freq, term_freq(new_id, posting.count));
+        if (++block_size == BLOCK_SIZE) {
+            blocks->push_back(EncodeBlock(ids, counts, block_size, block_max_term_freq));
+            max_term_freq = std::max(max_term_freq, block_max_term_freq);
+            size += block_size;
+            block_size = 0;
+            block_max_term_freq = 0.0;
+        }
+    }
+    if (block_size > 0) {
+        blocks->push_back(EncodeBlock(ids, counts, block_size, block_max_term_freq));
+        max_term_freq = std::max(max_term_freq, block_max_term_freq);
+        size += block_size;
+    }
+    blocks_ = std::move(blocks);
+    size_ = size;
+    max_term_freq_ = max_term_freq;
+    mapped_blocks_ = nullptr;
+    mapped_block_count_ = 0;
+    mapped_data_ = nullptr;
+}
+
+bool PostingList::Contains(int document_id) const {
+    const size_t block_index = FindBlock(document_id);
+    if (block_index == GetBlockCount()) {
+        return false;
+    }
+    const BlockView block = GetBlock(block_index);
+    const uint8_t* input = block.ids;
+    int id = block.first_id;
+    for (uint32_t i = 0; i < block.size && id <= document_id; ++i) {
+        id += ReadVarint(input);
+        if (id == document_id) {
+            return true;
+        }
+    }
+    return false;
+}
+
+size_t PostingList::size() const {
+    return size_;
+}
+
+bool PostingList::empty() const {
+    return size_ == 0;
+}
+
+double PostingList::GetMaxTermFreq() const {
+    return max_term_freq_;
+}
+
+PostingList::Iterator PostingList::begin() const {
+    return Iterator(this, 0);
+}
+
+PostingList::Iterator PostingList::end() const {
+    return Iterator(this, GetBlockCount());
+}
+
+void PostingList::Save(const CowVector<PostingList>& lists, SnapshotWriter& writer) {
+    std::vector<MappedList> mapped_lists;
+    std::vector<MappedBlock> mapped_blocks;
+    uint64_t data_size = 0;
+    mapped_lists.reserve(lists.size());
+    for (const PostingList& list : lists) {
+        mapped_lists.push_back({mapped_blocks.size(), list.GetBlockCount(), list.size_, list.max_term_freq_});
+        for (size_t i = 0; i < list.GetBlockCount(); ++i) {
+            const BlockView block = list.GetBlock(i);
+            mapped_blocks.push_back({block.first_id, block.last_id, block.size,
+                    static_cast<uint32_t>(block.ids_size), static_cast<uint32_t>(block.counts_size), 0,
+                    block.max_term_freq, data_size, data_size + block.ids_size});
+            data_size += block.ids_size + block.counts_size;
+        }
+    }
+    writer.WriteValue<uint64_t>(mapped_lists.size());
+    writer.WriteArray(mapped_lists);
+    writer.WriteValue<uint64_t>(mapped_blocks.size());
+    writer.WriteArray(mapped_blocks);
+    writer.WriteValue<uint64_t>(data_size);
+    for (const PostingList& list : lists) {
+        for (size_t i = 0; i < list.GetBlockCount(); ++i) {
+            const BlockView block = list.GetBlock(i);
+            writer.Write(block.ids, block.ids_size);
+            writer.Write(block.counts, block.counts_size);
+        }
+    }
+    writer.Align();
+}
+
+CowVector<PostingList> PostingList::Load(SnapshotCursor& cursor, size_t ordinal_count) {
+    const size_t list_count = cursor.ReadValue<uint64_t>();
+    const MappedList* mapped_lists = cursor.ReadArray<MappedList>(list_count);
+    const size_t block_count = cursor.ReadValue<uint64_t>();
+    const MappedBlock* mapped_blocks = cursor.ReadArray<MappedBlock>(block_count);
+    const size_t data_size = cursor.ReadValue<uint64_t>();
+    const uint8_t* data = reinterpret_cast<const uint8_t*>(cursor.ReadBytes(data_size));
+    for (size_t i = 0; i < block_count; ++i) {
+        const MappedBlock& block = mapped_blocks[i];
+        if (block.size == 0 || block.size > BLOCK_SIZE || block.first_id > block.last_id
+                || block.first_id < 0 || static_cast<uint64_t>(block.last_id) >= ordinal_count
+                || block.ids_offset > data_size || block.ids_size > data_size - block.ids_offset
+                || block.counts_offset > data_size || block.counts_size > data_size - block.counts_offset) {
+            throw std::runtime_error("corrupted index snapshot"s);
+        }
+    }
+    CowVector<PostingList> lists;
+    lists.resize(list_count);
+    // the lists follow each other as Save writes them, so every block is checked once
+    uint64_t next_block = 0;
+    for (size_t i = 0; i < list_count; ++i) {
+        const MappedList& mapped_list = mapped_lists[i];
+        if (mapped_list.first_block != next_block || mapped_list.block_count > block_count - next_block) {
+            throw std::runtime_error("corrupted index snapshot"s);
+        }
+        next_block += mapped_list.block_count;
+        for (size_t j = mapped_list.first_block + 1; j < next_block; ++j) {
+            if (mapped_blocks[j].first_id <= mapped_blocks[j - 1].last_id) {
+                throw std::runtime_error("corrupted index snapshot"s);
+            }
+        }
+        PostingList& list = lists.Mutable(i);
+        list.size_ = mapped_list.size;
+        list.max_term_freq_ = mapped_list.max_term_freq;
+        if (mapped_list.block_count > 0) {
+            list.mapped_blocks_ = mapped_blocks + mapped_list.first_block;
+            list.mapped_block_count_ = mapped_list.block_count;
+            list.mapped_data_ = data;
+        }
+    }
+    return lists;
+}
+
+size_t PostingList::GetBlockCount() const {
+    if (mapped_blocks_ != nullptr) {
+        return mapped_block_count_;
+    }
+    return blocks_ != nullptr ? blocks_->size() : 0;
+}
+
+int PostingList::GetBlockLastId(size_t block_index) const {
+    return mapped_blocks_ != nullptr ? mapped_blocks_[block_index].last_id : (*blocks_)[block_index].last_id;
+}
+
+PostingList::BlockView PostingList::GetBlock(size_t block_index) const {
+    if (mapped_blocks_ != nullptr) {
+        const MappedBlock& block = mapped_blocks_[block_index];
+        return {block.first_id, block.last_id, block.size, block.max_term_freq,
+                mapped_data_ + block.ids_offset, block.ids_size, mapped_data_ + block.counts_offset, block.counts_size};
+    }
+    const Block& block = (*blocks_)[block_index];
+    return {block.first_id, block.last_id, block.size, block.max_term_freq,
+            block.ids.data(), block.ids.size(), block.counts.data(), block.counts.size()};
+}
+
+size_t PostingList::FindBlock(int document_id, size_t first_block) const {
+    size_t first = first_block;
+    size_t last = GetBlockCount();
+    while (first < last) {
+        const size_t middle = first + (last - first) / 2;
+        if (GetBlockLastId(middle) < document_id) {
+            first = middle + 1;
+        } else {
+            last = middle;
+        }
+    }
+    return first;
+}
+
+std::vector<PostingList::Block>& PostingList::MakeWritable() {
+    if (mapped_blocks_ != nullptr) {
+        blocks_ = std::make_shared<std::vector<Block>>();
+        blocks_->reserve(mapped_block_count_);
+        for (size_t i = 0; i < mapped_block_count_; ++i) {
+            const MappedBlock& block = mapped_blocks_[i];
+            const uint8_t* ids = mapped_data_ + block.ids_offset;
+            const uint8_t* counts = mapped_data_ + block.counts_offset;
+            blocks_->push_back({block.first_id, block.last_id, block.size, block.max_term_freq,
+                    {ids, ids + block.ids_size}, {counts, counts + block.counts_size}});
+        }
+        mapped_blocks_ = nullptr;
+        mapped_block_count_ = 0;
+        mapped_data_ = nullptr;
+    } else if (blocks_ == nullptr) {
+        blocks_ = std::make_shared<std::vector<Block>>();
+    } else {
+        // only the owner modifies its copy, so the count can't grow meanwhile; a sole owner
+        // gets the acquire fence, the reads of the released copies come before its writes
+        MakeChunkWritable(blocks_);
+    }
+    return *blocks_;
+}
+
+size_t PostingList::DecodeBlock(const BlockView& block, int* ids, uint32_t* counts) {
+    const uint8_t* id_input = block.ids;
+    const uint8_t* count_input = block.counts;
+    int id = block.first_id;
+    for (uint32_t i = 0; i < block.size; ++i) {
+        id += ReadVarint(id_input);
+        ids[i] = id;
+        counts[i] = ReadVarint(count_input);
+    }
+    return block.size;
+}
+
+PostingList::Block PostingList::EncodeBlock(const int* ids, const uint32_t* counts, size_t size, double max_term_freq) {
+    Block block{ids[0], ids[size - 1], static_cast<uint32_t>(size), max_term_freq, {}, {}};
+    int previous = ids[0];
+    for (size_t i = 0; i < size; ++i) {
+        WriteVarint(block.ids, static_cast<uint32_t>(ids[i] - previous));
+        WriteVarint(block.counts, counts[i]);
+        previous = ids[i];
+    }
+    return block;
+}
+
+double PostingList::ComputeMaxTermFreq(const int* ids, const uint32_t* counts, size_t size, const TermFreqFunction& term_freq) {
+    double max_term_freq = 0.0;
+    for (size_t i = 0; i < size; ++i) {
+        max_term_freq = std::max(max_term_freq, term_freq(ids[i], counts[i]));
+    }
+    return max_term_freq;
+}
@@ -0,0 +1,178 @@
+#pragma once
+
+#include "cow_vector.h"
+#include "index_snapshot.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+
+struct Posting {
+    int document_id;
+    uint32_t count;    // occurrences of the term in the document
+};
+
+// Sorted postings of a single term. Postings are grouped into blocks of at most
+// BLOCK_SIZE entries; inside a block document ids are delta + varint encoded and
+// the occurrence counts are varint encoded into a parallel byte array.
+// Every block also keeps an upper bound of the term frequencies of its postings,
+// which drives dynamic pruning; erasing postings recomputes the bounds of the
+// blocks they were in.
+// Copies of a list share the blocks until one of them is modified, so copying
+// an index is cheap. A list loaded from a snapshot reads its blocks from the
+// mapped file and copies them into memory on the first modification.
+class PostingList {
+public:
+    static const size_t BLOCK_SIZE = 128;
+
+    // Term frequency of a posting, recomputes the block upper bounds
+    using TermFreqFunction = std::function<double(int document_id, uint32_t count)>;
+
+    struct BlockBound {
+        int last_id;              // std::numeric_limits<int>::max() past the last block
+        double max_term_freq;
+    };
+
+    class Iterator {
+    public:
+        Posting operator*() const;
+
+        Iterator& operator++();
+
+        bool operator==(const Iterator& other) const;
+
+        bool operator!=(const Iterator& other) const;
+
+        // Moves to the first posting with document_id >= target,
+        // blocks which end before target are skipped without decoding
+        void Advance(int target);
+
+        // Bound of the block which may contain target (target must not be behind
+        // the current posting), the block is not decoded
+        BlockBound GetBlockBound(int target) const;
+
+        bool AtEnd() const;
+
+    private:
+        friend class PostingList;
+
+        Iterator(const PostingList* list, size_t block_index);
+
+        const PostingList* list_;
+        size_t block_index_;
+        size_t position_ = 0;
+        size_t block_size_ = 0;
+        int ids_[BLOCK_SIZE];
+        uint32_t counts_[BLOCK_SIZE];
+
+        void LoadBlock();
+    };
+
+    // Adds a posting or replaces the count of an existing one,
+    // term_freq only feeds the block upper bounds
+    void Insert(int document_id, uint32_t count, double term_freq);
+
+    // Returns false if there was no posting for the document. The bound of the
+    // list is rescanned from the blocks only if the bound of this block was the maximum
+    bool Erase(int document_id, const TermFreqFunction& term_freq);
+
+    // Erases the postings of sorted document_ids in one pass over the list,
+    // blocks without any of them are kept as they are. Returns the number erased
+    size_t Erase(const std::vector<int>& document_ids, const TermFreqFunction& term_freq);
+
+    // Renumbers every document_id to new_ids[document_id], which must keep the
+    // order of the ids; postings mapped to a negative id are dropped. The blocks
+    // are rebuilt full and their bounds are recomputed exactly
+    void Remap(const std::vector<int>& new_ids, const TermFreqFunction& term_freq);
+
+    bool Contains(int document_id) const;
+
+    size_t size() const;
+
+    bool empty() const;
+
+    // Upper bound of the term frequency over all postings
+    double GetMaxTermFreq() const;
+
+    Iterator begin() const;
+
+    Iterator end() const;
+
+    // Writes all lists into the current section of the snapshot
+    static void Save(const CowVector<PostingList>& lists, SnapshotWriter& writer);
+
+    // Lists point into the snapshot, which must outlive them. The ranges of the blocks are
+    // checked against ordinal_count in O(blocks), the ids encoded inside them are not.
+    // Throws std::runtime_error if the block layout is damaged.
+    static CowVector<PostingList> Load(SnapshotCursor& cursor, size_t ordinal_count);
+
+private:
+    struct Block {
+        int first_id;
+        int last_id;
+        uint32_t size;
+        double max_term_freq;
+        std::vector<uint8_t> ids;       // deltas from the previous id, the first one from first_id
+        std::vector<uint8_t> counts;
+    };
+
+    // Layouts of the snapshot, offsets are relative to the encoded data
+    struct MappedBlock {
+        int32_t first_id;
+        int32_t last_id;
+        uint32_t size;
+        uint32_t ids_size;
+        uint32_t counts_size;
+        uint32_t reserved;
+        double max_term_freq;
+        uint64_t ids_offset;
+        uint64_t counts_offset;
+    };
+
+    struct MappedList {
+        uint64_t first_block;
+        uint64_t block_count;
+        uint64_t size;
+        double max_term_freq;
+    };
+
+    // Block of either representation
+    struct BlockView {
+        int first_id;
+        int last_id;
+        uint32_t size;
+        double max_term_freq;
+        const uint8_t* ids;
+        size_t ids_size;
+        const uint8_t* counts;
+        size_t counts_size;
+    };
+
+    std::shared_ptr<std::vector<Block>> blocks_;
+    size_t size_ = 0;
+    double max_term_freq_ = 0.0;
+    const MappedBlock* mapped_blocks_ = nullptr;
+    size_t mapped_block_count_ = 0;
+    const uint8_t* mapped_data_ = nullptr;
+
+    size_t GetBlockCount() const;
+
+    int GetBlockLastId(size_t block_index) const;
+
+    BlockView GetBlock(size_t block_index) const;
+
+    // first block from first_block whose last_id >= document_id, or GetBlockCount()
+    size_t FindBlock(int document_id, size_t first_block = 0) const;
+
+    // Blocks owned by this list alone, copied from the mapping or from shared blocks
+    std::vector<Block>& MakeWritable();
+
+    static size_t DecodeBlock(const BlockView& block, int* ids, uint32_t* counts);
+
+    static Block EncodeBlock(const int* ids, const uint32_t* counts, size_t size, double max_term_freq);
+
+    static double ComputeMaxTermFreq(const int* ids, const uint32_t* counts, size_t size, const TermFreqFunction& term_freq);
+};
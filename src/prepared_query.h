@@ -0,0 +1,71 @@
+#pragma once
+
+#include "term_dictionary.h"
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+// A query parsed by SearchServer::Prepare and resolved against its index, to be
+// searched and matched many times without parsing it again or looking its words
+// up in the dictionary. Once the index changes (or with another server) the words
+// are looked up by the next call, which keeps the terms for the calls after it.
+// Copies are cheap and share the words and the terms; the words returned by
+// MatchDocument for a prepared query stay valid while any copy of it exists.
+// A query may be used by several threads at once
+class PreparedQuery {
+public:
+    // Sorted and distinct, without stop words
+    const std::vector<std::string_view>& GetPlusWords() const {
+        return plus_words_;
+    }
+
+    const std::vector<std::string_view>& GetMinusWords() const {
+        return minus_words_;
+    }
+
+private:
+    friend class SearchServer;
+
+    struct Term {
+        std::string_view word;
+        TermId term_id;
+        double inverse_document_freq;
+    };
+
+    // Words present in the index; plus terms in the order of the words, minus terms
+    // from the longest posting list, the most likely to exclude a document
+    struct Terms {
+        // of the index the terms were resolved against
+        uint64_t generation;
+        std::vector<Term> plus_terms;
+        std::vector<Term> minus_terms;
+    };
+
+    // The latest terms; a search replaces them, so the terms in use are never changed
+    struct TermsSlot {
+        std::mutex mutex;
+        std::shared_ptr<const Terms> terms;
+    };
+
+    // the words point into it
+    std::shared_ptr<const std::string> text_;
+    std::vector<std::string_view> plus_words_;
+    std::vector<std::string_view> minus_words_;
+    std::shared_ptr<TermsSlot> terms_slot_ = std::make_shared<TermsSlot>();
+
+    // nullptr if never resolved
+    std::shared_ptr<const Terms> LoadTerms() const {
+        std::lock_guard lock(terms_slot_->mutex);
+        return terms_slot_->terms;
+    }
+
+    void StoreTerms(std::shared_ptr<const Terms> terms) const {
+        std::lock_guard lock(terms_slot_->mutex);
+        terms_slot_->terms = std::move(terms);
+    }
+};
@@ -1,11 +1,19 @@
 #include "process_queries.h"
 
 #include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <exception>
 #include <execution>
+#include <mutex>
+#include <stdexcept>
 #include <string>
+#include <thread>
 #include <vector>
 
 
+using namespace std::string_literals;
+
 std::vector<std::vector<Document>> ProcessQueries(
         const SearchServer& search_server,
         const std::vector<std::string>& queries) {
@@ -18,14 +26,211 @@ std::vector<std::vector<Document>> ProcessQueries(
     return result;
 }
 
+std::vector<std::vector<Document>> ProcessQueries(
+        Executor& executor,
+        const SearchServer& search_server,
+        const std::vector<std::string>& queries) {
+    std::vector<std::vector<Document>> result(queries.size());
+    Transform(executor,
+            queries.begin(), queries.end(),
+            result.begin(),
+            [&search_server](const std::string& query) {return search_server.FindTopDocuments(query);}
+    );
+    return result;
+}
+
 std::vector<Document> ProcessQueriesJoined(
         const SearchServer& search_server,
         const std::vector<std::string>& queries) {
+    return ProcessQueriesJoined(GetSharedThreadPool(), search_server, queries);
+}
+
+std::vector<Document> ProcessQueriesJoined(
+        Executor& executor,
+        const SearchServer& search_server,
+        const std::vector<std::string>& queries) {
+    QueryStreamOptions options;
+    options.executor = &executor;
     std::vector<Document> result;
-    for (const std::vector<Document>& documents: ProcessQueries(search_server, queries)) {
-        for (const Document& document : documents) {
-            result.push_back(document);
+    ProcessQueryRange(search_server, queries, [&result](size_t query_index, std::vector<Document> documents) {
+        result.insert(result.end(), documents.begin(), documents.end());
+    }, options);
+    return result;
+}
+
+// Queries in flight are kept in slots; in the ordered mode query i takes slot
+// i % slot count, so the result to deliver next is always in a known slot
+class QueryStream {
+public:
+    QueryStream(const SearchServer& search_server, const QueryStreamOptions& options)
+        : search_server_(search_server)
+        , is_ordered_(options.ordered)
+        , executor_(options.executor)
+        , slots_(options.max_in_flight) {
+        for (size_t slot = slots_.size(); slot > 0; --slot) {
+            free_slots_.push_back(slot - 1);
+        }
+        if (executor_ != nullptr) {
+            return;
+        }
+        const size_t thread_count = options.thread_count != 0
+                ? options.thread_count
+                : std::max<size_t>(1, std::thread::hardware_concurrency());
+        for (size_t i = 0; i < thread_count; ++i) {
+            workers_.emplace_back([this]() { Work(); });
         }
     }
-    return result;
+
+    QueryStream(const QueryStream&) = delete;
+
+    QueryStream& operator=(const QueryStream&) = delete;
+
+    ~QueryStream() {
+        {
+            std::unique_lock lock(mutex_);
+            is_stopped_ = true;
+            // tasks of the executor refer to the slots until they finish
+            result_ready_.wait(lock, [this]() { return running_task_count_ == 0; });
+        }
+        work_ready_.notify_all();
+        for (std::thread& worker : workers_) {
+            worker.join();
+        }
+    }
+
+    void Run(const std::function<std::optional<std::string>()>& next_query,
+            const std::function<void(size_t, std::vector<Document>)>& handler) {
+        size_t taken_count = 0;
+        size_t delivered_count = 0;
+        bool is_exhausted = false;
+        while (true) {
+            while (!is_exhausted && taken_count - delivered_count < slots_.size()) {
+                std::optional<std::string> query = next_query();
+                if (!query) {
+                    is_exhausted = true;
+                    break;
+                }
+                // the free slots are used by this thread only
+                size_t slot = taken_count % slots_.size();
+                if (!is_ordered_) {
+                    slot = free_slots_.back();
+                    free_slots_.pop_back();
+                }
+                slots_[slot].query = std::move(*query);
+                slots_[slot].query_index = taken_count++;
+                if (executor_ != nullptr) {
+                    {
+                        std::lock_guard lock(mutex_);
+                        ++running_task_count_;
+                    }
+                    executor_->Execute([this, slot]() {
+                        Search(slot);
+                        std::lock_guard lock(mutex_);
+                        --running_task_count_;
+                        result_ready_.notify_all();
+                    });
+                    continue;
+                }
+                {
+                    std::lock_guard lock(mutex_);
+                    pending_slots_.push_back(slot);
+                }
+                work_ready_.notify_one();
+            }
+            if (is_exhausted && delivered_count == taken_count) {
+                return;
+            }
+            const size_t slot = WaitResult(delivered_count);
+            Slot& result = slots_[slot];
+            result.is_ready = false;
+            ++delivered_count;
+            if (!is_ordered_) {
+                free_slots_.push_back(slot);
+            }
+            if (result.error) {
+                std::rethrow_exception(std::exchange(result.error, nullptr));
+            }
+            handler(result.query_index, std::move(result.documents));
+        }
+    }
+
+private:
+    struct Slot {
+        std::string query;
+        size_t query_index = 0;
+        std::vector<Document> documents;
+        std::exception_ptr error;
+        bool is_ready = false;
+    };
+
+    const SearchServer& search_server_;
+    const bool is_ordered_;
+    Executor* const executor_;
+    std::vector<Slot> slots_;
+    std::vector<size_t> free_slots_;
+    std::mutex mutex_;
+    std::condition_variable work_ready_;
+    std::condition_variable result_ready_;
+    std::deque<size_t> pending_slots_;
+    std::deque<size_t> ready_slots_;
+    bool is_stopped_ = false;
+    size_t running_task_count_ = 0;
+    std::vector<std::thread> workers_;
+
+    size_t WaitResult(size_t delivered_count) {
+        std::unique_lock lock(mutex_);
+        if (is_ordered_) {
+            const size_t slot = delivered_count % slots_.size();
+            result_ready_.wait(lock, [this, slot]() { return slots_[slot].is_ready; });
+            return slot;
+        }
+        result_ready_.wait(lock, [this]() { return !ready_slots_.empty(); });
+        const size_t slot = ready_slots_.front();
+        ready_slots_.pop_front();
+        return slot;
+    }
+
+    void Work() {
+        while (true) {
+            std::unique_lock lock(mutex_);
+            work_ready_.wait(lock, [this]() { return is_stopped_ || !pending_slots_.empty(); });
+            if (is_stopped_) {
+                return;
+            }
+            const size_t slot = pending_slots_.front();
+            pending_slots_.pop_front();
+            lock.unlock();
+            Search(slot);
+        }
+    }
+
+    void Search(size_t slot) {
+        Slot& query = slots_[slot];
+        try {
+            query.documents = search_server_.FindTopDocuments(query.query);
+        } catch (...) {
+            query.error = std::current_exception();
+        }
+
+        {
+            std::lock_guard lock(mutex_);
+            query.is_ready = true;
+            if (!is_ordered_) {
+                ready_slots_.push_back(slot);
+            }
+        }
+        result_ready_.notify_all();
+    }
+};
+
+void ProcessQueryStream(
+        const SearchServer& search_server,
+        const std::function<std::optional<std::string>()>& next_query,
+        const std::function<void(size_t, std::vector<Document>)>& handler,
+        const QueryStreamOptions& options) {
+    if (options.max_in_flight == 0) {
+        throw std::invalid_argument("max_in_flight must be positive"s);
+    }
+    QueryStream stream(search_server, options);
+    stream.Run(next_query, handler);
 }
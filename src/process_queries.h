@@ -1,13 +1,76 @@
 #pragma once
 
 #include "document.h"
+#include "executor.h"
 #include "search_server.h"
 
+#include <cstddef>
+#include <functional>
+#include <iterator>
+#include <optional>
+#include <string>
+#include <vector>
+
 
 std::vector<std::vector<Document>> ProcessQueries(
         const SearchServer& search_server,
         const std::vector<std::string>& queries);
 
+std::vector<std::vector<Document>> ProcessQueries(
+        Executor& executor,
+        const SearchServer& search_server,
+        const std::vector<std::string>& queries);
+
+// Results of all queries in order, without keeping the results per query.
+// Searches on GetSharedThreadPool() unless given an executor
+std::vector<Document> ProcessQueriesJoined(
+        const SearchServer& search_server,
+        const std::vector<std::string>& queries);
+
 std::vector<Document> ProcessQueriesJoined(
+        Executor& executor,
         const SearchServer& search_server,
         const std::vector<std::string>& queries);
+
+struct QueryStreamOptions {
+    // 0 for std::thread::hardware_concurrency()
+    size_t thread_count = 0;
+    // Queries taken from the input but not yet passed to the handler
+    size_t max_in_flight = 1024;
+    // Otherwise results are passed as soon as they are ready
+    bool ordered = true;
+    // Searches run as tasks of the executor instead of own threads, thread_count is
+    // ignored. Must not be a pool the calling thread belongs to
+    Executor* executor = nullptr;
+};
+
+// Calls next_query() until it returns nullopt and handler(query_index, documents)
+// with the FindTopDocuments results of every query, in the input order if
+// options.ordered. Queries are searched by worker threads while both callbacks run
+// on the calling thread, so they need no locking. At most options.max_in_flight
+// queries and their results are held at once, whatever the number of queries.
+// An exception of a query is rethrown at the place of its result
+void ProcessQueryStream(
+        const SearchServer& search_server,
+        const std::function<std::optional<std::string>()>& next_query,
+        const std::function<void(size_t, std::vector<Document>)>& handler,
+        const QueryStreamOptions& options = {});
+
+// Same for the queries of a range, e.g. a lazily read file
+template <typename QueryRange>
+void ProcessQueryRange(
+        const SearchServer& search_server,
+        const QueryRange& queries,
+        const std::function<void(size_t, std::vector<Document>)>& handler,
+        const QueryStreamOptions& options = {}) {
+    auto it = std::begin(queries);
+    const auto end = std::end(queries);
+    ProcessQueryStream(search_server, [&it, &end]() -> std::optional<std::string> {
+        if (it == end) {
+            return std::nullopt;
+        }
+        std::string query(*it);
+        ++it;
+        return query;
+    }, handler, options);
+}
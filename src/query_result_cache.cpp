@@ -0,0 +1,73 @@
+#include "query_result_cache.h"
+
+#include <algorithm>
+#include <functional>
+#include <stdexcept>
+
+
+using namespace std::string_literals;
+
+QueryResultCache::QueryResultCache(size_t capacity, size_t shard_count)
+    : shards_(shard_count) {
+    if (shard_count == 0) {
+        throw std::invalid_argument("shard count must be positive"s);
+    }
+    shard_capacity_ = std::max<size_t>(1, capacity / shard_count);
+}
+
+std::optional<std::vector<Document>> QueryResultCache::Find(const std::string& key, uint64_t generation) {
+    Shard& shard = GetShard(key);
+    {
+        std::lock_guard lock(shard.mutex);
+        const auto it = shard.index.find(key);
+        if (it != shard.index.end() && it->second->generation == generation) {
+            shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+            hits_.fetch_add(1, std::memory_order_relaxed);
+            return it->second->documents;
+        }
+    }
+    misses_.fetch_add(1, std::memory_order_relaxed);
+    return std::nullopt;
+}
+
+void QueryResultCache::Insert(const std::string& key, uint64_t generation, const std::vector<Document>& documents) {
+    Shard& shard = GetShard(key);
+    std::lock_guard lock(shard.mutex);
+    const auto it = shard.index.find(key);
+    if (it != shard.index.end()) {
+        if (generation < it->second->generation) {
+            return;
+        }
+        it->second->generation = generation;
+        it->second->documents = documents;
+        shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+        return;
+    }
+    if (shard.entries.size() == shard_capacity_) {
+        shard.index.erase(shard.entries.back().key);
+        shard.entries.pop_back();
+    }
+    shard.entries.push_front({key, generation, documents});
+    shard.index.emplace(key, shard.entries.begin());
+}
+
+QueryResultCacheStats QueryResultCache::GetStats() const {
+    size_t size = 0;
+    for (const Shard& shard : shards_) {
+        std::lock_guard lock(shard.mutex);
+        size += shard.entries.size();
+    }
+    return {hits_.load(std::memory_order_relaxed), misses_.load(std::memory_order_relaxed), size};
+}
+
+void QueryResultCache::Clear() {
+    for (Shard& shard : shards_) {
+        std::lock_guard lock(shard.mutex);
+        shard.index.clear();
+        shard.entries.clear();
+    }
+}
+
+QueryResultCache::Shard& QueryResultCache::GetShard(const std::string& key) {
+    return shards_[std::hash<std::string>{}(key) % shards_.size()];
+}
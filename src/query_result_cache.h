@@ -0,0 +1,68 @@
+#pragma once
+
+#include "document.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+
+struct QueryResultCacheStats {
+    uint64_t hits;
+    uint64_t misses;
+    size_t size;
+};
+
+// LRU cache of search results split into independently locked shards.
+// An entry is valid only for the index generation it was computed for, so
+// a change of the index invalidates all entries at once without touching them;
+// stale entries are overwritten or evicted as the least recently used ones.
+class QueryResultCache {
+public:
+    static const size_t DEFAULT_SHARD_COUNT = 16;
+
+    // Capacity is the number of entries over all shards, at least one per shard
+    explicit QueryResultCache(size_t capacity, size_t shard_count = DEFAULT_SHARD_COUNT);
+
+    QueryResultCache(const QueryResultCache&) = delete;
+
+    QueryResultCache& operator=(const QueryResultCache&) = delete;
+
+    // Counts a hit or a miss
+    std::optional<std::vector<Document>> Find(const std::string& key, uint64_t generation);
+
+    // An entry of a newer generation is kept: a search which started before a change
+    // of the index may finish after the one which started after it
+    void Insert(const std::string& key, uint64_t generation, const std::vector<Document>& documents);
+
+    QueryResultCacheStats GetStats() const;
+
+    void Clear();
+
+private:
+    struct Entry {
+        std::string key;
+        uint64_t generation;
+        std::vector<Document> documents;
+    };
+
+    struct Shard {
+        mutable std::mutex mutex;
+        // most recently used first
+        std::list<Entry> entries;
+        std::unordered_map<std::string, std::list<Entry>::iterator> index;
+    };
+
+    std::vector<Shard> shards_;
+    size_t shard_capacity_;
+    std::atomic<uint64_t> hits_{0};
+    std::atomic<uint64_t> misses_{0};
+
+    Shard& GetShard(const std::string& key);
+};
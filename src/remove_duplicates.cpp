@@ -1,28 +1,239 @@
 #include "remove_duplicates.h"
 
 #include <algorithm>
-#include <set>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <stdexcept>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 
 
-void RemoveDuplicates(SearchServer& search_server) {
-    std::vector<int> document_for_delete;
-    std::set<std::set<std::string_view>> document_words;
-    for (const int document_id : search_server) {
-        std::set<std::string_view> words;
-        for (const auto [word, freq] : search_server.GetWordFrequencies(document_id)) {
-            words.insert(word);
+using namespace std::string_literals;
+
+static const size_t MINHASH_SIZE = 64;
+static const double LSH_RECALL = 0.95;
+
+// splitmix64 finalizer, spreads the word hashes over independent hash functions
+static uint64_t Mix(uint64_t value) {
+    value = (value ^ (value >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    value = (value ^ (value >> 27)) * 0x94d049bb133111ebULL;
+    return value ^ (value >> 31);
+}
+
+// Words are hashed by their term ids, the bytes of the words are never read
+static uint64_t HashTerm(TermId term_id) {
+    return Mix(term_id);
+}
+
+struct Fingerprint {
+    uint64_t low = 0;
+    uint64_t high = 0;
+
+    bool operator==(const Fingerprint& other) const {
+        return low == other.low && high == other.high;
+    }
+};
+
+struct FingerprintHasher {
+    size_t operator()(const Fingerprint& fingerprint) const {
+        return fingerprint.low;
+    }
+};
+
+// Sums of two hashes of every word, so the order of words doesn't matter
+static Fingerprint ComputeFingerprint(const WordFrequencies& word_frequencies) {
+    Fingerprint fingerprint;
+    for (auto it = word_frequencies.begin(); it != word_frequencies.end(); ++it) {
+        const uint64_t hash = HashTerm(it.GetTermId());
+        fingerprint.low += Mix(hash ^ 0x9e3779b97f4a7c15ULL);
+        fingerprint.high += Mix(hash ^ 0xc2b2ae3d27d4eb4fULL);
+    }
+    return fingerprint;
+}
+
+static bool HaveSameWords(const WordFrequencies& lhs, const WordFrequencies& rhs) {
+    if (lhs.size() != rhs.size()) {
+        return false;
+    }
+    for (auto lhs_it = lhs.begin(), rhs_it = rhs.begin(); lhs_it != lhs.end(); ++lhs_it, ++rhs_it) {
+        if (lhs_it.GetTermId() != rhs_it.GetTermId()) {
+            return false;
         }
-        if (document_words.find(words) == document_words.end()) {
-            document_words.insert(words);
+    }
+    return true;
+}
+
+// Words of both views are sorted, so the intersection is one merge; the words
+// are read only to order different terms
+static double ComputeJaccardSimilarity(const WordFrequencies& lhs, const WordFrequencies& rhs) {
+    if (lhs.empty() && rhs.empty()) {
+        return 1.0;
+    }
+    size_t intersection_size = 0;
+    auto lhs_it = lhs.begin();
+    auto rhs_it = rhs.begin();
+    while (lhs_it != lhs.end() && rhs_it != rhs.end()) {
+        if (lhs_it.GetTermId() == rhs_it.GetTermId()) {
+            ++intersection_size;
+            ++lhs_it;
+            ++rhs_it;
+        } else if ((*lhs_it).first < (*rhs_it).first) {
+            ++lhs_it;
+        } else {
+            ++rhs_it;
+        }
+    }
+    return static_cast<double>(intersection_size) / (lhs.size() + rhs.size() - intersection_size);
+}
+
+static std::vector<uint64_t> ComputeMinHashSignature(const WordFrequencies& word_frequencies) {
+    std::vector<uint64_t> signature(MINHASH_SIZE, UINT64_MAX);
+    for (auto it = word_frequencies.begin(); it != word_frequencies.end(); ++it) {
+        const uint64_t hash = HashTerm(it.GetTermId());
+        for (size_t i = 0; i < MINHASH_SIZE; ++i) {
+            signature[i] = std::min(signature[i], Mix(hash + (i + 1) * 0x9e3779b97f4a7c15ULL));
+        }
+    }
+    return signature;
+}
+
+// The longest band for which a pair at the threshold shares a band with probability LSH_RECALL
+static size_t ComputeBandSize(double similarity_threshold) {
+    size_t band_size = 1;
+    for (size_t rows = 2; rows <= MINHASH_SIZE; rows *= 2) {
+        const double band_count = static_cast<double>(MINHASH_SIZE / rows);
+        const double recall = 1.0 - std::pow(1.0 - std::pow(similarity_threshold, rows), band_count);
+        if (recall < LSH_RECALL) {
+            break;
         }
-        else {
-            document_for_delete.push_back(document_id);
+        band_size = rows;
+    }
+    return band_size;
+}
+
+template<typename ExecutionPolicy>
+static std::vector<int> FindDuplicatesOf(ExecutionPolicy policy, const SearchServer& search_server) {
+    const std::vector<int> document_ids(search_server.begin(), search_server.end());
+    std::vector<Fingerprint> fingerprints(document_ids.size());
+    std::transform(policy, document_ids.begin(), document_ids.end(), fingerprints.begin(),
+            [&search_server](int document_id) {
+        return ComputeFingerprint(search_server.GetWordFrequencies(document_id));
+    });
+
+    // Originals by fingerprint, different word sets rarely share one
+    std::unordered_map<Fingerprint, std::vector<int>, FingerprintHasher> originals;
+    originals.reserve(document_ids.size());
+    std::vector<int> duplicates;
+    for (size_t i = 0; i < document_ids.size(); ++i) {
+        const WordFrequencies word_frequencies = search_server.GetWordFrequencies(document_ids[i]);
+        std::vector<int>& same_fingerprint = originals[fingerprints[i]];
+        const bool is_duplicate = std::any_of(same_fingerprint.begin(), same_fingerprint.end(),
+                [&search_server, &word_frequencies](int original_id) {
+            return HaveSameWords(search_server.GetWordFrequencies(original_id), word_frequencies);
+        });
+        if (is_duplicate) {
+            duplicates.push_back(document_ids[i]);
+        } else {
+            same_fingerprint.push_back(document_ids[i]);
         }
     }
-    for (const int id : document_for_delete) {
-        search_server.RemoveDocument(id);
-        std::cout << "Found duplicate document id " << id << std::endl;
+    return duplicates;
+}
+
+template<typename ExecutionPolicy>
+static std::vector<int> FindNearDuplicatesOf(ExecutionPolicy policy, const SearchServer& search_server,
+        double similarity_threshold) {
+    if (!(similarity_threshold > 0.0 && similarity_threshold <= 1.0)) {
+        throw std::invalid_argument("Similarity threshold must be in (0, 1]"s);
+    }
+    const std::vector<int> document_ids(search_server.begin(), search_server.end());
+    std::vector<std::vector<uint64_t>> signatures(document_ids.size());
+    std::transform(policy, document_ids.begin(), document_ids.end(), signatures.begin(),
+            [&search_server](int document_id) {
+        return ComputeMinHashSignature(search_server.GetWordFrequencies(document_id));
+    });
+
+    const size_t band_size = ComputeBandSize(similarity_threshold);
+    const size_t band_count = MINHASH_SIZE / band_size;
+    // Per band, indexes of the kept documents by the hash of their band
+    std::vector<std::unordered_map<uint64_t, std::vector<size_t>>> buckets(band_count);
+    std::vector<uint64_t> band_hashes(band_count);
+    // The document a kept one was last checked against, to check every pair once
+    std::vector<size_t> last_checked(document_ids.size(), SIZE_MAX);
+    std::vector<int> duplicates;
+    for (size_t i = 0; i < document_ids.size(); ++i) {
+        const WordFrequencies word_frequencies = search_server.GetWordFrequencies(document_ids[i]);
+        bool is_duplicate = false;
+        for (size_t band = 0; band < band_count && !is_duplicate; ++band) {
+            uint64_t band_hash = band;
+            for (size_t row = band * band_size; row < (band + 1) * band_size; ++row) {
+                band_hash = Mix(band_hash ^ signatures[i][row]);
+            }
+            band_hashes[band] = band_hash;
+            const auto bucket = buckets[band].find(band_hash);
+            if (bucket == buckets[band].end()) {
+                continue;
+            }
+            for (size_t candidate : bucket->second) {
+                if (last_checked[candidate] == i) {
+                    continue;
+                }
+                last_checked[candidate] = i;
+                if (ComputeJaccardSimilarity(search_server.GetWordFrequencies(document_ids[candidate]), word_frequencies)
+                        >= similarity_threshold) {
+                    is_duplicate = true;
+                    break;
+                }
+            }
+        }
+        if (is_duplicate) {
+            duplicates.push_back(document_ids[i]);
+            continue;
+        }
+        for (size_t band = 0; band < band_count; ++band) {
+            buckets[band][band_hashes[band]].push_back(i);
+        }
     }
+    return duplicates;
+}
+
+std::vector<int> FindDuplicates(const SearchServer& search_server) {
+    return FindDuplicatesOf(std::execution::seq, search_server);
+}
+
+std::vector<int> FindDuplicates(std::execution::sequenced_policy seq_policy, const SearchServer& search_server) {
+    return FindDuplicatesOf(seq_policy, search_server);
+}
+
+std::vector<int> FindDuplicates(std::execution::parallel_policy par_policy, const SearchServer& search_server) {
+    return FindDuplicatesOf(par_policy, search_server);
+}
+
+std::vector<int> FindNearDuplicates(const SearchServer& search_server, double similarity_threshold) {
+    return FindNearDuplicatesOf(std::execution::seq, search_server, similarity_threshold);
+}
+
+std::vector<int> FindNearDuplicates(std::execution::sequenced_policy seq_policy,
+        const SearchServer& search_server, double similarity_threshold) {
+    return FindNearDuplicatesOf(seq_policy, search_server, similarity_threshold);
+}
+
+std::vector<int> FindNearDuplicates(std::execution::parallel_policy par_policy,
+        const SearchServer& search_server, double similarity_threshold) {
+    return FindNearDuplicatesOf(par_policy, search_server, similarity_threshold);
+}
+
+std::vector<int> RemoveDuplicates(SearchServer& search_server) {
+    std::vector<int> duplicates = FindDuplicates(std::execution::par, search_server);
+    search_server.RemoveDocuments(duplicates);
+    return duplicates;
+}
+
+std::vector<int> RemoveDuplicates(SearchServer& search_server, double similarity_threshold) {
+    std::vector<int> duplicates = FindNearDuplicates(std::execution::par, search_server, similarity_threshold);
+    search_server.RemoveDocuments(duplicates);
+    return duplicates;
 }
@@ -2,5 +2,35 @@
 
 #include "search_server.h"
 
+#include <execution>
+#include <vector>
 
-void RemoveDuplicates(SearchServer& search_server);
+
+// Duplicates are documents with the same set of words as a document with a smaller id;
+// frequencies, word order and stop words don't matter. Returns their ids in ascending order.
+// Documents are compared by order-independent 128-bit fingerprints of their word sets,
+// documents with equal fingerprints are checked word by word. With par the fingerprints
+// are computed concurrently
+std::vector<int> FindDuplicates(const SearchServer& search_server);
+
+std::vector<int> FindDuplicates(std::execution::sequenced_policy seq_policy, const SearchServer& search_server);
+
+std::vector<int> FindDuplicates(std::execution::parallel_policy par_policy, const SearchServer& search_server);
+
+// Near duplicates are documents whose word sets have Jaccard similarity of at least
+// similarity_threshold with a document of smaller id which is not a near duplicate itself.
+// Candidates are found by MinHash signatures split into LSH bands and checked exactly,
+// so there are no false positives; a pair close to the threshold is missed with
+// a probability below 5%. Throws std::invalid_argument unless 0 < similarity_threshold <= 1
+std::vector<int> FindNearDuplicates(const SearchServer& search_server, double similarity_threshold);
+
+std::vector<int> FindNearDuplicates(std::execution::sequenced_policy seq_policy,
+        const SearchServer& search_server, double similarity_threshold);
+
+std::vector<int> FindNearDuplicates(std::execution::parallel_policy par_policy,
+        const SearchServer& search_server, double similarity_threshold);
+
+// Removes the duplicates with one RemoveDocuments call and returns their ids
+std::vector<int> RemoveDuplicates(SearchServer& search_server);
+
+std::vector<int> RemoveDuplicates(SearchServer& search_server, double similarity_threshold);
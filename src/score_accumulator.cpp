@@ -0,0 +1,7 @@
+#include "score_accumulator.h"
+
+
+ScoreAccumulator& GetThreadScoreAccumulator() {
+    static thread_local ScoreAccumulator accumulator;
+    return accumulator;
+}
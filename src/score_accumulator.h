@@ -0,0 +1,68 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+// Dense relevance accumulator indexed by document ordinal. A slot belongs to the
+// current query only if its epoch stamp matches, so Reset() costs O(1) and the
+// result walk costs O(touched) regardless of the number of documents.
+// Epoch is the unsigned type of the stamps; when the counter wraps, all the
+// stamps are cleared once
+template <typename Epoch>
+class BasicScoreAccumulator {
+public:
+    // Starts a new query over ordinals [0, ordinal_count)
+    void Reset(size_t ordinal_count);
+
+    void Add(int ordinal, double score) {
+        if (epochs_[ordinal] != epoch_) {
+            epochs_[ordinal] = epoch_;
+            scores_[ordinal] = 0.0;
+            touched_.push_back(ordinal);
+        }
+        scores_[ordinal] += score;
+    }
+
+    // Drops the document from the results of the current query
+    void Exclude(int ordinal) {
+        epochs_[ordinal] = 0;
+    }
+
+    // Calls function(ordinal, relevance) for every accumulated document
+    template <typename Function>
+    void ForEach(Function function) const {
+        for (const int ordinal : touched_) {
+            if (epochs_[ordinal] == epoch_) {
+                function(ordinal, scores_[ordinal]);
+            }
+        }
+    }
+
+private:
+    std::vector<double> scores_;
+    std::vector<Epoch> epochs_;    // 0 is never a current epoch
+    std::vector<int> touched_;
+    Epoch epoch_ = 0;
+};
+
+using ScoreAccumulator = BasicScoreAccumulator<uint32_t>;
+
+template <typename Epoch>
+void BasicScoreAccumulator<Epoch>::Reset(size_t ordinal_count) {
+    if (epochs_.size() < ordinal_count) {
+        epochs_.resize(ordinal_count, 0);
+        scores_.resize(ordinal_count, 0.0);
+    }
+    touched_.clear();
+    if (++epoch_ == 0) {
+        // stamps from the previous cycle of the counter must not look current
+        std::fill(epochs_.begin(), epochs_.end(), 0);
+        epoch_ = 1;
+    }
+}
+
+// Scratch accumulator of the calling thread, reused by all queries it runs
+ScoreAccumulator& GetThreadScoreAccumulator();
@@ -3,6 +3,8 @@
 #include "string_processing.h"
 
 #include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cmath>
 #include <execution>
 #include <numeric>
@@ -23,6 +25,7 @@ SearchServer::SearchServer(std::string_view stop_text)
 }
 
 void SearchServer::AddDocument(int document_id, const std::string_view& document, DocumentStatus status, const std::vector<int>& ratings) {
+    METRIC_SCOPE(Metric::ADD_DOCUMENT);
     if (document_id < 0) {
         throw std::invalid_argument("invalid document_id"s);
     }
@@ -30,59 +33,241 @@ void SearchServer::AddDocument(int document_id, const std::string_view& document
         throw std::invalid_argument("invalid document_id"s);
     }
     std::vector<std::string_view> words = SplitIntoWordsNoStop(document);
-    const double inv_word_count = 1.0 / words.size();
-    for (const auto& word : words) {
-        word_freqs_[document_id][std::string(word)] += inv_word_count;
-        word_to_document_freqs_[std::string(word)][document_id] += inv_word_count;
+    // the record goes first, a failed append leaves the index as it was
+    if (mutation_log_) {
+        sequence_number_ = mutation_log_->AppendAdd(document_id, document, status, ratings);
     }
-    documents_.emplace(document_id, DocumentData{ComputeAverageRating(ratings), status});
-    document_id_.insert(document_id);
+    {
+        METRIC_SCOPE(Metric::INDEX_UPDATE);
+        const double inv_word_count = 1.0 / words.size();
+        std::vector<TermId> term_ids;
+        term_ids.reserve(words.size());
+        for (const auto& word : words) {
+            term_ids.push_back(dictionary_.Intern(word));
+        }
+        word_to_document_freqs_.resize(dictionary_.size());
+        log_document_freqs_.resize(dictionary_.size());
+        const int ordinal = documents_.Add(document_id, status, ComputeAverageRating(ratings), inv_word_count);
+        std::sort(term_ids.begin(), term_ids.end());
+        std::vector<ForwardIndex::Entry> entries;
+        for (auto it = term_ids.begin(); it != term_ids.end();) {
+            const auto run_end = std::upper_bound(it, term_ids.end(), *it);
+            const uint32_t count = static_cast<uint32_t>(run_end - it);
+            entries.push_back({*it, 0, count * inv_word_count});
+            word_to_document_freqs_.Mutable(*it).Insert(ordinal, count, count * inv_word_count);
+            UpdateLogDocumentFreq(*it);
+            it = run_end;
+        }
+        std::sort(entries.begin(), entries.end(), [this](const ForwardIndex::Entry& lhs, const ForwardIndex::Entry& rhs) {
+            return dictionary_.GetTerm(lhs.term_id) < dictionary_.GetTerm(rhs.term_id);
+        });
+        std::copy(entries.begin(), entries.end(), forward_index_.Add(entries.size()));
+        document_id_.Insert(document_id);
+        log_document_count_ = log(documents_.size());
+    }
+    generation_ = NewGeneration();
+}
+
+IndexingStats SearchServer::AddDocuments(const std::vector<RawDocument>& documents) {
+    return SearchServer::AddDocuments(std::execution::seq, documents);
+}
+
+IndexingStats SearchServer::AddDocuments(std::execution::sequenced_policy seq_policy, const std::vector<RawDocument>& documents) {
+    return SearchServer::IndexDocuments(seq_policy, documents);
+}
+
+IndexingStats SearchServer::AddDocuments(std::execution::parallel_policy par_policy, const std::vector<RawDocument>& documents) {
+    return SearchServer::IndexDocuments(par_policy, documents);
 }
 
-std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, DocumentStatus status) const {
-    return SearchServer::FindTopDocuments(raw_query, [status](int document_id, DocumentStatus document_status, int document_rating)
-            { return document_status == status; }
-    );
+IndexingStats SearchServer::AddDocuments(Executor& executor, const std::vector<RawDocument>& documents) {
+    return SearchServer::IndexDocuments<Executor&>(executor, documents);
+}
+
+std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, DocumentStatus status,
+        size_t limit, size_t offset) const {
+    // the parse, the term lookup and the cache hits are a part of the search
+    METRIC_SCOPE(Metric::FIND_TOP_DOCUMENTS);
+    const Query query = ParseQuery(raw_query);
+    return SearchServer::FindCachedTopDocuments(query, status, limit, offset, [&]() {
+        return SearchServer::FindTopDocumentsSequential(ResolveQuery(query), [status](int document_id, DocumentStatus document_status, int document_rating)
+                { return document_status == status; },
+                limit, offset
+        );
+    });
 }
 
 std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query) const {
     return SearchServer::FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
 }
 
+std::vector<Document> SearchServer::FindTopDocuments(std::execution::sequenced_policy seq_policy,
+        std::string_view raw_query, DocumentStatus status, size_t limit, size_t offset) const {
+    return SearchServer::FindTopDocuments(raw_query, status, limit, offset);
+}
+
+std::vector<Document> SearchServer::FindTopDocuments(std::execution::parallel_policy par_policy,
+        std::string_view raw_query, DocumentStatus status, size_t limit, size_t offset) const {
+    METRIC_SCOPE(Metric::FIND_TOP_DOCUMENTS);
+    const Query query = ParseQuery(raw_query);
+    return SearchServer::FindCachedTopDocuments(query, status, limit, offset, [&]() {
+        return SearchServer::FindTopDocumentsParallel(par_policy, std::thread::hardware_concurrency(), ResolveQuery(query),
+                [status](int document_id, DocumentStatus document_status, int document_rating)
+                { return document_status == status; },
+                limit, offset
+        );
+    });
+}
+
+std::vector<Document> SearchServer::FindTopDocuments(std::execution::sequenced_policy seq_policy, std::string_view raw_query) const {
+    return SearchServer::FindTopDocuments(raw_query);
+}
+
+std::vector<Document> SearchServer::FindTopDocuments(std::execution::parallel_policy par_policy, std::string_view raw_query) const {
+    return SearchServer::FindTopDocuments(par_policy, raw_query, DocumentStatus::ACTUAL);
+}
+
+std::vector<Document> SearchServer::FindTopDocuments(Executor& executor,
+        std::string_view raw_query, DocumentStatus status, size_t limit, size_t offset) const {
+    METRIC_SCOPE(Metric::FIND_TOP_DOCUMENTS);
+    const Query query = ParseQuery(raw_query);
+    return SearchServer::FindCachedTopDocuments(query, status, limit, offset, [&]() {
+        return SearchServer::FindTopDocumentsParallel<Executor&>(executor, executor.GetConcurrency(), ResolveQuery(query),
+                [status](int document_id, DocumentStatus document_status, int document_rating)
+                { return document_status == status; },
+                limit, offset
+        );
+    });
+}
+
+std::vector<Document> SearchServer::FindTopDocuments(Executor& executor, std::string_view raw_query) const {
+    return SearchServer::FindTopDocuments(executor, raw_query, DocumentStatus::ACTUAL);
+}
+
+PreparedQuery SearchServer::Prepare(std::string_view raw_query) const {
+    const Query query = ParseQuery(raw_query);
+    // the words are copied into one buffer shared by the copies of the query
+    auto text = std::make_shared<std::string>();
+    for (const std::string_view word : query.plus_words) {
+        text->append(word);
+    }
+    for (const std::string_view word : query.minus_words) {
+        text->append(word);
+    }
+    PreparedQuery prepared_query;
+    std::string_view rest = *text;
+    for (const std::string_view word : query.plus_words) {
+        prepared_query.plus_words_.push_back(rest.substr(0, word.size()));
+        rest.remove_prefix(word.size());
+    }
+    for (const std::string_view word : query.minus_words) {
+        prepared_query.minus_words_.push_back(rest.substr(0, word.size()));
+        rest.remove_prefix(word.size());
+    }
+    prepared_query.text_ = std::move(text);
+    prepared_query.StoreTerms(ResolvePreparedTerms(prepared_query));
+    return prepared_query;
+}
+
+std::vector<Document> SearchServer::FindTopDocuments(const PreparedQuery& query, DocumentStatus status,
+        size_t limit, size_t offset) const {
+    // timed here and not in the predicate overload, which would record a cache miss twice
+    METRIC_SCOPE(Metric::FIND_TOP_DOCUMENTS);
+    return SearchServer::FindCachedTopDocuments(query, status, limit, offset, [&]() {
+        return SearchServer::FindTopDocumentsSequential(ResolveQuery(query), [status](int document_id, DocumentStatus document_status, int document_rating)
+                { return document_status == status; },
+                limit, offset
+        );
+    });
+}
+
+std::vector<Document> SearchServer::FindTopDocuments(const PreparedQuery& query) const {
+    return SearchServer::FindTopDocuments(query, DocumentStatus::ACTUAL);
+}
+
+std::vector<Document> SearchServer::FindTopDocuments(std::execution::sequenced_policy seq_policy,
+        const PreparedQuery& query, DocumentStatus status, size_t limit, size_t offset) const {
+    return SearchServer::FindTopDocuments(query, status, limit, offset);
+}
+
+std::vector<Document> SearchServer::FindTopDocuments(std::execution::parallel_policy par_policy,
+        const PreparedQuery& query, DocumentStatus status, size_t limit, size_t offset) const {
+    METRIC_SCOPE(Metric::FIND_TOP_DOCUMENTS);
+    return SearchServer::FindCachedTopDocuments(query, status, limit, offset, [&]() {
+        return SearchServer::FindTopDocumentsParallel(par_policy, std::thread::hardware_concurrency(), ResolveQuery(query),
+                [status](int document_id, DocumentStatus document_status, int document_rating)
+                { return document_status == status; },
+                limit, offset
+        );
+    });
+}
+
+std::vector<Document> SearchServer::FindTopDocuments(Executor& executor,
+        const PreparedQuery& query, DocumentStatus status, size_t limit, size_t offset) const {
+    METRIC_SCOPE(Metric::FIND_TOP_DOCUMENTS);
+    return SearchServer::FindCachedTopDocuments(query, status, limit, offset, [&]() {
+        return SearchServer::FindTopDocumentsParallel<Executor&>(executor, executor.GetConcurrency(), ResolveQuery(query),
+                [status](int document_id, DocumentStatus document_status, int document_rating)
+                { return document_status == status; },
+                limit, offset
+        );
+    });
+}
+
+std::vector<Document> SearchServer::FindTopDocuments(std::execution::sequenced_policy seq_policy, const PreparedQuery& query) const {
+    return SearchServer::FindTopDocuments(query);
+}
+
+std::vector<Document> SearchServer::FindTopDocuments(std::execution::parallel_policy par_policy, const PreparedQuery& query) const {
+    return SearchServer::FindTopDocuments(par_policy, query, DocumentStatus::ACTUAL);
+}
+
+std::vector<Document> SearchServer::FindTopDocuments(Executor& executor, const PreparedQuery& query) const {
+    return SearchServer::FindTopDocuments(executor, query, DocumentStatus::ACTUAL);
+}
+
 int SearchServer::GetDocumentCount() const {
     return document_id_.size();
 }
 
-std::set<int>::iterator SearchServer::begin() {
+DocumentIdSet::Iterator SearchServer::begin() const {
     return document_id_.begin();
 }
 
-std::set<int>::iterator SearchServer::end() {
+DocumentIdSet::Iterator SearchServer::end() const {
     return document_id_.end();
 }
 
-const std::map<std::string_view, double>& SearchServer::GetWordFrequencies(int document_id) const {
-    static std::map<std::string_view, double> empty;
-    if (!word_freqs_.count(document_id)) {
-        return empty;
+WordFrequencies SearchServer::GetWordFrequencies(int document_id) const {
+    if (!documents_.Contains(document_id)) {
+        return {};
     }
-    return (const std::map<std::basic_string_view<char>, double>&) word_freqs_.at(document_id);
+    const int ordinal = documents_.GetOrdinal(document_id);
+    return {forward_index_.GetEntries(ordinal), forward_index_.GetEntryCount(ordinal), &dictionary_};
 }
 
 void SearchServer::RemoveDocument(int document_id) {
-    if (document_id_.count(document_id) == 0) {
+    METRIC_SCOPE(Metric::REMOVE_DOCUMENT);
+    if (!document_id_.Contains(document_id)) {
         return;
     }
-    for(const auto& [word, freq] : word_freqs_.at(document_id)) {
-        word_to_document_freqs_.at(word).erase(document_id);
-        //  ,       
-        if (word_to_document_freqs_.at(word).size() == 0) {
-            word_to_document_freqs_.erase(word);
-        }
+    if (mutation_log_) {
+        sequence_number_ = mutation_log_->AppendRemove(document_id);
     }
-    word_freqs_.erase(document_id);
-    documents_.erase(document_id);
-    document_id_.erase(document_id);
+    const int ordinal = documents_.GetOrdinal(document_id);
+    const ForwardIndex::Entry* entries = forward_index_.GetEntries(ordinal);
+    const PostingList::TermFreqFunction term_freq = GetTermFreqFunction();
+    for (size_t i = 0; i < forward_index_.GetEntryCount(ordinal); ++i) {
+        // the slot of a term stays in place even when its postings become empty
+        word_to_document_freqs_.Mutable(entries[i].term_id).Erase(ordinal, term_freq);
+        UpdateLogDocumentFreq(entries[i].term_id);
+    }
+    forward_index_.Remove(ordinal);
+    documents_.Remove(document_id);
+    document_id_.Erase(document_id);
+    CompactOrdinals(std::execution::seq);
+    log_document_count_ = log(documents_.size());
+    generation_ = NewGeneration();
 }
 
 void SearchServer::RemoveDocument(std::execution::sequenced_policy seq_policy, int document_id) {
@@ -90,50 +275,117 @@ void SearchServer::RemoveDocument(std::execution::sequenced_policy seq_policy, i
 }
 
 void SearchServer::RemoveDocument(std::execution::parallel_policy par_policy, int document_id) {
-    if (document_id_.count(document_id) == 0) {
+    SearchServer::EraseDocument(par_policy, document_id);
+}
+
+void SearchServer::RemoveDocument(Executor& executor, int document_id) {
+    SearchServer::EraseDocument<Executor&>(executor, document_id);
+}
+
+template<typename ExecutionPolicy>
+void SearchServer::EraseDocument(ExecutionPolicy policy, int document_id) {
+    METRIC_SCOPE(Metric::REMOVE_DOCUMENT);
+    if (!document_id_.Contains(document_id)) {
+        return;
+    }
+    if (mutation_log_) {
+        sequence_number_ = mutation_log_->AppendRemove(document_id);
+    }
+    const int ordinal = documents_.GetOrdinal(document_id);
+    const ForwardIndex::Entry* entries = forward_index_.GetEntries(ordinal);
+    const PostingList::TermFreqFunction term_freq = GetTermFreqFunction();
+    for (size_t i = 0; i < forward_index_.GetEntryCount(ordinal); ++i) {
+        MakeTermWritable(entries[i].term_id);
+    }
+    // every term owns a separate slot, so threads never touch the same postings
+    ForEach(policy,
+            entries, entries + forward_index_.GetEntryCount(ordinal),
+            [ordinal, &term_freq, this](const ForwardIndex::Entry& entry) {
+        this->word_to_document_freqs_.Mutable(entry.term_id).Erase(ordinal, term_freq);
+        this->UpdateLogDocumentFreq(entry.term_id);
+    });
+    forward_index_.Remove(ordinal);
+    documents_.Remove(document_id);
+    document_id_.Erase(document_id);
+    CompactOrdinals<ExecutionPolicy>(policy);
+    log_document_count_ = log(documents_.size());
+    generation_ = NewGeneration();
+}
+
+template<typename ExecutionPolicy>
+void SearchServer::CompactOrdinals(ExecutionPolicy policy) {
+    const size_t removed_count = documents_.GetOrdinalCount() - documents_.size();
+    if (removed_count <= documents_.size() || removed_count < COMPACTION_MIN_REMOVED_ORDINALS) {
         return;
     }
-    std::vector<const std::string*> deleted_words;
-    for(const auto& [word, freq] : word_freqs_.at(document_id)) {
-        deleted_words.push_back(&word);
-    }
-    std::for_each(std::execution::par,
-            deleted_words.begin(), deleted_words.end(),
-            [document_id, this](const auto& word) {
-        this->word_to_document_freqs_.at(*word).erase(document_id);
-        //  ,       
-        //if (this->word_to_document_freqs_.at(*word).size() == 0) {
-        //    this->word_to_document_freqs_.erase(*word);
-        //}
-        return word;
+    // the order of the ordinals is kept, so the postings stay sorted
+    const std::vector<int> new_ordinals = documents_.Compact();
+    forward_index_.Compact(new_ordinals);
+    std::vector<TermId> term_ids(word_to_document_freqs_.size());
+    std::iota(term_ids.begin(), term_ids.end(), 0);
+    for (TermId term_id : term_ids) {
+        MakeTermWritable(term_id);
+    }
+    // every term owns a separate slot
+    const PostingList::TermFreqFunction term_freq = GetTermFreqFunction();
+    ForEach(policy, term_ids.begin(), term_ids.end(), [this, &new_ordinals, &term_freq](TermId term_id) {
+        word_to_document_freqs_.Mutable(term_id).Remap(new_ordinals, term_freq);
     });
-    word_freqs_.erase(document_id);
-    documents_.erase(document_id);
-    document_id_.erase(document_id);
+}
+
+void SearchServer::MakeTermWritable(TermId term_id) {
+    word_to_document_freqs_.Mutable(term_id);
+    log_document_freqs_.Mutable(term_id);
+}
+
+PostingList::TermFreqFunction SearchServer::GetTermFreqFunction() const {
+    return [this](int ordinal, uint32_t count) {
+        return count * documents_.GetInvWordCount(ordinal);
+    };
+}
+
+void SearchServer::RemoveDocuments(const std::vector<int>& document_ids) {
+    SearchServer::RemoveDocuments(std::execution::seq, document_ids);
+}
+
+void SearchServer::RemoveDocuments(std::execution::sequenced_policy seq_policy, const std::vector<int>& document_ids) {
+    SearchServer::EraseDocuments(seq_policy, document_ids);
+}
+
+void SearchServer::RemoveDocuments(std::execution::parallel_policy par_policy, const std::vector<int>& document_ids) {
+    SearchServer::EraseDocuments(par_policy, document_ids);
+}
+
+void SearchServer::RemoveDocuments(Executor& executor, const std::vector<int>& document_ids) {
+    SearchServer::EraseDocuments<Executor&>(executor, document_ids);
 }
 
 std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(const std::string_view& raw_query, int document_id) const {
+    METRIC_SCOPE(Metric::MATCH_DOCUMENT);
     Query query = ParseQuery(raw_query);
+    const int ordinal = documents_.GetOrdinal(document_id);
     std::vector<std::string_view> matched_words;
     for (const std::string_view& word : query.minus_words) {
-        if (word_to_document_freqs_.count(std::string(word)) == 0) {
+        const PostingList* postings = FindPostings(word);
+        if (postings == nullptr) {
             continue;
         }
         //       
-        if (word_to_document_freqs_.at(std::string(word)).count(document_id) != 0) {
+        if (postings->Contains(ordinal)) {
             matched_words.clear();
-            return {std::vector<std::string_view>{}, documents_.at(document_id).status};;
+            return {std::vector<std::string_view>{}, documents_.GetStatus(ordinal)};
         }
     }
     for (const std::string_view& word : query.plus_words) {
-        if (word_to_document_freqs_.count(std::string(word)) == 0) {
+        const PostingList* postings = FindPostings(word);
+        if (postings == nullptr) {
             continue;
         }
-        if (word_to_document_freqs_.at(std::string(word)).count(document_id)) {
+        if (postings->Contains(ordinal)) {
             matched_words.push_back(word);
         }
     }
-    return {matched_words, documents_.at(document_id).status};
+    return {matched_words, documents_.GetStatus(ordinal)};
 }
 
 std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(
@@ -149,26 +401,44 @@ std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDoc
         const std::string_view& raw_query,
         int document_id)
 const {
+    return SearchServer::MatchDocumentParallel(par_policy, raw_query, document_id);
+}
+
+std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(
+        Executor& executor,
+        const std::string_view& raw_query,
+        int document_id)
+const {
+    return SearchServer::MatchDocumentParallel<Executor&>(executor, raw_query, document_id);
+}
+
+template<typename ExecutionPolicy>
+std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocumentParallel(ExecutionPolicy policy,
+        std::string_view raw_query, int document_id) const {
+    METRIC_SCOPE(Metric::MATCH_DOCUMENT);
     QueryPar query = ParseQueryPar(raw_query);
-    if (std::any_of(std::execution::par, query.minus_words.begin(), query.minus_words.end(),
-            [document_id, this](const std::string_view word) {
-        if (!word_to_document_freqs_.count(std::string(word))) {
+    const int ordinal = documents_.GetOrdinal(document_id);
+    if (AnyOf(policy, query.minus_words.begin(), query.minus_words.end(),
+            [ordinal, this](const std::string_view word) {
+        const PostingList* postings = FindPostings(word);
+        if (postings == nullptr) {
             return false;
         }
-        if (word_to_document_freqs_.at(std::string(word)).count(document_id)) {
+        if (postings->Contains(ordinal)) {
             return true;
         }
         return false;
     })) {
-        return {std::vector<std::string_view>{}, documents_.at(document_id).status};
+        return {std::vector<std::string_view>{}, documents_.GetStatus(ordinal)};
     }
     std::vector<std::string_view> matched_words(query.plus_words.size());
-    std::transform(std::execution::par,
+    Transform(policy,
             query.plus_words.begin(), query.plus_words.end(),
             matched_words.begin(),
-            [document_id, this](std::string_view& word) {
-        if (word_to_document_freqs_.count(std::string(word))) {
-            if (word_to_document_freqs_.at(std::string(word)).count(document_id)) {
+            [ordinal, this](std::string_view& word) {
+        const PostingList* postings = FindPostings(word);
+        if (postings != nullptr) {
+            if (postings->Contains(ordinal)) {
             	return word;
             }
         }
@@ -177,21 +447,323 @@ const {
     std::sort(matched_words.begin(), matched_words.end());
     auto it = std::unique(matched_words.begin(), matched_words.end());
     matched_words.erase(it, matched_words.end());
-    if (*matched_words.begin() == ""s) {
+    if (!matched_words.empty() && matched_words.front().empty()) {
         matched_words.erase(matched_words.begin());
     }
-    return {matched_words, documents_.at(document_id).status};
+    return {matched_words, documents_.GetStatus(ordinal)};
+}
+
+std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> SearchServer::MatchDocuments(
+        std::string_view raw_query,
+        const std::vector<int>& document_ids)
+const {
+    return SearchServer::MatchDocumentsOf(std::execution::seq, ResolveQuery(ParseQuery(raw_query)), document_ids);
+}
+
+std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> SearchServer::MatchDocuments(
+        std::execution::sequenced_policy seq_policy,
+        std::string_view raw_query,
+        const std::vector<int>& document_ids)
+const {
+    return SearchServer::MatchDocumentsOf(seq_policy, ResolveQuery(ParseQuery(raw_query)), document_ids);
+}
+
+std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> SearchServer::MatchDocuments(
+        std::execution::parallel_policy par_policy,
+        std::string_view raw_query,
+        const std::vector<int>& document_ids)
+const {
+    return SearchServer::MatchDocumentsOf(par_policy, ResolveQuery(ParseQuery(raw_query)), document_ids);
+}
+
+std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> SearchServer::MatchDocuments(
+        Executor& executor,
+        std::string_view raw_query,
+        const std::vector<int>& document_ids)
+const {
+    return SearchServer::MatchDocumentsOf<Executor&>(executor, ResolveQuery(ParseQuery(raw_query)), document_ids);
+}
+
+std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(const PreparedQuery& query, int document_id) const {
+    return SearchServer::MatchPreparedQuery(std::execution::seq, query, document_id);
+}
+
+std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(
+        std::execution::sequenced_policy seq_policy,
+        const PreparedQuery& query,
+        int document_id)
+const {
+    return SearchServer::MatchPreparedQuery(seq_policy, query, document_id);
+}
+
+std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(
+        std::execution::parallel_policy par_policy,
+        const PreparedQuery& query,
+        int document_id)
+const {
+    return SearchServer::MatchPreparedQuery(par_policy, query, document_id);
+}
+
+std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchDocument(
+        Executor& executor,
+        const PreparedQuery& query,
+        int document_id)
+const {
+    return SearchServer::MatchPreparedQuery<Executor&>(executor, query, document_id);
+}
+
+std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> SearchServer::MatchDocuments(
+        const PreparedQuery& query,
+        const std::vector<int>& document_ids)
+const {
+    return SearchServer::MatchDocumentsOf(std::execution::seq, ResolveQuery(query), document_ids);
+}
+
+std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> SearchServer::MatchDocuments(
+        std::execution::sequenced_policy seq_policy,
+        const PreparedQuery& query,
+        const std::vector<int>& document_ids)
+const {
+    return SearchServer::MatchDocumentsOf(seq_policy, ResolveQuery(query), document_ids);
+}
+
+std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> SearchServer::MatchDocuments(
+        std::execution::parallel_policy par_policy,
+        const PreparedQuery& query,
+        const std::vector<int>& document_ids)
+const {
+    return SearchServer::MatchDocumentsOf(par_policy, ResolveQuery(query), document_ids);
+}
+
+std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> SearchServer::MatchDocuments(
+        Executor& executor,
+        const PreparedQuery& query,
+        const std::vector<int>& document_ids)
+const {
+    return SearchServer::MatchDocumentsOf<Executor&>(executor, ResolveQuery(query), document_ids);
+}
+
+template<typename ExecutionPolicy>
+std::tuple<std::vector<std::string_view>, DocumentStatus> SearchServer::MatchPreparedQuery(ExecutionPolicy policy,
+        const PreparedQuery& query, int document_id) const {
+    METRIC_SCOPE(Metric::MATCH_DOCUMENT);
+    const QueryTerms terms = ResolveQuery(query);
+    const int ordinal = documents_.GetOrdinal(document_id);
+    if (AnyOf(policy, terms.minus_postings.begin(), terms.minus_postings.end(),
+            [ordinal](const PostingList* postings) { return postings->Contains(ordinal); })) {
+        return {std::vector<std::string_view>{}, documents_.GetStatus(ordinal)};
+    }
+    std::vector<std::string_view> matched_words(terms.plus_terms.size());
+    Transform(policy,
+            terms.plus_terms.begin(), terms.plus_terms.end(),
+            matched_words.begin(),
+            [ordinal](const QueryTerm& term) {
+        return term.postings->Contains(ordinal) ? term.word : std::string_view{};
+    });
+    // the terms are sorted and distinct already, words are never empty
+    matched_words.erase(std::remove(matched_words.begin(), matched_words.end(), std::string_view{}), matched_words.end());
+    return {matched_words, documents_.GetStatus(ordinal)};
+}
+
+// Documents matched by one task, each range walks the posting lists from its first ordinal
+static const size_t MATCH_RANGE_SIZE = 1024;
+
+// The plus terms are in the order of the words, sorted and distinct as MatchDocument returns them
+template<typename ExecutionPolicy>
+std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> SearchServer::MatchDocumentsOf(
+        ExecutionPolicy policy, const QueryTerms& terms, const std::vector<int>& document_ids) const {
+    // (ordinal, index in document_ids), sorted so that a list is walked forward only
+    std::vector<std::pair<int, size_t>> ordinals(document_ids.size());
+    for (size_t i = 0; i < document_ids.size(); ++i) {
+        ordinals[i] = {documents_.GetOrdinal(document_ids[i]), i};
+    }
+    std::sort(ordinals.begin(), ordinals.end());
+
+    std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> result(document_ids.size());
+    std::vector<size_t> range_starts;
+    for (size_t start = 0; start < ordinals.size(); start += MATCH_RANGE_SIZE) {
+        range_starts.push_back(start);
+    }
+    // ranges write the results of their own documents only
+    ForEach(policy, range_starts.begin(), range_starts.end(), [&](size_t start) {
+        const auto first = ordinals.begin() + start;
+        const auto last = ordinals.begin() + std::min(start + MATCH_RANGE_SIZE, ordinals.size());
+        std::vector<bool> is_excluded(last - first, false);
+        for (const PostingList* postings : terms.minus_postings) {
+            PostingList::Iterator it = postings->begin();
+            for (auto ordinal = first; ordinal != last && !it.AtEnd(); ++ordinal) {
+                it.Advance(ordinal->first);
+                if (!it.AtEnd() && (*it).document_id == ordinal->first) {
+                    is_excluded[ordinal - first] = true;
+                }
+            }
+        }
+        for (const auto& [word, postings, inverse_document_freq] : terms.plus_terms) {
+            PostingList::Iterator it = postings->begin();
+            for (auto ordinal = first; ordinal != last && !it.AtEnd(); ++ordinal) {
+                it.Advance(ordinal->first);
+                if (!is_excluded[ordinal - first] && !it.AtEnd() && (*it).document_id == ordinal->first) {
+                    std::get<0>(result[ordinal->second]).push_back(word);
+                }
+            }
+        }
+        for (auto ordinal = first; ordinal != last; ++ordinal) {
+            std::get<1>(result[ordinal->second]) = documents_.GetStatus(ordinal->first);
+        }
+    });
+    return result;
+}
+
+void SearchServer::SaveIndex(const std::string& path) const {
+    SnapshotWriter writer(path);
+    writer.SetSequenceNumber(sequence_number_);
+    writer.BeginSection(SnapshotSection::STOP_WORDS);
+    writer.WriteStrings(stop_words_);
+    writer.BeginSection(SnapshotSection::TERMS);
+    dictionary_.Save(writer);
+    writer.BeginSection(SnapshotSection::POSTINGS);
+    PostingList::Save(word_to_document_freqs_, writer);
+    writer.WriteArray(log_document_freqs_);
+    writer.BeginSection(SnapshotSection::DOCUMENTS);
+    documents_.Save(writer);
+
+    writer.BeginSection(SnapshotSection::FORWARD_INDEX);
+    forward_index_.Save(writer);
+    writer.Commit();
+}
+
+SearchServer SearchServer::LoadIndex(const std::string& path, bool verify_checksum) {
+    const SnapshotReader reader(path, verify_checksum);
+    SnapshotCursor stop_words_cursor = reader.GetSection(SnapshotSection::STOP_WORDS);
+    const StringTable stop_word_table = stop_words_cursor.ReadStrings();
+    std::vector<std::string_view> stop_words(stop_word_table.count);
+    for (size_t i = 0; i < stop_word_table.count; ++i) {
+        stop_words[i] = stop_word_table.Get(i);
+    }
+    SearchServer server(stop_words);
+    server.snapshot_file_ = reader.GetFile();
+    server.sequence_number_ = reader.GetSequenceNumber();
+
+    SnapshotCursor terms_cursor = reader.GetSection(SnapshotSection::TERMS);
+    server.dictionary_ = TermDictionary::Load(terms_cursor);
+    // the documents come first, the postings are checked against their ordinals
+    SnapshotCursor documents_cursor = reader.GetSection(SnapshotSection::DOCUMENTS);
+    server.documents_ = DocumentStore::Load(documents_cursor, server.document_id_);
+    server.log_document_count_ = log(server.documents_.size());
+    SnapshotCursor postings_cursor = reader.GetSection(SnapshotSection::POSTINGS);
+    server.word_to_document_freqs_ = PostingList::Load(postings_cursor, server.documents_.GetOrdinalCount());
+    if (server.word_to_document_freqs_.size() != server.dictionary_.size()) {
+        throw std::runtime_error("corrupted index snapshot"s);
+    }
+    // the logarithms are saved with the postings instead of being recomputed for every term
+    const double* log_document_freqs = postings_cursor.ReadArray<double>(server.dictionary_.size());
+    server.log_document_freqs_.assign(log_document_freqs, log_document_freqs + server.dictionary_.size());
+    server.generation_ = NewGeneration();
+
+    SnapshotCursor forward_cursor = reader.GetSection(SnapshotSection::FORWARD_INDEX);
+    server.forward_index_ = ForwardIndex::Load(forward_cursor);
+    if (server.forward_index_.GetOrdinalCount() != server.documents_.GetOrdinalCount()) {
+        throw std::runtime_error("corrupted index snapshot"s);
+    }
+    return server;
+}
+
+size_t SearchServer::AttachMutationLog(std::shared_ptr<MutationLog> log) {
+    if (log == nullptr) {
+        throw std::invalid_argument("log must not be null"s);
+    }
+    // replayed mutations are not logged again
+    mutation_log_.reset();
+    const size_t record_count = log->ForEachRecord(sequence_number_, [this](const MutationRecord& record) {
+        // the records of a batch share its sequence number
+        const bool is_next_in_batch = record.sequence_number == sequence_number_;
+        if (record.sequence_number != sequence_number_ + 1 && !is_next_in_batch) {
+            throw std::runtime_error("mutation log doesn't continue the index"s);
+        }
+        if (record.type == MutationType::ADD) {
+            AddDocument(record.document_id, record.text, record.status, record.ratings);
+        } else {
+            RemoveDocument(record.document_id);
+        }
+        sequence_number_ = record.sequence_number;
+    });
+    if (log->GetLastSequenceNumber() > sequence_number_) {
+        throw std::runtime_error("mutation log doesn't continue the index"s);
+    }
+    if (log->GetLastSequenceNumber() < sequence_number_) {
+        // a new log after a snapshot, its records continue the numbering of the index
+        log->Truncate(sequence_number_);
+    }
+    mutation_log_ = std::move(log);
+    return record_count;
+}
+
+void SearchServer::Checkpoint(const std::string& path) {
+    SaveIndex(path);
+    if (mutation_log_) {
+        mutation_log_->Truncate(sequence_number_);
+    }
+}
+
+void SearchServer::AttachResultCache(std::shared_ptr<QueryResultCache> cache) {
+    result_cache_ = std::move(cache);
+}
+
+uint64_t SearchServer::GetGeneration() const {
+    return generation_;
+}
+
+uint64_t SearchServer::NewGeneration() {
+    static std::atomic<uint64_t> last_generation{0};
+    return last_generation.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
+std::string SearchServer::MakeResultCacheKey(const Query& query, DocumentStatus status,
+        size_t limit, size_t offset) {
+    return FormatResultCacheKey(query.plus_words, query.minus_words, status, limit, offset);
+}
+
+std::string SearchServer::MakeResultCacheKey(const PreparedQuery& query, DocumentStatus status,
+        size_t limit, size_t offset) {
+    return FormatResultCacheKey(query.plus_words_, query.minus_words_, status, limit, offset);
+}
+
+template<typename Words>
+std::string SearchServer::FormatResultCacheKey(const Words& plus_words, const Words& minus_words,
+        DocumentStatus status, size_t limit, size_t offset) {
+    // words can't contain spaces and control characters, so they separate the parts
+    std::string key = std::to_string(static_cast<int>(status)) + ' ' + std::to_string(limit) + ' ' + std::to_string(offset) + '\x01';
+    for (std::string_view word : plus_words) {
+        key.append(word).push_back(' ');
+    }
+    key.push_back('\x01');
+    for (std::string_view word : minus_words) {
+        key.append(word).push_back(' ');
+    }
+    return key;
+}
+
+template<typename QueryText, typename Finder>
+std::vector<Document> SearchServer::FindCachedTopDocuments(const QueryText& query, DocumentStatus status,
+        size_t limit, size_t offset, Finder finder) const {
+    if (!result_cache_) {
+        return finder();
+    }
+    const std::string key = MakeResultCacheKey(query, status, limit, offset);
+    std::optional<std::vector<Document>> documents = result_cache_->Find(key, generation_);
+    if (!documents) {
+        documents = finder();
+        result_cache_->Insert(key, generation_, *documents);
+    }
+    return *std::move(documents);
 }
 
 bool SearchServer::IsStopWord(const std::string_view& word) const {
-    return stop_words_.count(std::string(word)) > 0;
+    return stop_words_.Contains(word);
 }
 
 bool SearchServer::IdIsExists(int new_id) {
-    if (document_id_.count(new_id) > 0) {
-        return true;
-    }
-    return false;
+    return document_id_.Contains(new_id);
 }
 
 bool SearchServer::IsValidWord(const std::string_view& word) {
@@ -201,18 +773,224 @@ bool SearchServer::IsValidWord(const std::string_view& word) {
 }
 
 std::vector<std::string_view> SearchServer::SplitIntoWordsNoStop(const std::string_view& text) const {
+    METRIC_SCOPE(Metric::DOCUMENT_PARSE);
     std::vector<std::string_view> words;
-    for (const std::string_view& word : SplitIntoWords(text)) {
-        if (!IsValidWord(word)) {
-            throw std::invalid_argument("invalid char (with codes from 0 to 31)"s);
-        }
+    const bool is_valid = ForEachValidWord(text, [this, &words](std::string_view word) {
         if (!IsStopWord(word)) {
             words.push_back(word);
         }
+    });
+    if (!is_valid) {
+        throw std::invalid_argument("invalid char (with codes from 0 to 31)"s);
     }
     return words;
 }
 
+SearchServer::ParsedDocument SearchServer::ParseDocument(std::string_view text) const {
+    METRIC_SCOPE(Metric::DOCUMENT_PARSE);
+    ParsedDocument parsed_document;
+    std::vector<std::string_view> words;
+    parsed_document.is_valid = ForEachValidWord(text, [this, &words](std::string_view word) {
+        if (!IsStopWord(word)) {
+            words.push_back(word);
+        }
+    });
+    if (!parsed_document.is_valid) {
+        return parsed_document;
+    }
+    parsed_document.inv_word_count = 1.0 / words.size();
+    std::sort(words.begin(), words.end());
+    for (auto it = words.begin(); it != words.end();) {
+        const auto run_end = std::upper_bound(it, words.end(), *it);
+        parsed_document.words.push_back({*it, static_cast<uint32_t>(run_end - it), 0});
+        it = run_end;
+    }
+    return parsed_document;
+}
+
+void SearchServer::CheckNewDocumentIds(const std::vector<RawDocument>& documents) const {
+    std::vector<int> ids;
+    ids.reserve(documents.size());
+    for (const RawDocument& document : documents) {
+        if (document.id < 0 || document_id_.Contains(document.id)) {
+            throw std::invalid_argument("invalid document_id"s);
+        }
+        ids.push_back(document.id);
+    }
+    std::sort(ids.begin(), ids.end());
+    if (std::adjacent_find(ids.begin(), ids.end()) != ids.end()) {
+        throw std::invalid_argument("invalid document_id"s);
+    }
+}
+
+template<typename ExecutionPolicy>
+IndexingStats SearchServer::IndexDocuments(ExecutionPolicy policy, const std::vector<RawDocument>& documents) {
+    const auto start_time = std::chrono::steady_clock::now();
+    CheckNewDocumentIds(documents);
+    std::vector<ParsedDocument> parsed_documents(documents.size());
+    Transform(policy, documents.begin(), documents.end(), parsed_documents.begin(),
+            [this](const RawDocument& document) { return ParseDocument(document.text); });
+    for (const ParsedDocument& parsed_document : parsed_documents) {
+        if (!parsed_document.is_valid) {
+            throw std::invalid_argument("invalid char (with codes from 0 to 31)"s);
+        }
+    }
+    // the batch is one record and is on the disk before the index changes, so a failed
+    // write leaves the index as it was and a replay applies all the documents or none
+    if (mutation_log_ && !documents.empty()) {
+        MutationLog::Batch batch;
+        for (const RawDocument& document : documents) {
+            batch.AddDocument(document.id, document.text, document.status, document.ratings);
+        }
+        const uint64_t sequence_number = mutation_log_->AppendBatch(batch);
+        mutation_log_->WaitDurable(sequence_number);
+        sequence_number_ = sequence_number;
+    }
+
+    // Ordinals are handed out in the order of documents, as AddDocument does
+    std::vector<int> ordinals(documents.size());
+    std::vector<ForwardIndex::Entry*> document_entries(documents.size());
+    for (size_t i = 0; i < documents.size(); ++i) {
+        const RawDocument& document = documents[i];
+        ordinals[i] = documents_.Add(document.id, document.status, ComputeAverageRating(document.ratings),
+                parsed_documents[i].inv_word_count);
+        for (ParsedWord& parsed_word : parsed_documents[i].words) {
+            parsed_word.term_id = dictionary_.Intern(parsed_word.word);
+        }
+        document_entries[i] = forward_index_.Add(parsed_documents[i].words.size());
+        document_id_.Insert(document.id);
+    }
+    word_to_document_freqs_.resize(dictionary_.size());
+    log_document_freqs_.resize(dictionary_.size());
+
+    // Postings of the batch grouped by term, inside a group they are sorted by ordinal
+    struct BatchPosting {
+        int ordinal;
+        uint32_t count;
+        double term_freq;
+    };
+    std::vector<size_t> term_offsets(dictionary_.size() + 1, 0);
+    for (const ParsedDocument& parsed_document : parsed_documents) {
+        for (const ParsedWord& parsed_word : parsed_document.words) {
+            ++term_offsets[parsed_word.term_id + 1];
+        }
+    }
+    std::partial_sum(term_offsets.begin(), term_offsets.end(), term_offsets.begin());
+    std::vector<BatchPosting> batch_postings(term_offsets.back());
+    std::vector<size_t> term_positions(term_offsets.begin(), term_offsets.end() - 1);
+    for (size_t i = 0; i < documents.size(); ++i) {
+        const double inv_word_count = parsed_documents[i].inv_word_count;
+        for (const ParsedWord& parsed_word : parsed_documents[i].words) {
+            batch_postings[term_positions[parsed_word.term_id]++] = {ordinals[i], parsed_word.count, parsed_word.count * inv_word_count};
+        }
+    }
+    std::vector<TermId> changed_terms;
+    for (TermId term_id = 0; term_id < dictionary_.size(); ++term_id) {
+        if (term_offsets[term_id] != term_offsets[term_id + 1]) {
+            changed_terms.push_back(term_id);
+            MakeTermWritable(term_id);
+        }
+    }
+    // every term owns a separate slot, the new ordinals are appended to its postings
+    ForEach(policy, changed_terms.begin(), changed_terms.end(),
+            [this, &term_offsets, &batch_postings](TermId term_id) {
+        PostingList& postings = word_to_document_freqs_.Mutable(term_id);
+        for (size_t i = term_offsets[term_id]; i < term_offsets[term_id + 1]; ++i) {
+            postings.Insert(batch_postings[i].ordinal, batch_postings[i].count, batch_postings[i].term_freq);
+        }
+        UpdateLogDocumentFreq(term_id);
+    });
+    // the entries are already allocated, every document fills its own ones
+    std::vector<size_t> indexes(documents.size());
+    std::iota(indexes.begin(), indexes.end(), 0);
+    ForEach(policy, indexes.begin(), indexes.end(),
+            [&parsed_documents, &document_entries](size_t i) {
+        const double inv_word_count = parsed_documents[i].inv_word_count;
+        ForwardIndex::Entry* entry = document_entries[i];
+        // words are sorted, as the entries must be
+        for (const ParsedWord& parsed_word : parsed_documents[i].words) {
+            *entry++ = {parsed_word.term_id, 0, parsed_word.count * inv_word_count};
+        }
+    });
+    log_document_count_ = log(documents_.size());
+    generation_ = NewGeneration();
+
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+    return {documents.size(), seconds, seconds > 0.0 ? documents.size() / seconds : 0.0};
+}
+
+template<typename ExecutionPolicy>
+void SearchServer::EraseDocuments(ExecutionPolicy policy, const std::vector<int>& document_ids) {
+    std::vector<int> erased_ids;
+    for (int document_id : document_ids) {
+        if (document_id_.Contains(document_id)) {
+            erased_ids.push_back(document_id);
+        }
+    }
+    if (erased_ids.empty()) {
+        return;
+    }
+    std::sort(erased_ids.begin(), erased_ids.end());
+    erased_ids.erase(std::unique(erased_ids.begin(), erased_ids.end()), erased_ids.end());
+    // one durable record before the index changes, as in IndexDocuments
+    if (mutation_log_) {
+        MutationLog::Batch batch;
+        for (int document_id : erased_ids) {
+            batch.RemoveDocument(document_id);
+        }
+        const uint64_t sequence_number = mutation_log_->AppendBatch(batch);
+        mutation_log_->WaitDurable(sequence_number);
+        sequence_number_ = sequence_number;
+    }
+
+    // Tombstones: the documents leave the document table at once
+    std::vector<int> ordinals;
+    for (int document_id : erased_ids) {
+        document_id_.Erase(document_id);
+        ordinals.push_back(documents_.GetOrdinal(document_id));
+        documents_.Remove(document_id);
+    }
+    std::sort(ordinals.begin(), ordinals.end());
+
+    // Removed ordinals grouped by term, inside a group they are sorted
+    std::vector<size_t> term_offsets(dictionary_.size() + 1, 0);
+    for (int ordinal : ordinals) {
+        const ForwardIndex::Entry* entries = forward_index_.GetEntries(ordinal);
+        for (size_t i = 0; i < forward_index_.GetEntryCount(ordinal); ++i) {
+            ++term_offsets[entries[i].term_id + 1];
+        }
+    }
+    std::partial_sum(term_offsets.begin(), term_offsets.end(), term_offsets.begin());
+    std::vector<int> term_ordinals(term_offsets.back());
+    std::vector<size_t> term_positions(term_offsets.begin(), term_offsets.end() - 1);
+    std::vector<TermId> changed_terms;
+    for (int ordinal : ordinals) {
+        const ForwardIndex::Entry* entries = forward_index_.GetEntries(ordinal);
+        for (size_t i = 0; i < forward_index_.GetEntryCount(ordinal); ++i) {
+            const TermId term_id = entries[i].term_id;
+            if (term_positions[term_id] == term_offsets[term_id]) {
+                changed_terms.push_back(term_id);
+                MakeTermWritable(term_id);
+            }
+            term_ordinals[term_positions[term_id]++] = ordinal;
+        }
+        forward_index_.Remove(ordinal);
+    }
+
+    // Compaction: every term owns a separate slot
+    const PostingList::TermFreqFunction term_freq = GetTermFreqFunction();
+    ForEach(policy, changed_terms.begin(), changed_terms.end(),
+            [this, &term_offsets, &term_ordinals, &term_freq](TermId term_id) {
+        const std::vector<int> removed_ordinals(term_ordinals.begin() + term_offsets[term_id],
+                term_ordinals.begin() + term_offsets[term_id + 1]);
+        word_to_document_freqs_.Mutable(term_id).Erase(removed_ordinals, term_freq);
+        UpdateLogDocumentFreq(term_id);
+    });
+    CompactOrdinals<ExecutionPolicy>(policy);
+    log_document_count_ = log(documents_.size());
+    generation_ = NewGeneration();
+}
+
 int SearchServer::ComputeAverageRating(const std::vector<int>& ratings) {
     if (ratings.empty()) {
         return 0;
@@ -242,11 +1020,9 @@ SearchServer::QueryWord SearchServer::ParseQueryWord(std::string_view text) cons
 }
 
 SearchServer::Query SearchServer::ParseQuery(const std::string_view& text) const {
+    METRIC_SCOPE(Metric::QUERY_PARSE);
     Query query;
-    for (const std::string_view& word : SplitIntoWords(text)) {
-        if (!IsValidWord(word)) {
-            throw std::invalid_argument("invalid char (with codes from 0 to 31)"s);
-        }
+    const bool is_valid = ForEachValidWord(text, [this, &query](std::string_view word) {
         const QueryWord query_word = ParseQueryWord(word);
         if (!query_word.is_stop) {
             if (query_word.is_minus) {
@@ -255,16 +1031,17 @@ SearchServer::Query SearchServer::ParseQuery(const std::string_view& text) const
                 query.plus_words.insert(query_word.data);
             }
         }
+    });
+    if (!is_valid) {
+        throw std::invalid_argument("invalid char (with codes from 0 to 31)"s);
     }
     return query;
 }
 
 SearchServer::QueryPar SearchServer::ParseQueryPar(const std::string_view& text) const {
+    METRIC_SCOPE(Metric::QUERY_PARSE);
     QueryPar query;
-    for (const std::string_view& word : SplitIntoWords(text)) {
-        if (!IsValidWord(word)) {
-            throw std::invalid_argument("invalid char (with codes from 0 to 31)"s);
-        }
+    const bool is_valid = ForEachValidWord(text, [this, &query](std::string_view word) {
         const QueryWord query_word = ParseQueryWord(word);
         if (!query_word.is_stop) {
             if (query_word.is_minus) {
@@ -273,10 +1050,107 @@ SearchServer::QueryPar SearchServer::ParseQueryPar(const std::string_view& text)
                 query.plus_words.push_back(query_word.data);
             }
         }
+    });
+    if (!is_valid) {
+        throw std::invalid_argument("invalid char (with codes from 0 to 31)"s);
     }
     return query;
 }
 
-double SearchServer::ComputeWordInverseDocumentFreq(const std::string_view& word) const {
-    return log(documents_.size() * 1.0 / word_to_document_freqs_.at(std::string(word)).size());
+std::optional<TermId> SearchServer::FindTerm(std::string_view word) const {
+    const std::optional<TermId> term_id = dictionary_.Find(word);
+    if (!term_id || word_to_document_freqs_[*term_id].empty()) {
+        return std::nullopt;
+    }
+    return term_id;
+}
+
+const PostingList* SearchServer::FindPostings(std::string_view word) const {
+    const std::optional<TermId> term_id = FindTerm(word);
+    if (!term_id) {
+        return nullptr;
+    }
+    return &word_to_document_freqs_[*term_id];
+}
+
+SearchServer::QueryTerms SearchServer::ResolveQuery(const Query& query, const std::vector<double>* inverse_document_freqs) const {
+    METRIC_SCOPE(Metric::TERM_LOOKUP);
+    QueryTerms terms;
+    size_t word_index = 0;
+    for (const std::string_view& word : query.plus_words) {
+        const std::optional<TermId> term_id = FindTerm(word);
+        if (term_id) {
+            const PostingList* postings = &word_to_document_freqs_[*term_id];
+            const double inverse_document_freq = inverse_document_freqs != nullptr
+                    ? (*inverse_document_freqs)[word_index]
+                    : ComputeWordInverseDocumentFreq(*term_id);
+            terms.plus_terms.push_back({word, postings, inverse_document_freq});
+            terms.posting_count += postings->size();
+        }
+        ++word_index;
+    }
+    for (const std::string_view& word : query.minus_words) {
+        const PostingList* postings = FindPostings(word);
+        if (postings != nullptr) {
+            terms.minus_postings.push_back(postings);
+        }
+    }
+    return terms;
+}
+
+SearchServer::QueryTerms SearchServer::ResolveQuery(const PreparedQuery& query) const {
+    std::shared_ptr<const PreparedQuery::Terms> prepared_terms = query.LoadTerms();
+    if (!prepared_terms || prepared_terms->generation != generation_) {
+        // once per change of the index; threads which race here resolve the same terms
+        prepared_terms = ResolvePreparedTerms(query);
+        query.StoreTerms(prepared_terms);
+    }
+    METRIC_SCOPE(Metric::TERM_LOOKUP);
+    QueryTerms terms;
+    for (const PreparedQuery::Term& term : prepared_terms->plus_terms) {
+        const PostingList* postings = &word_to_document_freqs_[term.term_id];
+        terms.plus_terms.push_back({term.word, postings, term.inverse_document_freq});
+        terms.posting_count += postings->size();
+    }
+    for (const PreparedQuery::Term& term : prepared_terms->minus_terms) {
+        terms.minus_postings.push_back(&word_to_document_freqs_[term.term_id]);
+    }
+    return terms;
+}
+
+std::shared_ptr<const PreparedQuery::Terms> SearchServer::ResolvePreparedTerms(const PreparedQuery& query) const {
+    METRIC_SCOPE(Metric::TERM_LOOKUP);
+    auto terms = std::make_shared<PreparedQuery::Terms>();
+    terms->generation = generation_;
+    // the plus terms keep the order of the words, so the relevance is summed up
+    // exactly as for the raw query
+    for (const std::string_view word : query.plus_words_) {
+        if (const std::optional<TermId> term_id = FindTerm(word)) {
+            terms->plus_terms.push_back({word, *term_id, ComputeWordInverseDocumentFreq(*term_id)});
+        }
+    }
+    for (const std::string_view word : query.minus_words_) {
+        if (const std::optional<TermId> term_id = FindTerm(word)) {
+            terms->minus_terms.push_back({word, *term_id, 0.0});
+        }
+    }
+    std::stable_sort(terms->minus_terms.begin(), terms->minus_terms.end(),
+            [this](const PreparedQuery::Term& lhs, const PreparedQuery::Term& rhs) {
+        return word_to_document_freqs_[lhs.term_id].size() > word_to_document_freqs_[rhs.term_id].size();
+    });
+    return terms;
+}
+
+double SearchServer::ComputeInverseDocumentFreq(size_t document_count, size_t document_freq) {
+    // the same expression as the cached log_document_count_ - log_document_freqs_[term_id]
+    return log(document_count) - log(document_freq);
+}
+
+double SearchServer::ComputeWordInverseDocumentFreq(TermId term_id) const {
+    return log_document_count_ - log_document_freqs_[term_id];
+}
+
+void SearchServer::UpdateLogDocumentFreq(TermId term_id) {
+    // the value of an empty list is never read
+    log_document_freqs_.Mutable(term_id) = log(word_to_document_freqs_[term_id].size());
 }
@@ -1,26 +1,61 @@
 #pragma once
 
 #include "string_processing.h"
+#include "cow_vector.h"
 #include "document.h"
+#include "document_id_set.h"
+#include "document_store.h"
+#include "executor.h"
+#include "forward_index.h"
+#include "index_snapshot.h"
+#include "mapped_file.h"
+#include "metrics.h"
+#include "mutation_log.h"
+#include "posting_list.h"
+#include "prepared_query.h"
+#include "query_result_cache.h"
+#include "score_accumulator.h"
+#include "stop_word_set.h"
+#include "term_dictionary.h"
+#include "top_documents.h"
 
 #include <algorithm>
+#include <chrono>
 #include <execution>
 #include <iostream>
-#include <map>
+#include <limits>
+#include <memory>
+#include <numeric>
+#include <optional>
 #include <set>
 #include <string>
 #include <string_view>
+#include <thread>
 #include <vector>
 
 
 const int MAX_RESULT_DOCUMENT_COUNT = 5;
-const double EPS = 1e-6;    // allowable error;
+
+// A document for the batch AddDocuments, the text must outlive the call
+struct RawDocument {
+    int id;
+    std::string_view text;
+    DocumentStatus status;
+    std::vector<int> ratings;
+};
+
+struct IndexingStats {
+    size_t document_count;
+    double seconds;
+    double documents_per_second;
+};
 
 class SearchServer {
 public:
+    // Also accepts a StaticStopWordSet, whose hash table is built at compile time
     template<typename StringCollection>
     SearchServer(const StringCollection& stop_words)
-        : stop_words_(MakeUniqueNonEmptyStrings(stop_words))
+        : stop_words_(stop_words)
     {
         using namespace std::string_literals;
         for (const std::string& stop_word : stop_words_) {
@@ -36,22 +71,123 @@ public:
 
     void AddDocument(int document_id, const std::string_view& document, DocumentStatus status, const std::vector<int>& ratings);
 
+    // Same index as AddDocument called for every document in order. All ids and texts
+    // are checked before the index is changed, so on std::invalid_argument nothing
+    // is added. With par the documents are tokenized concurrently
+    IndexingStats AddDocuments(const std::vector<RawDocument>& documents);
+
+    IndexingStats AddDocuments(std::execution::sequenced_policy seq_policy, const std::vector<RawDocument>& documents);
+
+    IndexingStats AddDocuments(std::execution::parallel_policy par_policy, const std::vector<RawDocument>& documents);
+
+    // Like par, but the work runs on executor
+    IndexingStats AddDocuments(Executor& executor, const std::vector<RawDocument>& documents);
+
+    // limit and offset select a page of the ranked results
     template<typename Predicate>
-    std::vector<Document> FindTopDocuments(std::string_view raw_query, Predicate predicate) const;
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, Predicate predicate,
+            size_t limit = MAX_RESULT_DOCUMENT_COUNT, size_t offset = 0) const;
 
-    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status) const;
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status,
+            size_t limit = MAX_RESULT_DOCUMENT_COUNT, size_t offset = 0) const;
 
     std::vector<Document> FindTopDocuments(std::string_view raw_query) const;
 
+    // The results are the same as for the overloads without a policy. With par the
+    // documents are split into shards searched concurrently, so predicate is called
+    // from several threads at once
+    template<typename Predicate>
+    std::vector<Document> FindTopDocuments(std::execution::sequenced_policy seq_policy,
+            std::string_view raw_query, Predicate predicate,
+            size_t limit = MAX_RESULT_DOCUMENT_COUNT, size_t offset = 0) const;
+
+    template<typename Predicate>
+    std::vector<Document> FindTopDocuments(std::execution::parallel_policy par_policy,
+            std::string_view raw_query, Predicate predicate,
+            size_t limit = MAX_RESULT_DOCUMENT_COUNT, size_t offset = 0) const;
+
+    std::vector<Document> FindTopDocuments(std::execution::sequenced_policy seq_policy,
+            std::string_view raw_query, DocumentStatus status,
+            size_t limit = MAX_RESULT_DOCUMENT_COUNT, size_t offset = 0) const;
+
+    std::vector<Document> FindTopDocuments(std::execution::parallel_policy par_policy,
+            std::string_view raw_query, DocumentStatus status,
+            size_t limit = MAX_RESULT_DOCUMENT_COUNT, size_t offset = 0) const;
+
+    std::vector<Document> FindTopDocuments(std::execution::sequenced_policy seq_policy, std::string_view raw_query) const;
+
+    std::vector<Document> FindTopDocuments(std::execution::parallel_policy par_policy, std::string_view raw_query) const;
+
+    // Like par, with as many shards as executor runs tasks at once
+    template<typename Predicate>
+    std::vector<Document> FindTopDocuments(Executor& executor,
+            std::string_view raw_query, Predicate predicate,
+            size_t limit = MAX_RESULT_DOCUMENT_COUNT, size_t offset = 0) const;
+
+    std::vector<Document> FindTopDocuments(Executor& executor,
+            std::string_view raw_query, DocumentStatus status,
+            size_t limit = MAX_RESULT_DOCUMENT_COUNT, size_t offset = 0) const;
+
+    std::vector<Document> FindTopDocuments(Executor& executor, std::string_view raw_query) const;
+
+    // Parses the query and resolves its words against the index, for queries run
+    // again and again. Throws std::invalid_argument as the searches do
+    PreparedQuery Prepare(std::string_view raw_query) const;
+
+    // The same searches for a prepared query, with the same results
+    template<typename Predicate>
+    std::vector<Document> FindTopDocuments(const PreparedQuery& query, Predicate predicate,
+            size_t limit = MAX_RESULT_DOCUMENT_COUNT, size_t offset = 0) const;
+
+    std::vector<Document> FindTopDocuments(const PreparedQuery& query, DocumentStatus status,
+            size_t limit = MAX_RESULT_DOCUMENT_COUNT, size_t offset = 0) const;
+
+    std::vector<Document> FindTopDocuments(const PreparedQuery& query) const;
+
+    template<typename Predicate>
+    std::vector<Document> FindTopDocuments(std::execution::sequenced_policy seq_policy,
+            const PreparedQuery& query, Predicate predicate,
+            size_t limit = MAX_RESULT_DOCUMENT_COUNT, size_t offset = 0) const;
+
+    template<typename Predicate>
+    std::vector<Document> FindTopDocuments(std::execution::parallel_policy par_policy,
+            const PreparedQuery& query, Predicate predicate,
+            size_t limit = MAX_RESULT_DOCUMENT_COUNT, size_t offset = 0) const;
+
+    template<typename Predicate>
+    std::vector<Document> FindTopDocuments(Executor& executor,
+            const PreparedQuery& query, Predicate predicate,
+            size_t limit = MAX_RESULT_DOCUMENT_COUNT, size_t offset = 0) const;
+
+    std::vector<Document> FindTopDocuments(std::execution::sequenced_policy seq_policy,
+            const PreparedQuery& query, DocumentStatus status,
+            size_t limit = MAX_RESULT_DOCUMENT_COUNT, size_t offset = 0) const;
+
+    std::vector<Document> FindTopDocuments(std::execution::parallel_policy par_policy,
+            const PreparedQuery& query, DocumentStatus status,
+            size_t limit = MAX_RESULT_DOCUMENT_COUNT, size_t offset = 0) const;
+
+    std::vector<Document> FindTopDocuments(Executor& executor,
+            const PreparedQuery& query, DocumentStatus status,
+            size_t limit = MAX_RESULT_DOCUMENT_COUNT, size_t offset = 0) const;
+
+    std::vector<Document> FindTopDocuments(std::execution::sequenced_policy seq_policy, const PreparedQuery& query) const;
+
+    std::vector<Document> FindTopDocuments(std::execution::parallel_policy par_policy, const PreparedQuery& query) const;
+
+    std::vector<Document> FindTopDocuments(Executor& executor, const PreparedQuery& query) const;
+
     int GetDocumentCount() const;
 
     int GetDocumentId(int index) const;
 
-    std::set<int>::iterator begin();
+    // Ids of the documents in ascending order
+    DocumentIdSet::Iterator begin() const;
 
-    std::set<int>::iterator end();
+    DocumentIdSet::Iterator end() const;
 
-    const std::map<std::string_view, double>& GetWordFrequencies(int document_id) const;
+    // Empty for unknown document ids
+    WordFrequencies GetWordFrequencies(int document_id) const;
 
     void RemoveDocument(int document_id);
 
@@ -59,6 +195,21 @@ public:
 
     void RemoveDocument(std::execution::parallel_policy par_policy, int document_id);
 
+    void RemoveDocument(Executor& executor, int document_id);
+
+    // Same index as RemoveDocument called for every id, unknown ids are skipped.
+    // All the documents are removed from the document table first, then every
+    // affected posting list is compacted in one pass and its IDF updated once.
+    // With par the lists are compacted concurrently, each by a single thread.
+    // Ordinals are renumbered, if it's due, before the call returns, as in RemoveDocument
+    void RemoveDocuments(const std::vector<int>& document_ids);
+
+    void RemoveDocuments(std::execution::sequenced_policy seq_policy, const std::vector<int>& document_ids);
+
+    void RemoveDocuments(std::execution::parallel_policy par_policy, const std::vector<int>& document_ids);
+
+    void RemoveDocuments(Executor& executor, const std::vector<int>& document_ids);
+
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const std::string_view& raw_query, int document_id) const;
 
     std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(
@@ -71,17 +222,159 @@ public:
             const std::string_view& raw_query,
             int document_id) const;
 
-private:
-    struct DocumentData {
-        int rating;
-        DocumentStatus status;
-    };
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(
+            Executor& executor,
+            const std::string_view& raw_query,
+            int document_id) const;
+
+    // MatchDocument for every id of document_ids, the results are in the same order.
+    // The query is parsed once and every posting list of its words is walked once
+    // over the sorted documents; with par the documents are split into ranges which
+    // are matched concurrently. Throws std::out_of_range for unknown ids
+    std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> MatchDocuments(
+            std::string_view raw_query,
+            const std::vector<int>& document_ids) const;
+
+    std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> MatchDocuments(
+            std::execution::sequenced_policy seq_policy,
+            std::string_view raw_query,
+            const std::vector<int>& document_ids) const;
+
+    std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> MatchDocuments(
+            std::execution::parallel_policy par_policy,
+            std::string_view raw_query,
+            const std::vector<int>& document_ids) const;
+
+    std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> MatchDocuments(
+            Executor& executor,
+            std::string_view raw_query,
+            const std::vector<int>& document_ids) const;
+
+    // Matching of a prepared query, the words point into the query
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(const PreparedQuery& query, int document_id) const;
+
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(
+            std::execution::sequenced_policy seq_policy,
+            const PreparedQuery& query,
+            int document_id) const;
+
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(
+            std::execution::parallel_policy par_policy,
+            const PreparedQuery& query,
+            int document_id) const;
+
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(
+            Executor& executor,
+            const PreparedQuery& query,
+            int document_id) const;
 
-    std::set<std::string> stop_words_;
-    std::map<std::string, std::map<int, double>> word_to_document_freqs_;
-    std::map<int, std::map<std::string, double>> word_freqs_;
-    std::map<int, DocumentData> documents_;
-    std::set<int> document_id_;
+    std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> MatchDocuments(
+            const PreparedQuery& query,
+            const std::vector<int>& document_ids) const;
+
+    std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> MatchDocuments(
+            std::execution::sequenced_policy seq_policy,
+            const PreparedQuery& query,
+            const std::vector<int>& document_ids) const;
+
+    std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> MatchDocuments(
+            std::execution::parallel_policy par_policy,
+            const PreparedQuery& query,
+            const std::vector<int>& document_ids) const;
+
+    std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> MatchDocuments(
+            Executor& executor,
+            const PreparedQuery& query,
+            const std::vector<int>& document_ids) const;
+
+    // Writes a versioned snapshot of the index; the file at path is replaced only
+    // when the new snapshot is complete. Throws std::runtime_error on I/O errors
+    void SaveIndex(const std::string& path) const;
+
+    // Restores a server saved by SaveIndex. The file is mapped into memory and the
+    // terms and postings are searched in place, pages are read on first access.
+    // Throws std::runtime_error if the file is damaged or of another version.
+    // The document table and the offsets of the forward index are copied, so the load
+    // is O(documents) in any case, while the sorted ids and the IDF of the terms are
+    // read as they were saved, without a sort or a log() per term.
+    // With verify_checksum every byte of the file is read to check it, so the load
+    // costs a full scan of the file. Without it only the header, the layout and the
+    // ranges of the posting blocks are validated and untouched pages stay on disk:
+    // the ids inside the blocks and the term ids of the forward index are used as
+    // they are, so such a load is for files written by this program only, a damaged
+    // or foreign file may crash it
+    static SearchServer LoadIndex(const std::string& path, bool verify_checksum = true);
+
+    // Replays the records of log which are newer than the index (a loaded snapshot
+    // remembers its last record), then appends every AddDocument and RemoveDocument
+    // to log. The mutations are on the disk within the flush interval of the log;
+    // a batch AddDocuments or RemoveDocuments is one record, which is on the disk
+    // when the call returns.
+    // Returns the number of replayed records. Throws std::runtime_error if records
+    // between the index and the log are missing
+    size_t AttachMutationLog(std::shared_ptr<MutationLog> log);
+
+    // Saves a snapshot, then drops the records it contains from the attached log
+    void Checkpoint(const std::string& path);
+
+    // Results of FindTopDocuments with a status are looked up in cache by the parsed
+    // query (sorted plus and minus words), status, limit and offset before the index
+    // is searched. The cache may be shared by copies of the server; nullptr detaches it
+    void AttachResultCache(std::shared_ptr<QueryResultCache> cache);
+
+    // Unique in the process for every state of an index: changes with every mutation,
+    // copies share it until one of them changes
+    uint64_t GetGeneration() const;
+
+private:
+    StopWordSet stop_words_;
+    TermDictionary dictionary_;
+    // postings indexed by TermId, documents are referenced by their ordinals.
+    // The tables of the index are shared by the copies of the server chunk by chunk,
+    // so copying the server costs a pointer per chunk, see ConcurrentSearchServer
+    CowVector<PostingList> word_to_document_freqs_;
+    // logarithms of the posting list sizes and of the document count, so that
+    // a query reads the inverse document frequencies instead of computing them
+    CowVector<double> log_document_freqs_;
+    double log_document_count_ = 0.0;
+    // words of the documents by ordinal
+    ForwardIndex forward_index_;
+    DocumentStore documents_;
+    DocumentIdSet document_id_;
+    // snapshot the index was loaded from, dictionary_ and postings point into it
+    std::shared_ptr<const MappedFile> snapshot_file_;
+    std::shared_ptr<MutationLog> mutation_log_;
+    // of the last mutation log record applied to the index
+    uint64_t sequence_number_ = 0;
+    std::shared_ptr<QueryResultCache> result_cache_;
+    uint64_t generation_ = NewGeneration();
+
+    // Queries with fewer postings are scored exhaustively, pruning doesn't pay off there
+    static const size_t PRUNING_MIN_POSTINGS = 1024;
+    // The parallel search gives every shard at least this many postings
+    static const size_t PARALLEL_MIN_SHARD_POSTINGS = 4096;
+    // Ordinals of removed documents are compacted once there are more of them
+    // than of the stored documents, and at least this many
+    static const size_t COMPACTION_MIN_REMOVED_ORDINALS = 1024;
+
+    static uint64_t NewGeneration();
+
+    struct Query;
+
+    // The words of both kinds of query are sorted and distinct, so equal queries give equal keys
+    static std::string MakeResultCacheKey(const Query& query, DocumentStatus status, size_t limit, size_t offset);
+
+    static std::string MakeResultCacheKey(const PreparedQuery& query, DocumentStatus status, size_t limit, size_t offset);
+
+    // Words is a sorted container of distinct std::string_view, defined in search_server.cpp
+    template<typename Words>
+    static std::string FormatResultCacheKey(const Words& plus_words, const Words& minus_words,
+            DocumentStatus status, size_t limit, size_t offset);
+
+    // Calls finder() on a cache miss, QueryText is the parsed Query or PreparedQuery
+    template<typename QueryText, typename Finder>
+    std::vector<Document> FindCachedTopDocuments(const QueryText& query, DocumentStatus status,
+            size_t limit, size_t offset, Finder finder) const;
 
     bool IsStopWord(const std::string_view& word) const;
 
@@ -93,6 +386,89 @@ private:
 
     static int ComputeAverageRating(const std::vector<int>& ratings);
 
+    struct ParsedWord {
+        std::string_view word;
+        uint32_t count;
+        TermId term_id;    // set when the word is interned
+    };
+
+    // Distinct words of a document sorted by word
+    struct ParsedDocument {
+        std::vector<ParsedWord> words;
+        double inv_word_count = 0.0;
+        bool is_valid = true;    // false if the text has invalid chars
+    };
+
+    // Doesn't throw on invalid chars, so it can run inside parallel algorithms
+    ParsedDocument ParseDocument(std::string_view text) const;
+
+    struct QueryTerm {
+        std::string_view word;
+        const PostingList* postings;
+        double inverse_document_freq;
+    };
+
+    // Postings of the query words present in the index
+    struct QueryTerms {
+        std::vector<QueryTerm> plus_terms;
+        std::vector<const PostingList*> minus_postings;
+        size_t posting_count = 0;    // postings of the plus terms
+    };
+
+    // Throws std::invalid_argument for negative, present or repeated ids
+    void CheckNewDocumentIds(const std::vector<RawDocument>& documents) const;
+
+    // The batch AddDocuments, defined in search_server.cpp for the seq and par policies and Executor&
+    template<typename ExecutionPolicy>
+    IndexingStats IndexDocuments(ExecutionPolicy policy, const std::vector<RawDocument>& documents);
+
+    // The batch RemoveDocuments, defined in search_server.cpp for the seq and par policies and Executor&
+    template<typename ExecutionPolicy>
+    void EraseDocuments(ExecutionPolicy policy, const std::vector<int>& document_ids);
+
+    // The batch MatchDocuments, defined in search_server.cpp for the seq and par policies and Executor&
+    template<typename ExecutionPolicy>
+    std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> MatchDocumentsOf(ExecutionPolicy policy,
+            const QueryTerms& terms, const std::vector<int>& document_ids) const;
+
+    // MatchDocument of a prepared query, defined in search_server.cpp for the same policies
+    template<typename ExecutionPolicy>
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchPreparedQuery(ExecutionPolicy policy,
+            const PreparedQuery& query, int document_id) const;
+
+    // The parallel RemoveDocument and MatchDocument, defined in search_server.cpp
+    // for par and Executor&
+    template<typename ExecutionPolicy>
+    void EraseDocument(ExecutionPolicy policy, int document_id);
+
+    // Renumbers the stored documents densely when the removed ordinals outnumber them,
+    // so that the document columns, the forward index and the score accumulators
+    // don't keep growing with every removal. Defined in search_server.cpp for the
+    // seq and par policies and Executor&
+    template<typename ExecutionPolicy>
+    void CompactOrdinals(ExecutionPolicy policy);
+
+    // count * inv_word_count of the ordinal, recomputes the bounds of the posting blocks
+    PostingList::TermFreqFunction GetTermFreqFunction() const;
+
+    // Copies the chunks with the postings and the IDF of the term which are shared
+    // with copies of the server; called sequentially before parallel updates of
+    // terms, which then never copy a chunk concurrently
+    void MakeTermWritable(TermId term_id);
+
+    template<typename ExecutionPolicy>
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocumentParallel(ExecutionPolicy policy,
+            std::string_view raw_query, int document_id) const;
+
+    template<typename Predicate>
+    std::vector<Document> FindTopDocumentsSequential(const QueryTerms& terms, Predicate predicate,
+            size_t limit, size_t offset) const;
+
+    // The parallel search split into at most shard_limit shards
+    template<typename ExecutionPolicy, typename Predicate>
+    std::vector<Document> FindTopDocumentsParallel(ExecutionPolicy policy, size_t shard_limit,
+            const QueryTerms& terms, Predicate predicate, size_t limit, size_t offset) const;
+
     struct QueryWord {
         std::string_view data;
         bool is_minus;
@@ -115,59 +491,324 @@ private:
 
     QueryPar ParseQueryPar(const std::string_view& text) const;
 
-    double ComputeWordInverseDocumentFreq(const std::string_view& word) const;
+    // nullopt if the word is not present in any document
+    std::optional<TermId> FindTerm(std::string_view word) const;
+
+    // nullptr if the word is not present in any document
+    const PostingList* FindPostings(std::string_view word) const;
+
+    static double ComputeInverseDocumentFreq(size_t document_count, size_t document_freq);
+
+    double ComputeWordInverseDocumentFreq(TermId term_id) const;
+
+    // Refreshes the cached logarithm after the postings of the term have changed
+    void UpdateLogDocumentFreq(TermId term_id);
 
+    // inverse_document_freqs, if given, are used instead of the ones of this index
+    // for query.plus_words in the order of the set
+    QueryTerms ResolveQuery(const Query& query, const std::vector<double>* inverse_document_freqs = nullptr) const;
+
+    // Reads the terms of the prepared query; if they were resolved against another
+    // state of the index, looks its words up and keeps the new terms in the query
+    QueryTerms ResolveQuery(const PreparedQuery& query) const;
+
+    // The terms of the words of the prepared query in this index
+    std::shared_ptr<const PreparedQuery::Terms> ResolvePreparedTerms(const PreparedQuery& query) const;
+
+    // Documents with ordinals in [first, last)
+    struct OrdinalRange {
+        int first;
+        int last;
+    };
+
+    // posting_count is the number of the query postings within range,
+    // it selects between the exhaustive and the pruned search
     template<typename Predicate>
-    std::vector<Document> FindAllDocuments(const Query& query, Predicate predicate) const;
+    void FindDocumentsInRange(const QueryTerms& terms, Predicate predicate, OrdinalRange range,
+            size_t posting_count, TopDocuments& top_documents) const;
+
+    // Term-at-a-time: scores every posting of every plus word
+    template<typename Predicate>
+    void FindAllDocuments(const QueryTerms& terms, Predicate predicate, OrdinalRange range, TopDocuments& top_documents) const;
+
+    // Document-at-a-time MaxScore with block-max bounds: documents whose score upper
+    // bound can't get them into top_documents are skipped without scoring
+    template<typename Predicate>
+    void FindTopDocumentsPruned(const QueryTerms& terms, Predicate predicate, OrdinalRange range, TopDocuments& top_documents) const;
+
+    friend class ShardedSearchServer;
 };
 
 template<typename Predicate>
-std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, Predicate predicate) const {
-    const Query query = ParseQuery(raw_query);
-    auto matched_documents = SearchServer::FindAllDocuments(query, predicate);
-    sort(matched_documents.begin(), matched_documents.end(), [](const Document& lhs, const Document& rhs) {
-        const double delta = std::abs(lhs.relevance - rhs.relevance);    // compute equality with required precision;
-        if (delta < EPS) {
-            return lhs.rating > rhs.rating;
-        }
-        return lhs.relevance > rhs.relevance;
+std::vector<Document> SearchServer::FindTopDocuments(std::string_view raw_query, Predicate predicate,
+        size_t limit, size_t offset) const {
+    METRIC_SCOPE(Metric::FIND_TOP_DOCUMENTS);
+    return SearchServer::FindTopDocumentsSequential(ResolveQuery(ParseQuery(raw_query)), predicate, limit, offset);
+}
+
+template<typename Predicate>
+std::vector<Document> SearchServer::FindTopDocuments(const PreparedQuery& query, Predicate predicate,
+        size_t limit, size_t offset) const {
+    METRIC_SCOPE(Metric::FIND_TOP_DOCUMENTS);
+    return SearchServer::FindTopDocumentsSequential(ResolveQuery(query), predicate, limit, offset);
+}
+
+template<typename Predicate>
+std::vector<Document> SearchServer::FindTopDocumentsSequential(const QueryTerms& terms, Predicate predicate,
+        size_t limit, size_t offset) const {
+    TopDocuments top_documents(limit, offset);
+    const OrdinalRange range{0, static_cast<int>(documents_.GetOrdinalCount())};
+    SearchServer::FindDocumentsInRange(terms, predicate, range, terms.posting_count, top_documents);
+    METRIC_SCOPE(Metric::RESULT_BUILD);
+    return top_documents.Extract();
+}
+
+template<typename Predicate>
+std::vector<Document> SearchServer::FindTopDocuments(std::execution::sequenced_policy seq_policy,
+        std::string_view raw_query, Predicate predicate, size_t limit, size_t offset) const {
+    return SearchServer::FindTopDocuments(raw_query, predicate, limit, offset);
+}
+
+template<typename Predicate>
+std::vector<Document> SearchServer::FindTopDocuments(std::execution::parallel_policy par_policy,
+        std::string_view raw_query, Predicate predicate, size_t limit, size_t offset) const {
+    METRIC_SCOPE(Metric::FIND_TOP_DOCUMENTS);
+    return SearchServer::FindTopDocumentsParallel(par_policy, std::thread::hardware_concurrency(),
+            ResolveQuery(ParseQuery(raw_query)), predicate, limit, offset);
+}
+
+template<typename Predicate>
+std::vector<Document> SearchServer::FindTopDocuments(Executor& executor,
+        std::string_view raw_query, Predicate predicate, size_t limit, size_t offset) const {
+    METRIC_SCOPE(Metric::FIND_TOP_DOCUMENTS);
+    return SearchServer::FindTopDocumentsParallel<Executor&>(executor, executor.GetConcurrency(),
+            ResolveQuery(ParseQuery(raw_query)), predicate, limit, offset);
+}
+
+template<typename Predicate>
+std::vector<Document> SearchServer::FindTopDocuments(std::execution::sequenced_policy seq_policy,
+        const PreparedQuery& query, Predicate predicate, size_t limit, size_t offset) const {
+    return SearchServer::FindTopDocuments(query, predicate, limit, offset);
+}
+
+template<typename Predicate>
+std::vector<Document> SearchServer::FindTopDocuments(std::execution::parallel_policy par_policy,
+        const PreparedQuery& query, Predicate predicate, size_t limit, size_t offset) const {
+    METRIC_SCOPE(Metric::FIND_TOP_DOCUMENTS);
+    return SearchServer::FindTopDocumentsParallel(par_policy, std::thread::hardware_concurrency(),
+            ResolveQuery(query), predicate, limit, offset);
+}
+
+template<typename Predicate>
+std::vector<Document> SearchServer::FindTopDocuments(Executor& executor,
+        const PreparedQuery& query, Predicate predicate, size_t limit, size_t offset) const {
+    METRIC_SCOPE(Metric::FIND_TOP_DOCUMENTS);
+    return SearchServer::FindTopDocumentsParallel<Executor&>(executor, executor.GetConcurrency(),
+            ResolveQuery(query), predicate, limit, offset);
+}
+
+template<typename ExecutionPolicy, typename Predicate>
+std::vector<Document> SearchServer::FindTopDocumentsParallel(ExecutionPolicy policy, size_t shard_limit,
+        const QueryTerms& terms, Predicate predicate, size_t limit, size_t offset) const {
+    const size_t posting_count = terms.posting_count;
+    const size_t shard_count = std::max<size_t>(1, std::min<size_t>(shard_limit,
+            posting_count / PARALLEL_MIN_SHARD_POSTINGS));
+    // Ordinals grow with insertion, so equal ordinal ranges hold roughly equal postings
+    const int64_t ordinal_count = documents_.GetOrdinalCount();
+    std::vector<TopDocuments> shard_top_documents(shard_count, TopDocuments(limit, offset));
+    std::vector<size_t> shards(shard_count);
+    std::iota(shards.begin(), shards.end(), 0);
+    ForEach(policy, shards.begin(), shards.end(),
+            [this, &terms, &predicate, posting_count, shard_count, ordinal_count, &shard_top_documents](size_t shard) {
+        const OrdinalRange range{
+            static_cast<int>(ordinal_count * shard / shard_count),
+            static_cast<int>(ordinal_count * (shard + 1) / shard_count)
+        };
+        SearchServer::FindDocumentsInRange(terms, predicate, range, posting_count / shard_count, shard_top_documents[shard]);
     });
-    if (matched_documents.size() > MAX_RESULT_DOCUMENT_COUNT) {
-        matched_documents.resize(MAX_RESULT_DOCUMENT_COUNT);
+    METRIC_SCOPE(Metric::RESULT_BUILD);
+    TopDocuments top_documents(limit, offset);
+    for (const TopDocuments& shard_documents : shard_top_documents) {
+        top_documents.Merge(shard_documents);
     }
-    return matched_documents;
+    return top_documents.Extract();
 }
 
 template<typename Predicate>
-std::vector<Document> SearchServer::FindAllDocuments(const Query& query, Predicate predicate) const {
-    std::map<int, double> document_to_relevance;
-    for (const std::string_view& word : query.plus_words) {
-        if (word_to_document_freqs_.count(std::string(word)) == 0) {
-            continue;
+void SearchServer::FindDocumentsInRange(const QueryTerms& terms, Predicate predicate, OrdinalRange range,
+        size_t posting_count, TopDocuments& top_documents) const {
+    if (posting_count >= PRUNING_MIN_POSTINGS) {
+        SearchServer::FindTopDocumentsPruned(terms, predicate, range, top_documents);
+    } else {
+        SearchServer::FindAllDocuments(terms, predicate, range, top_documents);
+    }
+}
+
+template<typename Predicate>
+void SearchServer::FindAllDocuments(const QueryTerms& terms, Predicate predicate, OrdinalRange range, TopDocuments& top_documents) const {
+    ScoreAccumulator& ordinal_to_relevance = GetThreadScoreAccumulator();
+    {
+        METRIC_SCOPE(Metric::POSTING_TRAVERSAL);
+        ordinal_to_relevance.Reset(documents_.GetOrdinalCount());
+        for (const auto [word, postings, inverse_document_freq] : terms.plus_terms) {
+            PostingList::Iterator it = postings->begin();
+            for (it.Advance(range.first); !it.AtEnd() && (*it).document_id < range.last; ++it) {
+                const Posting posting = *it;
+                const int ordinal = posting.document_id;
+                if (predicate(documents_.GetId(ordinal), documents_.GetStatus(ordinal), documents_.GetRating(ordinal))) {
+                    const double term_freq = posting.count * documents_.GetInvWordCount(ordinal);
+                    ordinal_to_relevance.Add(ordinal, term_freq * inverse_document_freq);
+                }
+            }
         }
-        const double inverse_document_freq = ComputeWordInverseDocumentFreq(word);
-        for (const auto [document_id, term_freq] : word_to_document_freqs_.at(std::string(word))) {
-            const DocumentData& document_data = documents_.at(document_id);
-            if (predicate(document_id, document_data.status, document_data.rating)) {
-                document_to_relevance[document_id] += term_freq * inverse_document_freq;
+        for (const PostingList* postings : terms.minus_postings) {
+            PostingList::Iterator it = postings->begin();
+            for (it.Advance(range.first); !it.AtEnd() && (*it).document_id < range.last; ++it) {
+                ordinal_to_relevance.Exclude((*it).document_id);
             }
         }
     }
-    for (const std::string_view& word : query.minus_words) {
-        if (word_to_document_freqs_.count(std::string(word)) == 0) {
-            continue;
+    METRIC_SCOPE(Metric::TOP_K_SELECTION);
+    ordinal_to_relevance.ForEach([this, &top_documents](int ordinal, double relevance) {
+        top_documents.Push({
+            documents_.GetId(ordinal),
+            relevance,
+            documents_.GetRating(ordinal)
+        });
+    });
+}
+
+template<typename Predicate>
+void SearchServer::FindTopDocumentsPruned(const QueryTerms& terms, Predicate predicate, OrdinalRange range, TopDocuments& top_documents) const {
+    // documents are selected as they are scored, so the selection is a part of the traversal
+    METRIC_SCOPE(Metric::POSTING_TRAVERSAL);
+    const int no_document = std::numeric_limits<int>::max();
+    struct Cursor {
+        PostingList::Iterator iterator;
+        double inverse_document_freq;
+        double max_score;
+        int ordinal;    // current document, no_document when exhausted
+
+        void Next() {
+            ++iterator;
+            UpdateOrdinal();
         }
-        for (const auto [document_id, _] : word_to_document_freqs_.at(std::string(word))) {
-            document_to_relevance.erase(document_id);
+
+        void Advance(int target) {
+            iterator.Advance(target);
+            UpdateOrdinal();
+        }
+
+        void UpdateOrdinal() {
+            ordinal = iterator.AtEnd() ? std::numeric_limits<int>::max() : (*iterator).document_id;
+        }
+
+        double GetScore(double inv_word_count) const {
+            return (*iterator).count * inv_word_count * inverse_document_freq;
         }
+    };
+    // A cursor holds a decoded block of about a kilobyte, so the cursors stay
+    // in place and their pointers are sorted
+    std::vector<Cursor> cursor_storage;
+    cursor_storage.reserve(terms.plus_terms.size());
+    for (const auto [word, postings, inverse_document_freq] : terms.plus_terms) {
+        cursor_storage.push_back({postings->begin(), inverse_document_freq, postings->GetMaxTermFreq() * inverse_document_freq, 0});
+        cursor_storage.back().Advance(range.first);
     }
-    std::vector<Document> matched_documents;
-    for (const auto [document_id, relevance] : document_to_relevance) {
-        matched_documents.push_back({
-            document_id,
-            relevance,
-            documents_.at(document_id).rating
-        });
+    std::vector<PostingList::Iterator> minus_iterators;
+    minus_iterators.reserve(terms.minus_postings.size());
+    for (const PostingList* postings : terms.minus_postings) {
+        minus_iterators.push_back(postings->begin());
+    }
+    std::vector<Cursor*> cursors;
+    cursors.reserve(cursor_storage.size());
+    for (Cursor& cursor : cursor_storage) {
+        cursors.push_back(&cursor);
+    }
+    // upper_bounds[i] bounds the total score a document can get from cursors [0, i]
+    std::sort(cursors.begin(), cursors.end(), [](const Cursor* lhs, const Cursor* rhs) {
+        return lhs->max_score < rhs->max_score;
+    });
+    std::vector<double> upper_bounds;
+    double upper_bound = 0.0;
+    for (const Cursor* cursor : cursors) {
+        upper_bound += cursor->max_score;
+        upper_bounds.push_back(upper_bound);
+    }
+    // Only documents of the essential cursors [first_essential, size) are candidates:
+    // the others together can't reach the threshold
+    size_t first_essential = 0;
+    // A document can't get into a full collection unless it beats the worst one by
+    // more than EPS or ties with it, the extra EPS keeps rounding on the safe side
+    double threshold = -std::numeric_limits<double>::infinity();
+    const auto update_threshold = [&top_documents, &threshold, &first_essential, &upper_bounds, &cursors]() {
+        if (top_documents.IsFull()) {
+            threshold = top_documents.GetWorst().relevance - 2 * EPS;
+            while (first_essential < cursors.size() && upper_bounds[first_essential] <= threshold) {
+                ++first_essential;
+            }
+        }
+    };
+    // the collection may come full, e.g. from the other shards of a ShardedSearchServer
+    update_threshold();
+    int ordinal = no_document;
+    for (const Cursor* cursor : cursors) {
+        ordinal = std::min(ordinal, cursor->ordinal);
+    }
+    while (ordinal < range.last && first_essential < cursors.size()) {
+        const double inv_word_count = documents_.GetInvWordCount(ordinal);
+        double relevance = 0.0;
+        int next_ordinal = no_document;
+        for (size_t i = first_essential; i < cursors.size(); ++i) {
+            Cursor& cursor = *cursors[i];
+            if (cursor.ordinal == ordinal) {
+                relevance += cursor.GetScore(inv_word_count);
+                cursor.Next();
+            }
+            next_ordinal = std::min(next_ordinal, cursor.ordinal);
+        }
+        // Non-essential cursors from the strongest one, stop as soon as the rest can't
+        // lift the document over the threshold; the block bound is checked before
+        // the block is decoded
+        bool is_candidate = true;
+        for (size_t i = first_essential; i-- > 0;) {
+            if (relevance + upper_bounds[i] <= threshold) {
+                is_candidate = false;
+                break;
+            }
+            Cursor& cursor = *cursors[i];
+            if (cursor.ordinal > ordinal) {
+                continue;
+            }
+            const double rest_bound = i > 0 ? upper_bounds[i - 1] : 0.0;
+            const PostingList::BlockBound bound = cursor.iterator.GetBlockBound(ordinal);
+            if (relevance + bound.max_term_freq * cursor.inverse_document_freq + rest_bound <= threshold) {
+                is_candidate = false;
+                break;
+            }
+            cursor.Advance(ordinal);
+            if (cursor.ordinal == ordinal) {
+                relevance += cursor.GetScore(inv_word_count);
+            }
+        }
+        if (is_candidate && relevance > threshold) {
+            bool is_excluded = false;
+            for (PostingList::Iterator& minus_iterator : minus_iterators) {
+                minus_iterator.Advance(ordinal);
+                if (!minus_iterator.AtEnd() && (*minus_iterator).document_id == ordinal) {
+                    is_excluded = true;
+                    break;
+                }
+            }
+            if (!is_excluded && predicate(documents_.GetId(ordinal), documents_.GetStatus(ordinal), documents_.GetRating(ordinal))) {
+                top_documents.Push({
+                    documents_.GetId(ordinal),
+                    relevance,
+                    documents_.GetRating(ordinal)
+                });
+                update_threshold();
+            }
+        }
+        ordinal = next_ordinal;
     }
-    return matched_documents;
 }
@@ -0,0 +1,130 @@
+#include "sharded_search_server.h"
+#include "string_processing.h"
+
+#include <cstdint>
+
+
+ShardedSearchServer::ShardedSearchServer(const std::string& stop_text, size_t shard_count)
+        : ShardedSearchServer(std::string_view(stop_text), shard_count) {
+}
+
+ShardedSearchServer::ShardedSearchServer(std::string_view stop_text, size_t shard_count)
+        : ShardedSearchServer(SplitIntoWords(stop_text), shard_count) {
+}
+
+void ShardedSearchServer::AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings) {
+    // a document id always maps to the same shard, so the shard detects duplicates
+    GetShard(document_id).AddDocument(document_id, document, status, ratings);
+}
+
+std::vector<Document> ShardedSearchServer::FindTopDocuments(std::string_view raw_query, DocumentStatus status,
+        size_t limit, size_t offset) const {
+    return ShardedSearchServer::FindTopDocuments(raw_query, [status](int document_id, DocumentStatus document_status, int document_rating)
+            { return document_status == status; },
+            limit, offset
+    );
+}
+
+std::vector<Document> ShardedSearchServer::FindTopDocuments(std::string_view raw_query) const {
+    return ShardedSearchServer::FindTopDocuments(raw_query, DocumentStatus::ACTUAL);
+}
+
+std::vector<Document> ShardedSearchServer::FindTopDocuments(std::execution::sequenced_policy seq_policy,
+        std::string_view raw_query, DocumentStatus status, size_t limit, size_t offset) const {
+    return ShardedSearchServer::FindTopDocuments(raw_query, status, limit, offset);
+}
+
+std::vector<Document> ShardedSearchServer::FindTopDocuments(std::execution::sequenced_policy seq_policy, std::string_view raw_query) const {
+    return ShardedSearchServer::FindTopDocuments(raw_query);
+}
+
+std::vector<Document> ShardedSearchServer::FindTopDocuments(std::execution::parallel_policy par_policy,
+        std::string_view raw_query, DocumentStatus status, size_t limit, size_t offset) const {
+    return ShardedSearchServer::FindTopDocuments(par_policy, raw_query, [status](int document_id, DocumentStatus document_status, int document_rating)
+            { return document_status == status; },
+            limit, offset
+    );
+}
+
+std::vector<Document> ShardedSearchServer::FindTopDocuments(std::execution::parallel_policy par_policy, std::string_view raw_query) const {
+    return ShardedSearchServer::FindTopDocuments(par_policy, raw_query, DocumentStatus::ACTUAL);
+}
+
+int ShardedSearchServer::GetDocumentCount() const {
+    int document_count = 0;
+    for (const SearchServer& shard : shards_) {
+        document_count += shard.GetDocumentCount();
+    }
+    return document_count;
+}
+
+size_t ShardedSearchServer::GetShardCount() const {
+    return shards_.size();
+}
+
+WordFrequencies ShardedSearchServer::GetWordFrequencies(int document_id) const {
+    return GetShard(document_id).GetWordFrequencies(document_id);
+}
+
+void ShardedSearchServer::RemoveDocument(int document_id) {
+    GetShard(document_id).RemoveDocument(document_id);
+}
+
+void ShardedSearchServer::RemoveDocument(std::execution::sequenced_policy seq_policy, int document_id) {
+    GetShard(document_id).RemoveDocument(seq_policy, document_id);
+}
+
+void ShardedSearchServer::RemoveDocument(std::execution::parallel_policy par_policy, int document_id) {
+    GetShard(document_id).RemoveDocument(par_policy, document_id);
+}
+
+std::tuple<std::vector<std::string_view>, DocumentStatus> ShardedSearchServer::MatchDocument(std::string_view raw_query, int document_id) const {
+    return GetShard(document_id).MatchDocument(raw_query, document_id);
+}
+
+std::tuple<std::vector<std::string_view>, DocumentStatus> ShardedSearchServer::MatchDocument(
+        std::execution::sequenced_policy seq_policy,
+        std::string_view raw_query,
+        int document_id) const {
+    return GetShard(document_id).MatchDocument(seq_policy, raw_query, document_id);
+}
+
+std::tuple<std::vector<std::string_view>, DocumentStatus> ShardedSearchServer::MatchDocument(
+        std::execution::parallel_policy par_policy,
+        std::string_view raw_query,
+        int document_id) const {
+    return GetShard(document_id).MatchDocument(par_policy, raw_query, document_id);
+}
+
+SearchServer& ShardedSearchServer::GetShard(int document_id) {
+    return const_cast<SearchServer&>(static_cast<const ShardedSearchServer&>(*this).GetShard(document_id));
+}
+
+const SearchServer& ShardedSearchServer::GetShard(int document_id) const {
+    // multiplicative hashing spreads consecutive ids evenly, the high bits pick the shard
+    const uint32_t hash = static_cast<uint32_t>(document_id) * 2654435761u;
+    return shards_[(static_cast<uint64_t>(hash) * shards_.size()) >> 32];
+}
+
+std::vector<double> ShardedSearchServer::ComputeInverseDocumentFreqs(const SearchServer::Query& query) const {
+    size_t document_count = 0;
+    for (const SearchServer& shard : shards_) {
+        document_count += shard.documents_.size();
+    }
+    std::vector<double> inverse_document_freqs;
+    inverse_document_freqs.reserve(query.plus_words.size());
+    for (const std::string_view& word : query.plus_words) {
+        size_t document_freq = 0;
+        for (const SearchServer& shard : shards_) {
+            const PostingList* postings = shard.FindPostings(word);
+            if (postings != nullptr) {
+                document_freq += postings->size();
+            }
+        }
+        // the word is absent from every shard, so no shard asks for its frequency
+        inverse_document_freqs.push_back(document_freq > 0
+                ? SearchServer::ComputeInverseDocumentFreq(document_count, document_freq)
+                : 0.0);
+    }
+    return inverse_document_freqs;
+}
@@ -0,0 +1,161 @@
+#pragma once
+
+#include "document.h"
+#include "search_server.h"
+#include "top_documents.h"
+
+#include <algorithm>
+#include <execution>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <vector>
+
+
+// Documents are spread over shard_count independent SearchServer shards by a hash
+// of the document id. Queries are scattered to every shard and the top documents
+// gathered; inverse document frequencies are computed over all shards, so the
+// results are the same as for a single SearchServer with the same documents.
+class ShardedSearchServer {
+public:
+    template<typename StringCollection>
+    ShardedSearchServer(const StringCollection& stop_words, size_t shard_count);
+
+    ShardedSearchServer(const std::string& stop_text, size_t shard_count);
+
+    ShardedSearchServer(std::string_view stop_text, size_t shard_count);
+
+    void AddDocument(int document_id, std::string_view document, DocumentStatus status, const std::vector<int>& ratings);
+
+    template<typename Predicate>
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, Predicate predicate,
+            size_t limit = MAX_RESULT_DOCUMENT_COUNT, size_t offset = 0) const;
+
+    std::vector<Document> FindTopDocuments(std::string_view raw_query, DocumentStatus status,
+            size_t limit = MAX_RESULT_DOCUMENT_COUNT, size_t offset = 0) const;
+
+    std::vector<Document> FindTopDocuments(std::string_view raw_query) const;
+
+    // With seq the shards are searched one after another into one collection, so the
+    // pruned search of a shard starts from the worst score kept by the previous ones.
+    // With par the shards are searched concurrently
+    template<typename Predicate>
+    std::vector<Document> FindTopDocuments(std::execution::sequenced_policy seq_policy,
+            std::string_view raw_query, Predicate predicate,
+            size_t limit = MAX_RESULT_DOCUMENT_COUNT, size_t offset = 0) const;
+
+    std::vector<Document> FindTopDocuments(std::execution::sequenced_policy seq_policy,
+            std::string_view raw_query, DocumentStatus status,
+            size_t limit = MAX_RESULT_DOCUMENT_COUNT, size_t offset = 0) const;
+
+    std::vector<Document> FindTopDocuments(std::execution::sequenced_policy seq_policy, std::string_view raw_query) const;
+
+    template<typename Predicate>
+    std::vector<Document> FindTopDocuments(std::execution::parallel_policy par_policy,
+            std::string_view raw_query, Predicate predicate,
+            size_t limit = MAX_RESULT_DOCUMENT_COUNT, size_t offset = 0) const;
+
+    std::vector<Document> FindTopDocuments(std::execution::parallel_policy par_policy,
+            std::string_view raw_query, DocumentStatus status,
+            size_t limit = MAX_RESULT_DOCUMENT_COUNT, size_t offset = 0) const;
+
+    std::vector<Document> FindTopDocuments(std::execution::parallel_policy par_policy, std::string_view raw_query) const;
+
+    int GetDocumentCount() const;
+
+    size_t GetShardCount() const;
+
+    WordFrequencies GetWordFrequencies(int document_id) const;
+
+    void RemoveDocument(int document_id);
+
+    void RemoveDocument(std::execution::sequenced_policy seq_policy, int document_id);
+
+    void RemoveDocument(std::execution::parallel_policy par_policy, int document_id);
+
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(std::string_view raw_query, int document_id) const;
+
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(
+            std::execution::sequenced_policy seq_policy,
+            std::string_view raw_query,
+            int document_id) const;
+
+    std::tuple<std::vector<std::string_view>, DocumentStatus> MatchDocument(
+            std::execution::parallel_policy par_policy,
+            std::string_view raw_query,
+            int document_id) const;
+
+private:
+    std::vector<SearchServer> shards_;
+
+    SearchServer& GetShard(int document_id);
+
+    const SearchServer& GetShard(int document_id) const;
+
+    // Inverse document frequencies of query.plus_words over all shards
+    std::vector<double> ComputeInverseDocumentFreqs(const SearchServer::Query& query) const;
+
+    template<typename Predicate>
+    void FindShardDocuments(const SearchServer& shard, const SearchServer::Query& query,
+            const std::vector<double>& inverse_document_freqs, Predicate predicate, TopDocuments& top_documents) const;
+};
+
+template<typename StringCollection>
+ShardedSearchServer::ShardedSearchServer(const StringCollection& stop_words, size_t shard_count) {
+    using namespace std::string_literals;
+    if (shard_count == 0) {
+        throw std::invalid_argument("shard_count must be positive"s);
+    }
+    shards_.reserve(shard_count);
+    for (size_t i = 0; i < shard_count; ++i) {
+        shards_.emplace_back(stop_words);
+    }
+}
+
+template<typename Predicate>
+std::vector<Document> ShardedSearchServer::FindTopDocuments(std::string_view raw_query, Predicate predicate,
+        size_t limit, size_t offset) const {
+    const SearchServer::Query query = shards_.front().ParseQuery(raw_query);
+    const std::vector<double> inverse_document_freqs = ComputeInverseDocumentFreqs(query);
+    // The shards share the collection, a full one sets the starting threshold of the next shard
+    TopDocuments top_documents(limit, offset);
+    for (const SearchServer& shard : shards_) {
+        FindShardDocuments(shard, query, inverse_document_freqs, predicate, top_documents);
+    }
+    return top_documents.Extract();
+}
+
+template<typename Predicate>
+std::vector<Document> ShardedSearchServer::FindTopDocuments(std::execution::sequenced_policy seq_policy,
+        std::string_view raw_query, Predicate predicate, size_t limit, size_t offset) const {
+    return ShardedSearchServer::FindTopDocuments(raw_query, predicate, limit, offset);
+}
+
+template<typename Predicate>
+std::vector<Document> ShardedSearchServer::FindTopDocuments(std::execution::parallel_policy par_policy,
+        std::string_view raw_query, Predicate predicate, size_t limit, size_t offset) const {
+    const SearchServer::Query query = shards_.front().ParseQuery(raw_query);
+    const std::vector<double> inverse_document_freqs = ComputeInverseDocumentFreqs(query);
+    std::vector<TopDocuments> shard_top_documents(shards_.size(), TopDocuments(limit, offset));
+    std::vector<size_t> shard_indexes(shards_.size());
+    std::iota(shard_indexes.begin(), shard_indexes.end(), 0);
+    std::for_each(par_policy, shard_indexes.begin(), shard_indexes.end(),
+            [this, &query, &inverse_document_freqs, &predicate, &shard_top_documents](size_t shard_index) {
+        FindShardDocuments(shards_[shard_index], query, inverse_document_freqs, predicate, shard_top_documents[shard_index]);
+    });
+    TopDocuments top_documents(limit, offset);
+    for (const TopDocuments& shard_documents : shard_top_documents) {
+        top_documents.Merge(shard_documents);
+    }
+    return top_documents.Extract();
+}
+
+template<typename Predicate>
+void ShardedSearchServer::FindShardDocuments(const SearchServer& shard, const SearchServer::Query& query,
+        const std::vector<double>& inverse_document_freqs, Predicate predicate, TopDocuments& top_documents) const {
+    const SearchServer::QueryTerms terms = shard.ResolveQuery(query, &inverse_document_freqs);
+    const SearchServer::OrdinalRange range{0, static_cast<int>(shard.documents_.GetOrdinalCount())};
+    shard.FindDocumentsInRange(terms, predicate, range, terms.posting_count, top_documents);
+}
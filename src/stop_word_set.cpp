@@ -0,0 +1,33 @@
+#include "stop_word_set.h"
+
+
+StopWordSet::StopWordSet() {
+    Build();
+}
+
+size_t StopWordSet::size() const {
+    return words_.size();
+}
+
+std::vector<std::string>::const_iterator StopWordSet::begin() const {
+    return words_.begin();
+}
+
+std::vector<std::string>::const_iterator StopWordSet::end() const {
+    return words_.end();
+}
+
+void StopWordSet::Build() {
+    std::vector<uint64_t> hashes;
+    hashes.reserve(words_.size());
+    for (const std::string& word : words_) {
+        hashes.push_back(HashStopWord(word));
+    }
+    slot_bits_ = GetStopWordSlotBits(words_.size());
+    displacements_.resize(GetStopWordBucketCount(words_.size()));
+    slots_.resize(size_t{1} << slot_bits_);
+    std::vector<size_t> order(words_.size());
+    std::vector<size_t> bucket_starts(displacements_.size() + 1);
+    BuildStopWordTable(hashes.data(), words_.size(), displacements_.data(), displacements_.size(),
+            slots_.data(), slot_bits_, order.data(), bucket_starts.data());
+}
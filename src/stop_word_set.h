@@ -0,0 +1,205 @@
+#pragma once
+
+#include "string_processing.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+
+// FNV-1a finished with the splitmix64 mix, so that every bit depends on every character
+constexpr uint64_t HashStopWord(std::string_view word) {
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    for (const char c : word) {
+        hash = (hash ^ static_cast<unsigned char>(c)) * 0x100000001b3ULL;
+    }
+    hash = (hash ^ (hash >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    hash = (hash ^ (hash >> 27)) * 0x94d049bb133111ebULL;
+    return hash ^ (hash >> 31);
+}
+
+// Multiply-shift hash of the word hash, a new displacement gives an independent slot
+constexpr size_t GetStopWordSlot(uint64_t hash, uint32_t displacement, size_t slot_bits) {
+    return static_cast<size_t>(((hash ^ (displacement * 0x9e3779b97f4a7c15ULL)) * 0xbf58476d1ce4e5b9ULL) >> (64 - slot_bits));
+}
+
+// The table has at least two slots per word and a bucket of displacements per two words
+constexpr size_t GetStopWordSlotBits(size_t word_count) {
+    size_t slot_bits = 1;
+    while ((size_t{1} << slot_bits) < 2 * word_count) {
+        ++slot_bits;
+    }
+    return slot_bits;
+}
+
+constexpr size_t GetStopWordBucketCount(size_t word_count) {
+    size_t bucket_count = 1;
+    while (bucket_count < word_count / 2) {
+        bucket_count *= 2;
+    }
+    return bucket_count;
+}
+
+// Hash and displace: the words of every bucket, largest buckets first, get the first
+// displacement which moves them all into free slots. slots[i] is the index of the word
+// in slot i plus one, zero for an empty slot. order and bucket_starts are scratch space
+// for word_count and bucket_count + 1 entries. Throws std::invalid_argument for equal words
+constexpr void BuildStopWordTable(const uint64_t* hashes, size_t word_count,
+        uint32_t* displacements, size_t bucket_count, uint32_t* slots, size_t slot_bits,
+        size_t* order, size_t* bucket_starts) {
+    for (size_t bucket = 0; bucket <= bucket_count; ++bucket) {
+        bucket_starts[bucket] = 0;
+    }
+    for (size_t i = 0; i < word_count; ++i) {
+        ++bucket_starts[(hashes[i] & (bucket_count - 1)) + 1];
+    }
+    size_t max_bucket_size = 0;
+    for (size_t bucket = 0; bucket < bucket_count; ++bucket) {
+        max_bucket_size = bucket_starts[bucket + 1] > max_bucket_size ? bucket_starts[bucket + 1] : max_bucket_size;
+        bucket_starts[bucket + 1] += bucket_starts[bucket];
+        displacements[bucket] = 0;
+    }
+    // displacements count the placed words until the buckets are sorted
+    for (size_t i = 0; i < word_count; ++i) {
+        const size_t bucket = hashes[i] & (bucket_count - 1);
+        order[bucket_starts[bucket] + displacements[bucket]++] = i;
+    }
+    for (size_t slot = 0; slot < (size_t{1} << slot_bits); ++slot) {
+        slots[slot] = 0;
+    }
+    for (size_t bucket_size = max_bucket_size; bucket_size > 0; --bucket_size) {
+        for (size_t bucket = 0; bucket < bucket_count; ++bucket) {
+            const size_t begin = bucket_starts[bucket];
+            const size_t end = bucket_starts[bucket + 1];
+            if (end - begin != bucket_size) {
+                continue;
+            }
+            for (uint32_t displacement = 0;; ++displacement) {
+                if (displacement == UINT32_MAX) {
+                    throw std::invalid_argument("equal stop words");
+                }
+                bool fits = true;
+                for (size_t i = begin; i < end && fits; ++i) {
+                    const size_t slot = GetStopWordSlot(hashes[order[i]], displacement, slot_bits);
+                    fits = slots[slot] == 0;
+                    for (size_t j = begin; j < i && fits; ++j) {
+                        fits = GetStopWordSlot(hashes[order[j]], displacement, slot_bits) != slot;
+                    }
+                }
+                if (fits) {
+                    for (size_t i = begin; i < end; ++i) {
+                        slots[GetStopWordSlot(hashes[order[i]], displacement, slot_bits)] = static_cast<uint32_t>(order[i] + 1);
+                    }
+                    displacements[bucket] = displacement;
+                    break;
+                }
+            }
+        }
+    }
+}
+
+// Stop words fixed at build time, the perfect hash table is computed by the compiler:
+//     constexpr StaticStopWordSet STOP_WORDS({"and"sv, "in"sv, "at"sv});
+//     SearchServer search_server(STOP_WORDS);
+// Words must be distinct and not empty
+template <size_t N>
+class StaticStopWordSet {
+public:
+    constexpr explicit StaticStopWordSet(const std::string_view (&words)[N]) {
+        for (size_t i = 0; i < N; ++i) {
+            // insertion sort keeps the words in the order of a std::set
+            size_t j = i;
+            for (; j > 0 && words_[j - 1] > words[i]; --j) {
+                words_[j] = words_[j - 1];
+            }
+            words_[j] = words[i];
+        }
+        std::array<uint64_t, N> hashes{};
+        for (size_t i = 0; i < N; ++i) {
+            if (words_[i].empty() || (i > 0 && words_[i] == words_[i - 1])) {
+                throw std::invalid_argument("stop words must be distinct and not empty");
+            }
+            hashes[i] = HashStopWord(words_[i]);
+        }
+        std::array<size_t, N> order{};
+        std::array<size_t, BUCKET_COUNT + 1> bucket_starts{};
+        BuildStopWordTable(hashes.data(), N, displacements_.data(), BUCKET_COUNT, slots_.data(), SLOT_BITS,
+                order.data(), bucket_starts.data());
+    }
+
+    constexpr bool Contains(std::string_view word) const {
+        const uint64_t hash = HashStopWord(word);
+        const uint32_t index = slots_[GetStopWordSlot(hash, displacements_[hash & (BUCKET_COUNT - 1)], SLOT_BITS)];
+        return index != 0 && words_[index - 1] == word;
+    }
+
+    constexpr size_t size() const {
+        return N;
+    }
+
+private:
+    static constexpr size_t SLOT_BITS = GetStopWordSlotBits(N);
+    static constexpr size_t BUCKET_COUNT = GetStopWordBucketCount(N);
+
+    std::array<std::string_view, N> words_{};
+    std::array<uint32_t, BUCKET_COUNT> displacements_{};
+    std::array<uint32_t, size_t{1} << SLOT_BITS> slots_{};
+
+    friend class StopWordSet;
+};
+
+// Immutable set of stop words with a perfect hash: a lookup hashes the word once,
+// reads a displacement and a slot and compares at most one word, without allocation.
+// Iterates over the words in sorted order
+class StopWordSet {
+public:
+    StopWordSet();
+
+    // Empty strings are skipped, repeated ones are kept once
+    template <typename StringContainer>
+    explicit StopWordSet(const StringContainer& words);
+
+    // Copies the table built at compile time
+    template <size_t N>
+    explicit StopWordSet(const StaticStopWordSet<N>& words);
+
+    bool Contains(std::string_view word) const {
+        const uint64_t hash = HashStopWord(word);
+        const uint32_t index = slots_[GetStopWordSlot(hash, displacements_[hash & (displacements_.size() - 1)], slot_bits_)];
+        return index != 0 && words_[index - 1] == word;
+    }
+
+    size_t size() const;
+
+    std::vector<std::string>::const_iterator begin() const;
+
+    std::vector<std::string>::const_iterator end() const;
+
+private:
+    std::vector<std::string> words_;
+    std::vector<uint32_t> displacements_;
+    std::vector<uint32_t> slots_;
+    size_t slot_bits_ = 1;
+
+    void Build();
+};
+
+template <typename StringContainer>
+StopWordSet::StopWordSet(const StringContainer& words) {
+    for (const std::string& word : MakeUniqueNonEmptyStrings(words)) {
+        words_.push_back(word);
+    }
+    Build();
+}
+
+template <size_t N>
+StopWordSet::StopWordSet(const StaticStopWordSet<N>& words)
+    : words_(words.words_.begin(), words.words_.end())
+    , displacements_(words.displacements_.begin(), words.displacements_.end())
+    , slots_(words.slots_.begin(), words.slots_.end())
+    , slot_bits_(StaticStopWordSet<N>::SLOT_BITS) {
+}
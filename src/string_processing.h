@@ -1,16 +1,36 @@
 #pragma once
 
+#include <cstddef>
+#include <cstdint>
 #include <set>
 #include <string>
 #include <string_view>
 #include <vector>
 
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define STRING_PROCESSING_HAS_AVX2
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define STRING_PROCESSING_HAS_SSE2
+#endif
+
 
 std::vector<std::string_view> SplitIntoWords(std::string_view text);
 
+// Calls handler(std::string_view word) for every word of the text separated by spaces,
+// without building a vector of words
+template <typename Handler>
+void ForEachWord(std::string_view text, Handler handler);
+
+// Same, but the pass also looks for characters with codes from 0 to 31. Stops before
+// the first word containing one and returns false, the words before it are handled
+template <typename Handler>
+bool ForEachValidWord(std::string_view text, Handler handler);
+
 template <typename StringContainer>
-std::set<std::string> MakeUniqueNonEmptyStrings(const StringContainer& strings) {
-    std::set<std::string> non_empty_strings;
+std::set<std::string, std::less<>> MakeUniqueNonEmptyStrings(const StringContainer& strings) {
+    std::set<std::string, std::less<>> non_empty_strings;
     for (std::string_view str : strings) {
         if (!str.empty()) {
             non_empty_strings.emplace(str);
@@ -18,3 +38,117 @@ std::set<std::string> MakeUniqueNonEmptyStrings(const StringContainer& strings)
     }
     return non_empty_strings;
 }
+
+#ifdef STRING_PROCESSING_HAS_AVX2
+static const size_t TEXT_BLOCK_SIZE = 32;
+static const uint32_t TEXT_BLOCK_MASK = 0xffffffffu;
+#else
+static const size_t TEXT_BLOCK_SIZE = 16;
+static const uint32_t TEXT_BLOCK_MASK = 0xffffu;
+#endif
+
+// Bit i is set if character i of the block is a space / has a code from 0 to 31
+struct TextBlockMasks {
+    uint32_t spaces;
+    uint32_t controls;
+};
+
+inline TextBlockMasks ScanTextBlock(const char* block) {
+#if defined(STRING_PROCESSING_HAS_AVX2)
+    const __m256i chars = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(block));
+    const __m256i spaces = _mm256_cmpeq_epi8(chars, _mm256_set1_epi8(' '));
+    // codes from 0 to 31 are the ones without the upper three bits
+    const __m256i controls = _mm256_cmpeq_epi8(_mm256_and_si256(chars, _mm256_set1_epi8(static_cast<char>(0xe0))),
+            _mm256_setzero_si256());
+    return {static_cast<uint32_t>(_mm256_movemask_epi8(spaces)), static_cast<uint32_t>(_mm256_movemask_epi8(controls))};
+#elif defined(STRING_PROCESSING_HAS_SSE2)
+    const __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(block));
+    const __m128i spaces = _mm_cmpeq_epi8(chars, _mm_set1_epi8(' '));
+    const __m128i controls = _mm_cmpeq_epi8(_mm_and_si128(chars, _mm_set1_epi8(static_cast<char>(0xe0))),
+            _mm_setzero_si128());
+    return {static_cast<uint32_t>(_mm_movemask_epi8(spaces)), static_cast<uint32_t>(_mm_movemask_epi8(controls))};
+#else
+    TextBlockMasks masks{0, 0};
+    for (size_t i = 0; i < TEXT_BLOCK_SIZE; ++i) {
+        const unsigned char c = static_cast<unsigned char>(block[i]);
+        masks.spaces |= static_cast<uint32_t>(c == ' ') << i;
+        masks.controls |= static_cast<uint32_t>(c < ' ') << i;
+    }
+    return masks;
+#endif
+}
+
+// Index of the lowest set bit, bits must not be zero
+inline size_t FindLowestBit(uint32_t bits) {
+#if defined(__GNUC__)
+    return static_cast<size_t>(__builtin_ctz(bits));
+#else
+    size_t index = 0;
+    while ((bits & 1u) == 0) {
+        bits >>= 1;
+        ++index;
+    }
+    return index;
+#endif
+}
+
+// Blocks of text are classified at once, words are cut at the bits where spaces
+// and other characters alternate
+template <bool CheckControls, typename Handler>
+bool ScanWords(std::string_view text, Handler& handler) {
+    const char* const data = text.data();
+    size_t word_start = 0;
+    bool in_word = false;
+    size_t pos = 0;
+    for (; pos + TEXT_BLOCK_SIZE <= text.size(); pos += TEXT_BLOCK_SIZE) {
+        const TextBlockMasks masks = ScanTextBlock(data + pos);
+        const uint32_t non_spaces = ~masks.spaces & TEXT_BLOCK_MASK;
+        const size_t limit = CheckControls && masks.controls != 0 ? FindLowestBit(masks.controls) : TEXT_BLOCK_SIZE;
+        uint32_t boundaries = in_word ? masks.spaces : non_spaces;
+        while (boundaries != 0) {
+            const size_t index = FindLowestBit(boundaries);
+            if (index >= limit) {
+                break;
+            }
+            if (in_word) {
+                handler(std::string_view(data + word_start, pos + index - word_start));
+            } else {
+                word_start = pos + index;
+            }
+            in_word = !in_word;
+            boundaries = (in_word ? masks.spaces : non_spaces) & (TEXT_BLOCK_MASK << index);
+        }
+        if (limit < TEXT_BLOCK_SIZE) {
+            return false;
+        }
+    }
+    for (; pos < text.size(); ++pos) {
+        const unsigned char c = static_cast<unsigned char>(data[pos]);
+        if (CheckControls && c < ' ') {
+            return false;
+        }
+        if (c == ' ') {
+            if (in_word) {
+                handler(std::string_view(data + word_start, pos - word_start));
+                in_word = false;
+            }
+        } else if (!in_word) {
+            word_start = pos;
+            in_word = true;
+        }
+    }
+    if (in_word) {
+        handler(std::string_view(data + word_start, text.size() - word_start));
+    }
+    return true;
+}
+
+template <typename Handler>
+void ForEachWord(std::string_view text, Handler handler) {
+    ScanWords<false>(text, handler);
+}
+
+template <typename Handler>
+bool ForEachValidWord(std::string_view text, Handler handler) {
+    return ScanWords<true>(text, handler);
+}
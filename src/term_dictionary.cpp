@@ -0,0 +1,158 @@
+#include "term_dictionary.h"
+
+#include <algorithm>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+
+
+using namespace std::string_literals;
+
+
+TermDictionary::TermDictionary(const TermDictionary& other)
+    : chunks_(other.chunks_)
+    , current_chunk_(nullptr)
+    , chunk_used_(CHUNK_SIZE)    // the copy never writes into chunks it shares
+    , terms_(other.terms_)
+    , term_ids_(other.term_ids_)
+    , mapped_count_(other.mapped_count_)
+    , mapped_terms_(other.mapped_terms_)
+    , mapped_sorted_ids_(other.mapped_sorted_ids_) {
+}
+
+TermDictionary& TermDictionary::operator=(const TermDictionary& other) {
+    if (this != &other) {
+        chunks_ = other.chunks_;
+        current_chunk_ = nullptr;
+        chunk_used_ = CHUNK_SIZE;
+        terms_ = other.terms_;
+        term_ids_ = other.term_ids_;
+        mapped_count_ = other.mapped_count_;
+        mapped_terms_ = other.mapped_terms_;
+        mapped_sorted_ids_ = other.mapped_sorted_ids_;
+    }
+    return *this;
+}
+
+// The moved-from dictionary drops its chunk pointer with the chunks, otherwise
+// a later Intern on it would write into a chunk now owned by this one
+TermDictionary::TermDictionary(TermDictionary&& other) noexcept
+    : chunks_(std::move(other.chunks_))
+    , current_chunk_(other.current_chunk_)
+    , chunk_used_(other.chunk_used_)
+    , terms_(std::move(other.terms_))
+    , term_ids_(std::move(other.term_ids_))
+    , mapped_count_(other.mapped_count_)
+    , mapped_terms_(other.mapped_terms_)
+    , mapped_sorted_ids_(other.mapped_sorted_ids_) {
+    other.Clear();
+}
+
+TermDictionary& TermDictionary::operator=(TermDictionary&& other) noexcept {
+    if (this != &other) {
+        chunks_ = std::move(other.chunks_);
+        current_chunk_ = other.current_chunk_;
+        chunk_used_ = other.chunk_used_;
+        terms_ = std::move(other.terms_);
+        term_ids_ = std::move(other.term_ids_);
+        mapped_count_ = other.mapped_count_;
+        mapped_terms_ = other.mapped_terms_;
+        mapped_sorted_ids_ = other.mapped_sorted_ids_;
+        other.Clear();
+    }
+    return *this;
+}
+
+TermId TermDictionary::Intern(std::string_view word) {
+    if (const std::optional<TermId> term_id = Find(word)) {
+        return *term_id;
+    }
+    const TermId term_id = static_cast<TermId>(size());
+    const std::string_view stored = Store(word);
+    terms_.push_back(stored);
+    term_ids_.Insert(stored, term_id);
+    return term_id;
+}
+
+std::optional<TermId> TermDictionary::Find(std::string_view word) const {
+    const TermId* term_id = term_ids_.Find(word);
+    if (term_id == nullptr) {
+        return FindMapped(word);
+    }
+    return *term_id;
+}
+
+std::string_view TermDictionary::GetTerm(TermId term_id) const {
+    return term_id < mapped_count_ ? mapped_terms_.Get(term_id) : terms_[term_id - mapped_count_];
+}
+
+size_t TermDictionary::size() const {
+    return mapped_count_ + terms_.size();
+}
+
+void TermDictionary::Save(SnapshotWriter& writer) const {
+    std::vector<std::string_view> terms(size());
+    for (TermId term_id = 0; term_id < terms.size(); ++term_id) {
+        terms[term_id] = GetTerm(term_id);
+    }
+    std::vector<TermId> sorted_ids(terms.size());
+    std::iota(sorted_ids.begin(), sorted_ids.end(), 0);
+    std::sort(sorted_ids.begin(), sorted_ids.end(),
+            [&terms](TermId lhs, TermId rhs) { return terms[lhs] < terms[rhs]; });
+    writer.WriteStrings(terms);
+    writer.WriteArray(sorted_ids);
+}
+
+TermDictionary TermDictionary::Load(SnapshotCursor& cursor) {
+    TermDictionary dictionary;
+    dictionary.mapped_terms_ = cursor.ReadStrings();
+    dictionary.mapped_count_ = dictionary.mapped_terms_.count;
+    dictionary.mapped_sorted_ids_ = cursor.ReadArray<TermId>(dictionary.mapped_count_);
+    for (size_t i = 0; i < dictionary.mapped_count_; ++i) {
+        if (dictionary.mapped_sorted_ids_[i] >= dictionary.mapped_count_ || (i > 0
+                && dictionary.GetTerm(dictionary.mapped_sorted_ids_[i - 1]) >= dictionary.GetTerm(dictionary.mapped_sorted_ids_[i]))) {
+            throw std::runtime_error("corrupted index snapshot"s);
+        }
+    }
+    return dictionary;
+}
+
+void TermDictionary::Clear() {
+    chunks_.clear();
+    current_chunk_ = nullptr;
+    chunk_used_ = CHUNK_SIZE;
+    terms_.clear();
+    term_ids_.clear();
+    mapped_count_ = 0;
+    mapped_terms_ = {};
+    mapped_sorted_ids_ = nullptr;
+}
+
+std::string_view TermDictionary::Store(std::string_view word) {
+    if (word.size() > CHUNK_SIZE) {
+        // Long words get a dedicated chunk, current chunk stays in use
+        std::shared_ptr<char[]> chunk(new char[word.size()]);
+        std::copy(word.begin(), word.end(), chunk.get());
+        chunks_.push_back(chunk);
+        return {chunk.get(), word.size()};
+    }
+    if (CHUNK_SIZE - chunk_used_ < word.size()) {
+        chunks_.push_back(std::shared_ptr<char[]>(new char[CHUNK_SIZE]));
+        current_chunk_ = chunks_.back().get();
+        chunk_used_ = 0;
+    }
+    char* data = current_chunk_ + chunk_used_;
+    std::copy(word.begin(), word.end(), data);
+    chunk_used_ += word.size();
+    return {data, word.size()};
+}
+
+std::optional<TermId> TermDictionary::FindMapped(std::string_view word) const {
+    const TermId* const sorted_ids_end = mapped_sorted_ids_ + mapped_count_;
+    const TermId* it = std::lower_bound(mapped_sorted_ids_, sorted_ids_end, word,
+            [this](TermId term_id, std::string_view value) { return mapped_terms_.Get(term_id) < value; });
+    if (it == sorted_ids_end || mapped_terms_.Get(*it) != word) {
+        return std::nullopt;
+    }
+    return *it;
+}
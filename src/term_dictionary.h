@@ -0,0 +1,69 @@
+#pragma once
+
+#include "cow_hash_map.h"
+#include "cow_vector.h"
+#include "index_snapshot.h"
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+
+using TermId = uint32_t;
+
+// Interns every distinct word once and hands out dense term ids.
+// Word bytes live in shared fixed-size chunks, so views returned by GetTerm()
+// stay valid for the lifetime of the dictionary (and of all its copies); the
+// copies share the term tables chunk by chunk until one of them interns a word.
+// A dictionary loaded from a snapshot looks its terms up in the mapped file by
+// binary search; words interned after the load are kept in memory as usual.
+class TermDictionary {
+public:
+    TermDictionary() = default;
+
+    TermDictionary(const TermDictionary& other);
+
+    TermDictionary& operator=(const TermDictionary& other);
+
+    // The moved-from dictionary is left empty
+    TermDictionary(TermDictionary&& other) noexcept;
+
+    TermDictionary& operator=(TermDictionary&& other) noexcept;
+
+    // Returns id of the word, adding it to the dictionary if necessary
+    TermId Intern(std::string_view word);
+
+    // Lookup without any allocation
+    std::optional<TermId> Find(std::string_view word) const;
+
+    std::string_view GetTerm(TermId term_id) const;
+
+    size_t size() const;
+
+    // Writes the terms into the current section of the snapshot
+    void Save(SnapshotWriter& writer) const;
+
+    // Terms point into the snapshot, which must outlive the dictionary
+    static TermDictionary Load(SnapshotCursor& cursor);
+
+private:
+    static const size_t CHUNK_SIZE = 64 * 1024;
+
+    std::vector<std::shared_ptr<char[]>> chunks_;
+    char* current_chunk_ = nullptr;
+    size_t chunk_used_ = CHUNK_SIZE;
+    CowVector<std::string_view> terms_;
+    CowHashMap<std::string_view, TermId> term_ids_;
+    // the first mapped_count_ ids belong to the snapshot, mapped_sorted_ids_ orders them by word
+    size_t mapped_count_ = 0;
+    StringTable mapped_terms_;
+    const TermId* mapped_sorted_ids_ = nullptr;
+
+    void Clear();
+
+    std::string_view Store(std::string_view word);
+
+    std::optional<TermId> FindMapped(std::string_view word) const;
+};
@@ -2,23 +2,83 @@
  *        #include "test_example_functions.h"
  */
 
+#include "concurrent_request_queue.h"
+#include "concurrent_search_server.h"
+#include "executor.h"
+#include "forward_index.h"
 #include "log_duration.h"
+#include "metrics.h"
+#include "mutation_log.h"
+#include "posting_list.h"
 #include "process_queries.h"
+#include "query_result_cache.h"
 #include "remove_duplicates.h"
+#include "score_accumulator.h"
 #include "request_queue.h"
 #include "search_server.h"
+#include "sharded_search_server.h"
+#include "stop_word_set.h"
+#include "string_processing.h"
 #include "test_example_functions.h"
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <execution>
+#include <filesystem>
+#include <fstream>
 #include <iostream>
+#include <iterator>
+#include <limits>
+#include <map>
+#include <memory>
+#include <numeric>
 #include <random>
+#include <set>
+#include <sstream>
 #include <stdexcept>
 #include <string>
 #include <string_view>
+#include <thread>
 #include <vector>
 
+#if defined(__linux__)
+#include <csignal>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/resource.h>
+#endif
+
 using namespace std::string_literals;
 
 
+bool operator==(const Document& lhs, const Document& rhs) {
+    return lhs.id == rhs.id && lhs.rating == rhs.rating && std::abs(lhs.relevance - rhs.relevance) < EPS;
+}
+
+bool operator!=(const Document& lhs, const Document& rhs) {
+    return !(lhs == rhs);
+}
+
+std::ostream& operator<<(std::ostream& output, DocumentStatus status) {
+    return output << static_cast<int>(status);
+}
+
+void AssertImpl(bool value, const std::string& expr_str, const std::string& file, const std::string& func, unsigned line,
+                const std::string& hint) {
+    if (!value) {
+        std::cerr << file << "("s << line << "): "s << func << ": "s;
+        std::cerr << "ASSERT("s << expr_str << ") failed."s;
+        if (!hint.empty()) {
+            std::cerr << " Hint: "s << hint;
+        }
+        std::cerr << std::endl;
+        std::abort();
+    }
+}
+
 void AddDocument(SearchServer& search_server, int document_id, const std::string& document, DocumentStatus status,
                  const std::vector<int>& ratings) {
     try {
@@ -42,9 +102,11 @@ void FindTopDocuments(const SearchServer& search_server, const std::string& raw_
 void MatchDocuments(SearchServer& search_server, std::string_view& query) {
     try {
         std::cout << "   : "s << query << std::endl;
-        for (const int document_id : search_server) {
-            const auto [words, status] = search_server.MatchDocument(query, document_id);
-            PrintMatchDocumentResult(document_id, words, status);
+        const std::vector<int> document_ids(search_server.begin(), search_server.end());
+        const auto matches = search_server.MatchDocuments(query, document_ids);
+        for (size_t i = 0; i < document_ids.size(); ++i) {
+            const auto& [words, status] = matches[i];
+            PrintMatchDocumentResult(document_ids[i], words, status);
         }
     } catch (const std::exception& e) {
         std::cout << "     "s << query << ": "s << e.what() << std::endl;
@@ -79,7 +141,9 @@ void TestRemoveDuplicates() {
     AddDocument(search_server, 9, "nasty rat with curly hair"s, DocumentStatus::ACTUAL, {1, 2});
 
     std::cout << "Before duplicates removed: "s << search_server.GetDocumentCount() << std::endl;
-    RemoveDuplicates(search_server);
+    for (const int id : RemoveDuplicates(search_server)) {
+        std::cout << "Found duplicate document id "s << id << std::endl;
+    }
     std::cout << "After duplicates removed: "s << search_server.GetDocumentCount() << std::endl;
     search_server.RemoveDocument(1);
     search_server.RemoveDocument(6);
@@ -87,6 +151,125 @@ void TestRemoveDuplicates() {
 
 }
 
+// Word by word reference for the block scan of ScanWords
+std::vector<std::string_view> SplitIntoWordsScalar(std::string_view text, bool check_controls, bool& valid) {
+    std::vector<std::string_view> words;
+    valid = true;
+    size_t word_start = 0;
+    for (size_t pos = 0; pos <= text.size(); ++pos) {
+        const bool at_end = pos == text.size();
+        if (!at_end && check_controls && static_cast<unsigned char>(text[pos]) < ' ') {
+            valid = false;
+            return words;
+        }
+        if (at_end || text[pos] == ' ') {
+            if (pos > word_start) {
+                words.push_back(text.substr(word_start, pos - word_start));
+            }
+            word_start = pos + 1;
+        }
+    }
+    return words;
+}
+
+// Escaped text for the hints, bytes outside of printable ASCII are shown as \xNN
+std::string EscapeText(std::string_view text) {
+    static const char* const digits = "0123456789abcdef";
+    std::string escaped;
+    for (const char c : text) {
+        const unsigned char code = static_cast<unsigned char>(c);
+        if (code < ' ' || code >= 0x7f) {
+            escaped += "\\x"s;
+            escaped += digits[code >> 4];
+            escaped += digits[code & 0xf];
+        } else {
+            escaped += c;
+        }
+    }
+    return '"' + escaped + '"';
+}
+
+void AssertSameWords(std::string_view text) {
+    bool expected_valid = true;
+    const std::vector<std::string_view> expected_all = SplitIntoWordsScalar(text, false, expected_valid);
+    const std::vector<std::string_view> expected_valid_words = SplitIntoWordsScalar(text, true, expected_valid);
+
+    ASSERT_EQUAL_HINT(SplitIntoWords(text), expected_all, EscapeText(text));
+    std::vector<std::string_view> words;
+    const bool valid = ForEachValidWord(text, [&words](std::string_view word) {
+        words.push_back(word);
+    });
+    ASSERT_EQUAL_HINT(valid, expected_valid, EscapeText(text));
+    ASSERT_EQUAL_HINT(words, expected_valid_words, EscapeText(text));
+    // the words are views into the text, not copies
+    for (const std::string_view word : words) {
+        ASSERT_HINT(word.data() >= text.data() && word.data() + word.size() <= text.data() + text.size(), EscapeText(text));
+    }
+}
+
+void TestScanWords() {
+    // both block sizes are covered whichever of SSE2 and AVX2 is compiled in; the default build
+    // takes SSE2, the AVX2 path is checked by building with -mavx2
+    const size_t max_length = 3 * 32 + 5;
+
+    const std::vector<std::string> table = {
+        ""s, " "s, "a"s, "a b"s, "  a  b  "s, "cat dog  rat   "s,
+        std::string(15, 'a'), std::string(16, 'a'), std::string(17, 'a'),
+        std::string(31, 'a'), std::string(32, 'a'), std::string(33, 'a'), std::string(64, 'a'),
+        std::string(16, ' ') + std::string(16, 'b'), std::string(32, ' ') + "c"s + std::string(32, ' '),
+        "\xcf\xf0\xe8\xe2\xe5\xf2 \xec\xe8\xf0"s, "\x80 \xff\xa0 \xe0"s + std::string(30, '\xff'),
+        "word\x7f word"s, "ok\tno"s, std::string(1, '\0') + "a"s, "a b"s + std::string(1, '\0'),
+    };
+    for (const std::string& text : table) {
+        AssertSameWords(text);
+    }
+
+    // a word of every length starting at every position, so every crossing of a block boundary is met
+    for (size_t start = 0; start <= 2 * 32 + 1; ++start) {
+        for (size_t length = 1; start + length <= max_length; ++length) {
+            AssertSameWords(std::string(start, ' ') + std::string(length, 'w') + " z"s);
+            AssertSameWords(std::string(start, 'v') + " "s + std::string(length, 'w'));
+        }
+    }
+
+    // leading, trailing and inner runs of spaces of every length
+    for (size_t spaces = 0; spaces <= max_length; ++spaces) {
+        AssertSameWords(std::string(spaces, ' '));
+        AssertSameWords(std::string(spaces, ' ') + "a"s + std::string(spaces, ' '));
+        AssertSameWords("a"s + std::string(spaces, ' ') + "b"s + std::string(max_length - spaces, ' ') + "c"s);
+    }
+
+    // every control character at every position of the first blocks and the tail
+    const std::string words = "alpha be gamma   delta e  zeta eta theta iota kappa lambda mu nu xi omicron pi rho"s;
+    for (size_t pos = 0; pos < words.size(); ++pos) {
+        for (int code = 0; code < ' '; ++code) {
+            std::string text = words;
+            text[pos] = static_cast<char>(code);
+            AssertSameWords(text);
+        }
+        // codes from 0x80 differ from the controls only in the upper bits
+        for (const int code : {0x7f, 0x80, 0x9f, 0xa0, 0xdf, 0xe0, 0xff}) {
+            std::string text = words;
+            text[pos] = static_cast<char>(code);
+            AssertSameWords(text);
+        }
+    }
+
+    // random mixtures of all kinds of characters
+    std::mt19937 generator(17);
+    const std::string alphabet = "ab  \x80\xff\xe0\x1f\t\x7f"s + std::string(1, '\0');
+    for (int i = 0; i < 20000; ++i) {
+        std::string text(std::uniform_int_distribution<size_t>(0, max_length)(generator), ' ');
+        // controls are rare so that most texts reach the end
+        const size_t alphabet_size = i % 2 == 0 ? 6 : alphabet.size();
+        for (char& c : text) {
+            c = alphabet[std::uniform_int_distribution<size_t>(0, alphabet_size - 1)(generator)];
+        }
+        AssertSameWords(text);
+    }
+    std::cerr << "TestScanWords - OK\n";
+}
+
 void TestRequest() {
     SearchServer search_server("and in at"s);
     RequestQueue request_queue(search_server);
@@ -164,6 +347,180 @@ void TestRequest() {
 
 }
 
+void TestMetricsRegistry() {
+    MetricsRegistry& metrics = MetricsRegistry::Instance();
+    const bool was_enabled = metrics.IsEnabled();
+    auto find_metric = [](const std::vector<MetricSnapshot>& snapshot, const std::string& name) {
+        const auto it = std::find_if(snapshot.begin(), snapshot.end(),
+                [&name](const MetricSnapshot& metric) { return metric.name == name; });
+        ASSERT_HINT(it != snapshot.end(), name);
+        return *it;
+    };
+
+    // every metric is in the snapshot, in the order of Metric
+    metrics.SetEnabled(true);
+    metrics.Reset();
+    std::vector<MetricSnapshot> snapshot = metrics.GetSnapshot();
+    ASSERT_EQUAL(snapshot.size(), static_cast<size_t>(Metric::INDEX_UPDATE) + 1);
+    for (size_t metric = 0; metric < snapshot.size(); ++metric) {
+        ASSERT_EQUAL(snapshot[metric].name, std::string(MetricsRegistry::GetName(static_cast<Metric>(metric))));
+        ASSERT_EQUAL(snapshot[metric].count, 0u);
+    }
+
+    // records of a thread which has exited are kept
+    std::thread([&metrics]() {
+        for (int i = 1; i <= 100; ++i) {
+            metrics.Record(Metric::TOP_K_SELECTION, std::chrono::microseconds(i));
+        }
+    }).join();
+    metrics.Record(Metric::TOP_K_SELECTION, std::chrono::milliseconds(1));
+    const MetricSnapshot top_k_selection = find_metric(metrics.GetSnapshot(), "top_k_selection"s);
+    ASSERT_EQUAL(top_k_selection.count, 101u);
+    ASSERT_EQUAL(top_k_selection.total.count(), 6'050'000);
+    // the bounds are within an eighth of an octave above the durations
+    ASSERT(top_k_selection.p50 >= std::chrono::microseconds(51) && top_k_selection.p50 <= std::chrono::microseconds(58));
+    ASSERT(top_k_selection.p90 >= std::chrono::microseconds(91) && top_k_selection.p90 <= std::chrono::microseconds(103));
+    ASSERT(top_k_selection.p99 >= std::chrono::microseconds(100) && top_k_selection.p99 <= std::chrono::microseconds(113));
+    ASSERT(top_k_selection.max >= std::chrono::milliseconds(1) && top_k_selection.max <= std::chrono::microseconds(1'125));
+
+#ifdef SEARCH_SERVER_HAS_METRICS
+    // one record per call of an operation
+    metrics.Reset();
+    SearchServer search_server("and in at"s);
+    for (int document_id = 0; document_id < 10; ++document_id) {
+        search_server.AddDocument(document_id, "curly dog and fancy collar "s + std::to_string(document_id),
+                DocumentStatus::ACTUAL, {1, 2, 3});
+    }
+    for (int i = 0; i < 7; ++i) {
+        search_server.FindTopDocuments("curly -cat"s);
+    }
+    for (int document_id = 0; document_id < 5; ++document_id) {
+        search_server.MatchDocument("fancy dog"s, document_id);
+    }
+    search_server.RemoveDocument(0);
+    snapshot = metrics.GetSnapshot();
+    ASSERT_EQUAL(find_metric(snapshot, "add_document"s).count, 10u);
+    ASSERT_EQUAL(find_metric(snapshot, "find_top_documents"s).count, 7u);
+    ASSERT_EQUAL(find_metric(snapshot, "match_document"s).count, 5u);
+    ASSERT_EQUAL(find_metric(snapshot, "remove_document"s).count, 1u);
+    ASSERT_EQUAL(find_metric(snapshot, "query_parse"s).count, 12u);
+    ASSERT_EQUAL(find_metric(snapshot, "index_update"s).count, 10u);
+    for (const MetricSnapshot& metric : snapshot) {
+        ASSERT_HINT(metric.p50 <= metric.p90 && metric.p90 <= metric.p99 && metric.p99 <= metric.max, metric.name);
+    }
+
+    // with a result cache every search is recorded once, the hits as well as the misses
+    const auto cache = std::make_shared<QueryResultCache>(16);
+    search_server.AttachResultCache(cache);
+    const PreparedQuery prepared_query = search_server.Prepare("fancy -cat"s);
+    metrics.Reset();
+    for (int i = 0; i < 4; ++i) {
+        search_server.FindTopDocuments("curly -cat"s);
+        search_server.FindTopDocuments(std::execution::par, "curly -cat"s, DocumentStatus::BANNED);
+        search_server.FindTopDocuments(prepared_query);
+        search_server.FindTopDocuments(std::execution::par, prepared_query, DocumentStatus::BANNED);
+    }
+    snapshot = metrics.GetSnapshot();
+    ASSERT_EQUAL(find_metric(snapshot, "find_top_documents"s).count, 16u);
+    ASSERT_EQUAL(find_metric(snapshot, "query_parse"s).count, 8u);
+    ASSERT_EQUAL(cache->GetStats().hits, 12u);
+#endif
+
+    // {"metrics":[{"name":...,"count":...,"total_ns":...,"p50_ns":...,"p90_ns":...,"p99_ns":...,"max_ns":...}, ...]}
+    metrics.Reset();
+    metrics.Record(Metric::QUERY_PARSE, std::chrono::nanoseconds(5));
+    std::ostringstream output;
+    metrics.PrintJson(output);
+    const std::string json = output.str();
+    ASSERT_EQUAL(json.substr(0, 13), "{\"metrics\":[{"s);
+    ASSERT_EQUAL(json.substr(json.size() - 4), "}]}\n"s);
+    size_t object_count = 0;
+    for (size_t position = json.find("{\"name\":\""s); position != std::string::npos;
+            position = json.find("{\"name\":\""s, position + 1)) {
+        const size_t end = json.find('}', position);
+        const std::string object = json.substr(position, end - position + 1);
+        size_t key_position = 0;
+        for (const std::string& key : {"name"s, "count"s, "total_ns"s, "p50_ns"s, "p90_ns"s, "p99_ns"s, "max_ns"s}) {
+            const size_t found = object.find("\""s + key + "\":"s, key_position);
+            ASSERT_HINT(found != std::string::npos, object);
+            key_position = found;
+        }
+        ++object_count;
+    }
+    ASSERT_EQUAL(object_count, snapshot.size());
+    ASSERT(json.find("{\"name\":\"query_parse\",\"count\":1,\"total_ns\":5,"s) != std::string::npos);
+    ASSERT(json.find("{\"name\":\"find_top_documents\",\"count\":0,\"total_ns\":0,"s) != std::string::npos);
+
+    // nothing is recorded while disabled
+    metrics.SetEnabled(false);
+    metrics.Reset();
+    {
+        METRIC_SCOPE(Metric::RESULT_BUILD);
+    }
+    ASSERT_EQUAL(find_metric(metrics.GetSnapshot(), "result_build"s).count, 0u);
+    metrics.SetEnabled(was_enabled);
+    std::cerr << "TestMetricsRegistry - OK\n";
+}
+
+void TestConcurrentRequestQueue() {
+    SearchServer search_server("and in at"s);
+    search_server.AddDocument(1, "curly cat curly tail"s, DocumentStatus::ACTUAL, {7, 2, 7});
+    search_server.AddDocument(2, "curly dog and fancy collar"s, DocumentStatus::ACTUAL, {1, 2, 3});
+
+    // requests of several threads over a window which doesn't roll over during the test
+    {
+        ConcurrentRequestQueue request_queue(search_server, {std::chrono::seconds(1), 300, 4});
+        std::vector<std::thread> threads;
+        for (int thread = 0; thread < 4; ++thread) {
+            threads.emplace_back([&request_queue]() {
+                for (int i = 0; i < 250; ++i) {
+                    request_queue.AddFindRequest(i % 5 == 0 ? "curly"s : "empty request"s);
+                }
+            });
+        }
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+        const RequestQueueStats stats = request_queue.GetStats();
+        ASSERT_EQUAL(stats.request_count, 1'000u);
+        ASSERT_EQUAL(stats.no_result_count, 800u);
+        ASSERT_EQUAL(request_queue.GetNoResultRequests(), 800);
+        ASSERT_EQUAL(stats.result_count_histogram[0], 800u);
+        ASSERT_EQUAL(stats.result_count_histogram[2], 200u);
+    }
+
+    // the requests leave the statistics once the buckets roll over, a reused bucket starts from zero
+    {
+        const auto bucket_duration = std::chrono::milliseconds(50);
+        const size_t bucket_count = 3;
+        ConcurrentRequestQueue request_queue(search_server, {bucket_duration, bucket_count, 1});
+        for (int i = 0; i < 5; ++i) {
+            request_queue.AddFindRequest("empty request"s);
+        }
+        request_queue.AddFindRequest("curly dog"s);
+        ASSERT_EQUAL(request_queue.GetNoResultRequests(), 5);
+        ASSERT_EQUAL(request_queue.GetStats().request_count, 6u);
+
+        std::this_thread::sleep_for(bucket_duration * (bucket_count + 1));
+        ASSERT_EQUAL(request_queue.GetNoResultRequests(), 0);
+        ASSERT_EQUAL(request_queue.GetStats().request_count, 0u);
+
+        // one request in each of the next periods, half a bucket off the bounds, so
+        // that every bucket of the ring is reused; the current period stays empty
+        std::this_thread::sleep_for(bucket_duration / 2);
+        for (size_t period = 0; period < bucket_count + 1; ++period) {
+            request_queue.Record(0, std::chrono::microseconds(10));
+            std::this_thread::sleep_for(bucket_duration);
+        }
+        const int no_result_count = request_queue.GetNoResultRequests();
+        ASSERT_EQUAL(no_result_count, static_cast<int>(bucket_count) - 1);
+        request_queue.Record(0, std::chrono::microseconds(10));
+        request_queue.Record(3, std::chrono::microseconds(10));
+        ASSERT_EQUAL(request_queue.GetNoResultRequests(), no_result_count + 1);
+    }
+    std::cerr << "TestConcurrentRequestQueue - OK\n";
+}
+
 void TestGetDocumentCount() {
     SearchServer search_server("and"s);
     std::cerr << search_server.GetDocumentCount() << " documents\n";
@@ -214,13 +571,82 @@ std::vector<std::string> GenerateQueries(std::mt19937& generator, const std::vec
     return queries;
 }
 
+// Distinct words of the dictionary, never its first one, which is the stop word
+std::vector<std::string> SampleWords(std::mt19937& generator, const std::vector<std::string>& dictionary, size_t count) {
+    std::vector<std::string> words(dictionary.begin() + 1, dictionary.end());
+    std::shuffle(words.begin(), words.end(), generator);
+    words.resize(count);
+    return words;
+}
+
+std::string JoinWords(const std::vector<std::string>& words) {
+    std::string text;
+    for (const std::string& word : words) {
+        text += (text.empty() ? ""s : " "s) + word;
+    }
+    return text;
+}
+
+void TestFindDuplicates() {
+    std::mt19937 generator(3);
+    const auto dictionary = GenerateDictionary(generator, 3000, 10);
+    SearchServer search_server(dictionary[0]);
+    // unrelated documents share a couple of words at most, far from any threshold
+    std::vector<std::vector<std::string>> originals;
+    for (int document_id = 0; document_id < 300; ++document_id) {
+        originals.push_back(SampleWords(generator, dictionary, 30));
+        search_server.AddDocument(document_id, JoinWords(originals.back()), DocumentStatus::ACTUAL, {1});
+    }
+    std::vector<int> exact_duplicates;
+    std::vector<int> near_duplicates;
+    for (int i = 0; i < 30; ++i) {
+        // two words of 30 replaced: Jaccard similarity 28 / 32
+        std::vector<std::string> words = originals[i * 7];
+        words[3] = "near"s + std::to_string(i);
+        words[17] = "other"s + std::to_string(i);
+        const int near_id = 1000 + i;
+        search_server.AddDocument(near_id, JoinWords(words), DocumentStatus::ACTUAL, {1});
+        near_duplicates.push_back(near_id);
+
+        // the same words in another order, repeated and with the stop word
+        words = originals[i * 7 + 1];
+        std::shuffle(words.begin(), words.end(), generator);
+        words.push_back(words.front());
+        words.push_back(dictionary[0]);
+        const int exact_id = 2000 + i;
+        search_server.AddDocument(exact_id, JoinWords(words), DocumentStatus::ACTUAL, {1});
+        exact_duplicates.push_back(exact_id);
+        near_duplicates.push_back(exact_id);
+    }
+    std::sort(near_duplicates.begin(), near_duplicates.end());
+
+    ASSERT_EQUAL(FindDuplicates(search_server), exact_duplicates);
+    ASSERT_EQUAL(FindDuplicates(std::execution::par, search_server), exact_duplicates);
+    ASSERT_EQUAL(FindNearDuplicates(search_server, 0.8), near_duplicates);
+    ASSERT_EQUAL(FindNearDuplicates(std::execution::par, search_server, 0.8), near_duplicates);
+    // 28 / 32 is below 0.9, only the exact duplicates are that similar
+    ASSERT_EQUAL(FindNearDuplicates(search_server, 0.9), exact_duplicates);
+    ASSERT_EQUAL(FindNearDuplicates(search_server, 1.0), exact_duplicates);
+    try {
+        FindNearDuplicates(search_server, 0.0);
+        ASSERT_HINT(false, "zero threshold accepted"s);
+    } catch (const std::invalid_argument&) {
+    }
+
+    ASSERT_EQUAL(RemoveDuplicates(search_server, 0.8), near_duplicates);
+    ASSERT_EQUAL(search_server.GetDocumentCount(), 300);
+    ASSERT(FindNearDuplicates(search_server, 0.8).empty());
+    std::cerr << "TestFindDuplicates - OK\n";
+}
+
 template <typename QueriesProcessor>
 void TestProcessQueries(std::string mark, QueriesProcessor processor, const SearchServer& search_server, const std::vector<std::string>& queries) {
     LOG_DURATION(mark);
     const auto documents_lists = processor(search_server, queries);
 }
 
-#define TEST_PROCESS_QUERIES(processor) TestProcessQueries(#processor, processor, search_server, queries)
+#define TEST_PROCESS_QUERIES(processor) TestProcessQueries(#processor, \
+        [](const auto&... args) { return processor(args...); }, search_server, queries)
 
 void TestProcessQueries() {
     std::mt19937 generator;
@@ -235,6 +661,174 @@ void TestProcessQueries() {
     std::cerr << "TestProcessQueries - OK\n";
 }
 
+void TestProcessQueryStream() {
+    std::mt19937 generator(17);
+    const auto dictionary = GenerateDictionary(generator, 300, 8);
+    const auto documents = GenerateQueries(generator, dictionary, 1'000, 20);
+    SearchServer search_server(dictionary[0]);
+    for (size_t i = 0; i < documents.size(); ++i) {
+        search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, {1, 2, 3});
+    }
+    const auto queries = GenerateQueries(generator, dictionary, 200, 4);
+    std::vector<std::vector<Document>> expected;
+    std::vector<Document> expected_joined;
+    for (const std::string& query : queries) {
+        expected.push_back(search_server.FindTopDocuments(query));
+        expected_joined.insert(expected_joined.end(), expected.back().begin(), expected.back().end());
+    }
+    ThreadPool pool(4);
+    ASSERT_EQUAL(ProcessQueriesJoined(search_server, queries), expected_joined);
+    ASSERT_EQUAL(ProcessQueriesJoined(pool, search_server, queries), expected_joined);
+
+    // own threads and the pool, with a window smaller than the number of threads and a large one
+    for (Executor* executor : {static_cast<Executor*>(nullptr), static_cast<Executor*>(&pool)}) {
+        for (size_t max_in_flight : {1u, 3u, 64u}) {
+            QueryStreamOptions options;
+            options.executor = executor;
+            options.thread_count = 4;
+            options.max_in_flight = max_in_flight;
+            std::vector<size_t> query_indexes;
+            ProcessQueryRange(search_server, queries, [&](size_t query_index, std::vector<Document> documents) {
+                ASSERT_EQUAL(documents, expected[query_index]);
+                query_indexes.push_back(query_index);
+            }, options);
+            for (size_t i = 0; i < query_indexes.size(); ++i) {
+                ASSERT_EQUAL(query_indexes[i], i);
+            }
+            ASSERT_EQUAL(query_indexes.size(), queries.size());
+
+            options.ordered = false;
+            query_indexes.clear();
+            ProcessQueryRange(search_server, queries, [&](size_t query_index, std::vector<Document> documents) {
+                ASSERT_EQUAL(documents, expected[query_index]);
+                query_indexes.push_back(query_index);
+            }, options);
+            std::sort(query_indexes.begin(), query_indexes.end());
+            for (size_t i = 0; i < query_indexes.size(); ++i) {
+                ASSERT_EQUAL(query_indexes[i], i);
+            }
+            ASSERT_EQUAL(query_indexes.size(), queries.size());
+
+            // the error of the first bad query comes after the results of all queries before it
+            std::vector<std::string> bad_queries = queries;
+            bad_queries[50] = dictionary[1] + " -"s;
+            bad_queries[51] = dictionary[1] + " \x01"s;
+            options.ordered = true;
+            query_indexes.clear();
+            try {
+                ProcessQueryRange(search_server, bad_queries, [&](size_t query_index, std::vector<Document> documents) {
+                    query_indexes.push_back(query_index);
+                }, options);
+                ASSERT_HINT(false, "the error of a query must be rethrown"s);
+            } catch (const std::invalid_argument& error) {
+                ASSERT_EQUAL(std::string(error.what()), "   "s);
+            }
+            ASSERT_EQUAL(query_indexes.size(), 50u);
+            for (size_t i = 0; i < query_indexes.size(); ++i) {
+                ASSERT_EQUAL(query_indexes[i], i);
+            }
+        }
+    }
+    std::cerr << "TestProcessQueryStream - OK\n";
+}
+
+void TestThreadPool() {
+    // the subtasks of a task go to the queue of its thread, which waits for them,
+    // so the other threads can only steal them
+    {
+        ThreadPool pool(4);
+        const int subtask_count = 100;
+        std::atomic<int> finished_count{0};
+        std::atomic<bool> is_parent_done{false};
+        pool.Execute([&]() {
+            for (int i = 0; i < subtask_count; ++i) {
+                pool.Execute([&finished_count]() { ++finished_count; });
+            }
+            while (finished_count.load() < subtask_count) {
+                std::this_thread::yield();
+            }
+            is_parent_done = true;
+        });
+        while (!is_parent_done.load()) {
+            std::this_thread::yield();
+        }
+        ASSERT_EQUAL(pool.GetStats().steal_count, static_cast<uint64_t>(subtask_count));
+    }
+
+    // a ParallelFor in a task of the pool runs its indexes on the waiting thread too
+    {
+        ThreadPool pool(2);
+        std::vector<std::atomic<int>> calls(100 * 100);
+        ParallelFor(pool, 100, [&](size_t i) {
+            ParallelFor(pool, 100, [&, i](size_t j) {
+                ++calls[i * 100 + j];
+            });
+        });
+        ASSERT(std::all_of(calls.begin(), calls.end(), [](const std::atomic<int>& count) { return count.load() == 1; }));
+    }
+
+    // the first exception is rethrown, also through a nested ParallelFor, and the pool stays usable
+    {
+        ThreadPool pool(4);
+        for (const bool is_nested : {false, true}) {
+            std::atomic<int> call_count{0};
+            try {
+                ParallelFor(pool, 1'000, [&](size_t i) {
+                    auto function = [&call_count](size_t j) {
+                        ++call_count;
+                        if (j == 37) {
+                            throw std::runtime_error("index 37"s);
+                        }
+                    };
+                    if (is_nested) {
+                        ParallelFor(pool, 100, function);
+                    } else {
+                        function(i);
+                    }
+                });
+                ASSERT_HINT(false, "the exception must be rethrown"s);
+            } catch (const std::runtime_error& error) {
+                ASSERT_EQUAL(std::string(error.what()), "index 37"s);
+            }
+            ASSERT(call_count.load() > 0);
+        }
+        std::atomic<int> call_count{0};
+        ParallelFor(pool, 1'000, [&call_count](size_t i) { ++call_count; });
+        ASSERT_EQUAL(call_count.load(), 1'000);
+    }
+
+#if defined(__linux__)
+    // every task of a pinned pool runs on one of the CPUs allowed to the process
+    {
+        cpu_set_t allowed;
+        CPU_ZERO(&allowed);
+        sched_getaffinity(0, sizeof(allowed), &allowed);
+        ThreadPool pool({2, true});
+        const int task_count = 64;
+        std::atomic<int> finished_count{0};
+        std::atomic<int> unpinned_count{0};
+        for (int i = 0; i < task_count; ++i) {
+            pool.Execute([&]() {
+                cpu_set_t cpu_set;
+                CPU_ZERO(&cpu_set);
+                pthread_getaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set);
+                const int cpu_count = CPU_COUNT(&cpu_set);
+                CPU_AND(&cpu_set, &cpu_set, &allowed);
+                if (cpu_count != 1 || CPU_COUNT(&cpu_set) != 1) {
+                    ++unpinned_count;
+                }
+                ++finished_count;
+            });
+        }
+        while (finished_count.load() < task_count) {
+            std::this_thread::yield();
+        }
+        ASSERT_EQUAL(unpinned_count.load(), 0);
+    }
+#endif
+    std::cerr << "TestThreadPool - OK\n";
+}
+
 template <typename ExecutionPolicy>
 void TestRemoveDocumentParalley(std::string mark, SearchServer search_server, ExecutionPolicy&& policy) {
     LOG_DURATION(mark);
@@ -297,3 +891,1393 @@ void TestMatchDocumentParalley() {
     TEST_MATCH_DOCUMENT_PARALLEY(seq);
     TEST_MATCH_DOCUMENT_PARALLEY(par);
 }
+
+void TestMatchDocuments() {
+    std::mt19937 generator(19);
+    const auto dictionary = GenerateDictionary(generator, 300, 8);
+    const auto documents = GenerateQueries(generator, dictionary, 3'000, 20);
+    SearchServer search_server(dictionary[0]);
+    for (size_t i = 0; i < documents.size(); ++i) {
+        search_server.AddDocument(i, documents[i], static_cast<DocumentStatus>(i % 4), {1, 2, 3});
+    }
+    for (int document_id = 0; document_id < 3'000; document_id += 7) {
+        search_server.RemoveDocument(document_id);
+    }
+    // several ranges of documents, in no particular order and with repeats
+    std::vector<int> document_ids;
+    for (int document_id : search_server) {
+        document_ids.push_back(document_id);
+    }
+    std::shuffle(document_ids.begin(), document_ids.end(), generator);
+    document_ids.insert(document_ids.end(), document_ids.begin(), document_ids.begin() + 100);
+
+    ThreadPool pool(4);
+    for (int i = 0; i < 10; ++i) {
+        const std::string query = GenerateQuery(generator, dictionary, 8, 0.2);
+        std::vector<std::tuple<std::vector<std::string_view>, DocumentStatus>> expected;
+        for (int document_id : document_ids) {
+            expected.push_back(search_server.MatchDocument(query, document_id));
+        }
+        ASSERT(search_server.MatchDocuments(query, document_ids) == expected);
+        ASSERT(search_server.MatchDocuments(std::execution::seq, query, document_ids) == expected);
+        ASSERT(search_server.MatchDocuments(std::execution::par, query, document_ids) == expected);
+        ASSERT(search_server.MatchDocuments(pool, query, document_ids) == expected);
+        const PreparedQuery prepared_query = search_server.Prepare(query);
+        ASSERT(search_server.MatchDocuments(prepared_query, document_ids) == expected);
+        ASSERT(search_server.MatchDocuments(std::execution::par, prepared_query, document_ids) == expected);
+    }
+    ASSERT(search_server.MatchDocuments(dictionary[1], {}).empty());
+    try {
+        search_server.MatchDocuments(dictionary[1], {1, 3'000});
+        ASSERT_HINT(false, "an unknown id must be rejected"s);
+    } catch (const std::out_of_range&) {
+    }
+    std::cerr << "TestMatchDocuments - OK\n";
+}
+
+void TestPreparedQuery() {
+    std::mt19937 generator(23);
+    const auto dictionary = GenerateDictionary(generator, 300, 8);
+    const auto documents = GenerateQueries(generator, dictionary, 1'500, 20);
+    const auto queries = GenerateQueries(generator, dictionary, 20, 4);
+    SearchServer search_server(dictionary[0]);
+    for (int document_id = 0; document_id < 1'000; ++document_id) {
+        search_server.AddDocument(document_id, documents[document_id], DocumentStatus::ACTUAL, {document_id % 5});
+    }
+    std::vector<std::string> raw_queries;
+    std::vector<PreparedQuery> prepared_queries;
+    for (const std::string& query : queries) {
+        raw_queries.push_back(query + " -"s + dictionary[query.size() % dictionary.size()]);
+        prepared_queries.push_back(search_server.Prepare(raw_queries.back()));
+    }
+    ThreadPool pool(4);
+    auto assert_same_results = [&](const SearchServer& server) {
+        for (size_t i = 0; i < raw_queries.size(); ++i) {
+            const std::vector<Document> expected = server.FindTopDocuments(raw_queries[i]);
+            ASSERT_EQUAL(server.FindTopDocuments(prepared_queries[i]), expected);
+            ASSERT_EQUAL(server.FindTopDocuments(std::execution::par, prepared_queries[i], DocumentStatus::ACTUAL), expected);
+            ASSERT_EQUAL(server.FindTopDocuments(pool, prepared_queries[i], DocumentStatus::ACTUAL), expected);
+            for (int document_id : {1, 2, 500, 998}) {
+                ASSERT(server.MatchDocument(prepared_queries[i], document_id) == server.MatchDocument(raw_queries[i], document_id));
+            }
+        }
+    };
+    assert_same_results(search_server);
+
+    // a copy of the server changes, the original stays as it was
+    SearchServer changed_server = search_server;
+    for (int document_id = 1'000; document_id < 1'500; ++document_id) {
+        changed_server.AddDocument(document_id, documents[document_id], DocumentStatus::ACTUAL, {document_id % 5});
+    }
+    for (int document_id = 0; document_id < 1'000; document_id += 3) {
+        changed_server.RemoveDocument(document_id);
+    }
+    assert_same_results(changed_server);
+    assert_same_results(search_server);
+
+    // several threads search a query resolved against another state of the index
+    changed_server.AddDocument(1'500, documents[0], DocumentStatus::ACTUAL, {1});
+    std::vector<std::thread> threads;
+    std::atomic<int> mismatch_count{0};
+    for (int thread = 0; thread < 4; ++thread) {
+        threads.emplace_back([&]() {
+            for (size_t i = 0; i < prepared_queries.size(); ++i) {
+                if (changed_server.FindTopDocuments(prepared_queries[i]) != changed_server.FindTopDocuments(raw_queries[i])) {
+                    ++mismatch_count;
+                }
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    ASSERT_EQUAL(mismatch_count.load(), 0);
+
+#ifdef SEARCH_SERVER_HAS_METRICS
+    // the words are looked up once after a change of the index, by the first search
+    MetricsRegistry& metrics = MetricsRegistry::Instance();
+    const bool was_enabled = metrics.IsEnabled();
+    metrics.SetEnabled(true);
+    auto count_term_lookups = [&metrics]() {
+        return metrics.GetSnapshot()[static_cast<size_t>(Metric::TERM_LOOKUP)].count;
+    };
+    const PreparedQuery copy = prepared_queries[0];
+    changed_server.FindTopDocuments(prepared_queries[0]);
+    metrics.Reset();
+    for (int i = 0; i < 5; ++i) {
+        changed_server.FindTopDocuments(copy);
+    }
+    ASSERT_EQUAL(count_term_lookups(), 5u);
+    changed_server.RemoveDocument(1'500);
+    metrics.Reset();
+    for (int i = 0; i < 5; ++i) {
+        changed_server.FindTopDocuments(prepared_queries[0]);
+    }
+    ASSERT_EQUAL(count_term_lookups(), 6u);
+    metrics.SetEnabled(was_enabled);
+#endif
+    std::cerr << "TestPreparedQuery - OK\n";
+}
+
+template <typename ExecutionPolicy>
+void BenchmarkFindTopDocumentsParalley(std::string_view mark, const SearchServer& search_server, const std::vector<std::string>& queries, ExecutionPolicy&& policy) {
+    LOG_DURATION(mark);
+    double total_relevance = 0;
+    for (const std::string_view query : queries) {
+        for (const auto& document : search_server.FindTopDocuments(policy, query)) {
+            total_relevance += document.relevance;
+        }
+    }
+    std::cout << total_relevance << std::endl;
+}
+
+#define BENCHMARK_FIND_TOP_DOCUMENTS_PARALLEY(policy) BenchmarkFindTopDocumentsParalley(#policy, search_server, queries, std::execution::policy)
+
+void BenchmarkFindTopDocumentsParalley() {
+    std::mt19937 generator;
+    const auto dictionary = GenerateDictionary(generator, 1000, 10);
+    const auto documents = GenerateQueries(generator, dictionary, 10'000, 70);
+    const auto queries = GenerateQueries(generator, dictionary, 100, 70);
+
+    SearchServer search_server(dictionary[0]);
+    for (size_t i = 0; i < documents.size(); ++i) {
+        search_server.AddDocument(i, documents[i], DocumentStatus::ACTUAL, {1, 2, 3});
+    }
+
+    BENCHMARK_FIND_TOP_DOCUMENTS_PARALLEY(seq);
+    BENCHMARK_FIND_TOP_DOCUMENTS_PARALLEY(par);
+}
+
+void TestFindTopDocumentsParalley() {
+    std::mt19937 generator;
+    const auto dictionary = GenerateDictionary(generator, 1000, 10);
+    const auto documents = GenerateQueries(generator, dictionary, 10'000, 70);
+    std::vector<std::string> queries;
+    for (int i = 0; i < 100; ++i) {
+        queries.push_back(GenerateQuery(generator, dictionary, 70, 0.1));
+    }
+
+    SearchServer search_server(dictionary[0]);
+    for (size_t i = 0; i < documents.size(); ++i) {
+        search_server.AddDocument(i, documents[i], static_cast<DocumentStatus>(i % 4), {static_cast<int>(i % 7)});
+    }
+
+    for (const std::string& query : queries) {
+        const std::vector<Document> expected = search_server.FindTopDocuments(query);
+        ASSERT_EQUAL_HINT(search_server.FindTopDocuments(std::execution::seq, query), expected, query);
+        ASSERT_EQUAL_HINT(search_server.FindTopDocuments(std::execution::par, query), expected, query);
+        ASSERT_EQUAL_HINT(search_server.FindTopDocuments(std::execution::par, query, DocumentStatus::BANNED, 20),
+                search_server.FindTopDocuments(query, DocumentStatus::BANNED, 20), query);
+        const auto predicate = [](int document_id, DocumentStatus status, int rating) {
+            return document_id % 3 == 0 && rating > 2;
+        };
+        ASSERT_EQUAL_HINT(search_server.FindTopDocuments(std::execution::par, query, predicate, 10, 5),
+                search_server.FindTopDocuments(query, predicate, 10, 5), query);
+    }
+    std::cerr << "TestFindTopDocumentsParalley - OK\n";
+}
+
+// Relevance of every document computed from its word frequencies, sorted by IsMoreRelevant
+template <typename Predicate>
+std::vector<Document> FindAllDocumentsByWords(const SearchServer& search_server, const std::string& raw_query,
+                                              Predicate predicate) {
+    std::vector<std::string> plus_words;
+    std::vector<std::string> minus_words;
+    for (const std::string_view word : SplitIntoWords(raw_query)) {
+        if (word[0] == '-') {
+            minus_words.emplace_back(word.substr(1));
+        } else if (std::find(plus_words.begin(), plus_words.end(), word) == plus_words.end()) {
+            plus_words.emplace_back(word);
+        }
+    }
+    std::vector<double> inverse_document_freqs;
+    for (const std::string& word : plus_words) {
+        int document_freq = 0;
+        for (const int document_id : search_server) {
+            document_freq += search_server.GetWordFrequencies(document_id).Find(word) ? 1 : 0;
+        }
+        inverse_document_freqs.push_back(document_freq > 0 ? std::log(search_server.GetDocumentCount() * 1.0 / document_freq) : 0.0);
+    }
+    std::vector<Document> documents;
+    for (const int document_id : search_server) {
+        const WordFrequencies word_frequencies = search_server.GetWordFrequencies(document_id);
+        if (std::any_of(minus_words.begin(), minus_words.end(),
+                [&word_frequencies](const std::string& word) { return word_frequencies.Find(word).has_value(); })) {
+            continue;
+        }
+        // the test documents are rated by their ids and get the statuses in turn
+        if (!predicate(document_id, static_cast<DocumentStatus>(document_id % 4), document_id)) {
+            continue;
+        }
+        bool is_found = false;
+        double relevance = 0.0;
+        for (size_t i = 0; i < plus_words.size(); ++i) {
+            if (const std::optional<double> term_freq = word_frequencies.Find(plus_words[i])) {
+                is_found = true;
+                relevance += *term_freq * inverse_document_freqs[i];
+            }
+        }
+        if (is_found) {
+            documents.push_back({document_id, relevance, document_id});
+        }
+    }
+    std::sort(documents.begin(), documents.end(), IsMoreRelevant);
+    return documents;
+}
+
+// Queries with enough postings are pruned, their results must be the ones of the exhaustive search
+void TestFindTopDocumentsPruned() {
+    std::mt19937 generator(42);
+    const auto dictionary = GenerateDictionary(generator, 200, 8);
+    const auto documents = GenerateQueries(generator, dictionary, 3'000, 30);
+    SearchServer search_server(dictionary[0]);
+    for (size_t i = 0; i < documents.size(); ++i) {
+        const int document_id = static_cast<int>(i);
+        search_server.AddDocument(document_id, documents[i], static_cast<DocumentStatus>(i % 4), {document_id});
+    }
+    const auto predicate = [](int document_id, DocumentStatus status, int rating) {
+        return status != DocumentStatus::REMOVED && document_id % 5 != 0;
+    };
+    const auto check_queries = [&]() {
+        for (int i = 0; i < 60; ++i) {
+            const std::string query = GenerateQuery(generator, dictionary, 12, 0.15);
+            const std::vector<Document> all_documents = FindAllDocumentsByWords(search_server, query,
+                    [](int document_id, DocumentStatus status, int rating) { return status == DocumentStatus::ACTUAL; });
+            const std::vector<Document> expected(all_documents.begin(),
+                    all_documents.begin() + std::min<size_t>(all_documents.size(), MAX_RESULT_DOCUMENT_COUNT));
+            ASSERT_EQUAL_HINT(search_server.FindTopDocuments(query), expected, query);
+            ASSERT_EQUAL_HINT(search_server.FindTopDocuments(std::execution::par, query), expected, query);
+
+            const std::vector<Document> filtered_documents = FindAllDocumentsByWords(search_server, query, predicate);
+            const size_t offset = std::min<size_t>(filtered_documents.size(), 7);
+            const std::vector<Document> page(filtered_documents.begin() + offset,
+                    filtered_documents.begin() + std::min<size_t>(filtered_documents.size(), offset + 20));
+            ASSERT_EQUAL_HINT(search_server.FindTopDocuments(query, predicate, 20, 7), page, query);
+        }
+    };
+    check_queries();
+    // the block bounds of the postings may be left above the remaining ones
+    for (int document_id = 0; document_id < static_cast<int>(documents.size()); document_id += 3) {
+        search_server.RemoveDocument(document_id);
+    }
+    check_queries();
+    std::cerr << "TestFindTopDocumentsPruned - OK\n";
+}
+
+// The shards compute the inverse document frequencies over all of them
+void TestShardedSearchServer() {
+    std::mt19937 generator(7);
+    const auto dictionary = GenerateDictionary(generator, 200, 8);
+    // enough documents for the shards to use the pruned search
+    const auto documents = GenerateQueries(generator, dictionary, 9'000, 30);
+    SearchServer search_server(dictionary[0]);
+    ShardedSearchServer sharded_server(dictionary[0], 3);
+    for (size_t i = 0; i < documents.size(); ++i) {
+        const int document_id = static_cast<int>(i);
+        search_server.AddDocument(document_id, documents[i], static_cast<DocumentStatus>(i % 4), {document_id});
+        sharded_server.AddDocument(document_id, documents[i], static_cast<DocumentStatus>(i % 4), {document_id});
+    }
+    const auto predicate = [](int document_id, DocumentStatus status, int rating) {
+        return status != DocumentStatus::REMOVED && document_id % 5 != 0;
+    };
+    const auto check_queries = [&]() {
+        ASSERT_EQUAL(sharded_server.GetDocumentCount(), search_server.GetDocumentCount());
+        for (int i = 0; i < 50; ++i) {
+            const std::string query = GenerateQuery(generator, dictionary, 12, 0.15);
+            const std::vector<Document> expected = search_server.FindTopDocuments(query);
+            ASSERT_EQUAL_HINT(sharded_server.FindTopDocuments(query), expected, query);
+            ASSERT_EQUAL_HINT(sharded_server.FindTopDocuments(std::execution::seq, query), expected, query);
+            ASSERT_EQUAL_HINT(sharded_server.FindTopDocuments(std::execution::par, query), expected, query);
+            ASSERT_EQUAL_HINT(sharded_server.FindTopDocuments(query, predicate, 20, 7),
+                    search_server.FindTopDocuments(query, predicate, 20, 7), query);
+            ASSERT_EQUAL_HINT(sharded_server.FindTopDocuments(std::execution::par, query, DocumentStatus::BANNED, 10),
+                    search_server.FindTopDocuments(query, DocumentStatus::BANNED, 10), query);
+            const int document_id = std::uniform_int_distribution<int>(0, documents.size() - 1)(generator);
+            if (search_server.GetWordFrequencies(document_id).empty()) {
+                continue;
+            }
+            ASSERT_EQUAL_HINT(sharded_server.MatchDocument(query, document_id), search_server.MatchDocument(query, document_id), query);
+        }
+    };
+    check_queries();
+    for (int document_id = 0; document_id < static_cast<int>(documents.size()); document_id += 3) {
+        search_server.RemoveDocument(document_id);
+        sharded_server.RemoveDocument(document_id);
+    }
+    check_queries();
+    std::cerr << "TestShardedSearchServer - OK\n";
+}
+
+// Same documents, word frequencies, matches and search results
+double PostingTermFreq(int document_id, uint32_t count) {
+    return count / (1.0 + document_id % 7);
+}
+
+// Compares the postings with the expected ones and returns the sizes of the blocks, which
+// are told apart by the bounds the iterator reports. With exact_bounds the bound of every
+// block is the maximum of PostingTermFreq over its postings, otherwise not less than it
+std::vector<size_t> AssertPostingList(const PostingList& list, const std::map<int, uint32_t>& expected, bool exact_bounds) {
+    ASSERT_EQUAL(list.size(), expected.size());
+    ASSERT_EQUAL(list.empty(), expected.empty());
+    std::vector<size_t> block_sizes;
+    int block_last_id = std::numeric_limits<int>::min();
+    double block_max_term_freq = 0.0;
+    double block_bound = 0.0;
+    double list_bound = 0.0;
+    auto close_block = [&]() {
+        if (!block_sizes.empty()) {
+            ASSERT_HINT(block_max_term_freq <= block_bound, std::to_string(block_last_id));
+            ASSERT_HINT(!exact_bounds || block_max_term_freq == block_bound, std::to_string(block_last_id));
+            list_bound = std::max(list_bound, block_bound);
+        }
+    };
+    PostingList::Iterator it = list.begin();
+    int previous_id = -1;
+    for (const auto& [document_id, count] : expected) {
+        ASSERT_HINT(!it.AtEnd(), std::to_string(document_id));
+        ASSERT_EQUAL((*it).document_id, document_id);
+        ASSERT_EQUAL((*it).count, count);
+        ASSERT(list.Contains(document_id));
+        if (document_id > previous_id + 1) {
+            ASSERT(!list.Contains(document_id - 1));
+        }
+        previous_id = document_id;
+        const PostingList::BlockBound bound = it.GetBlockBound(document_id);
+        if (bound.last_id != block_last_id) {
+            ASSERT(bound.last_id > block_last_id);
+            close_block();
+            block_sizes.push_back(0);
+            block_last_id = bound.last_id;
+            block_max_term_freq = 0.0;
+            block_bound = bound.max_term_freq;
+        }
+        ++block_sizes.back();
+        block_max_term_freq = std::max(block_max_term_freq, PostingTermFreq(document_id, count));
+        ++it;
+        // the last id of a block is the one of its last posting
+        ASSERT_EQUAL(document_id == block_last_id, it.AtEnd() || it.GetBlockBound((*it).document_id).last_id != block_last_id);
+    }
+    close_block();
+    ASSERT(it.AtEnd() && it == list.end());
+    ASSERT_EQUAL(it.GetBlockBound(0).last_id, std::numeric_limits<int>::max());
+    for (const size_t block_size : block_sizes) {
+        ASSERT(block_size > 0 && block_size <= PostingList::BLOCK_SIZE);
+    }
+    // the bound of the list is the largest of the block bounds
+    ASSERT_EQUAL(list.GetMaxTermFreq(), list_bound);
+    return block_sizes;
+}
+
+void TestPostingList() {
+    const size_t block_size = PostingList::BLOCK_SIZE;
+    const PostingList::TermFreqFunction term_freq = PostingTermFreq;
+    std::mt19937 generator(2);
+    PostingList list;
+    std::map<int, uint32_t> expected;
+    auto insert = [](PostingList& list, std::map<int, uint32_t>& expected, int document_id, uint32_t count) {
+        list.Insert(document_id, count, PostingTermFreq(document_id, count));
+        expected[document_id] = count;
+    };
+    AssertPostingList(list, expected, true);
+    ASSERT(!list.Contains(0));
+
+    // appended postings fill a block up, then a posting in the middle splits it in halves
+    for (int i = 0; i < static_cast<int>(block_size); ++i) {
+        insert(list, expected, 2 * i, 1 + i % 5);
+    }
+    ASSERT_EQUAL(AssertPostingList(list, expected, true), std::vector<size_t>{block_size});
+    insert(list, expected, 101, 9);
+    ASSERT_EQUAL(AssertPostingList(list, expected, false), (std::vector<size_t>{block_size / 2, block_size / 2 + 1}));
+    // the count of a present posting is replaced
+    insert(list, expected, 101, 1);
+    ASSERT_EQUAL(AssertPostingList(list, expected, false), (std::vector<size_t>{block_size / 2, block_size / 2 + 1}));
+
+    // inserts into the middle of any block, full or not, and appends
+    for (int i = 0; i < 3 * static_cast<int>(block_size); ++i) {
+        insert(list, expected, 1'000 + 3 * i, 1 + i % 4);
+    }
+    for (int i = 0; i < 2'000; ++i) {
+        insert(list, expected, std::uniform_int_distribution(0, 2'500)(generator),
+                std::uniform_int_distribution(1, 20)(generator));
+        if (i % 250 == 0) {
+            AssertPostingList(list, expected, false);
+        }
+    }
+    const std::vector<size_t> block_sizes = AssertPostingList(list, expected, false);
+    ASSERT(block_sizes.size() > 10);
+
+    // Advance and GetBlockBound skip over whole blocks to any target, including past the end
+    std::vector<int> ids;
+    for (const auto& posting : expected) {
+        ids.push_back(posting.first);
+    }
+    auto get_block_last_id = [&](int target) {
+        const auto id_it = std::lower_bound(ids.begin(), ids.end(), target);
+        if (id_it == ids.end()) {
+            return std::numeric_limits<int>::max();
+        }
+        PostingList::Iterator it = list.begin();
+        while ((*it).document_id != *id_it) {
+            ++it;
+        }
+        return it.GetBlockBound(*id_it).last_id;
+    };
+    for (const int step : {1, 7, 130, 600}) {
+        PostingList::Iterator it = list.begin();
+        for (int target = -5; target < ids.back() + 2 * step; target += step) {
+            const auto id_it = std::lower_bound(ids.begin(), ids.end(), target);
+            const PostingList::BlockBound bound = it.GetBlockBound(target);
+            ASSERT_EQUAL_HINT(bound.last_id, get_block_last_id(target), std::to_string(target));
+            it.Advance(target);
+            ASSERT_EQUAL_HINT(it.AtEnd(), id_it == ids.end(), std::to_string(target));
+            if (id_it != ids.end()) {
+                ASSERT_EQUAL((*it).document_id, *id_it);
+            }
+        }
+    }
+    // advancing to the current posting stays on it
+    PostingList::Iterator advanced = list.begin();
+    advanced.Advance(ids[300]);
+    advanced.Advance(ids[300]);
+    ASSERT_EQUAL((*advanced).document_id, ids[300]);
+
+    // Appended postings give exact bounds, and an erase must keep them exact: a block bound
+    // left at the term frequency of an erased posting would be too high
+    PostingList appended;
+    std::map<int, uint32_t> appended_expected;
+    for (const auto& [document_id, count] : expected) {
+        insert(appended, appended_expected, document_id, count);
+    }
+    AssertPostingList(appended, appended_expected, true);
+    const PostingList copy = appended;
+    const std::map<int, uint32_t> copy_expected = appended_expected;
+    // the largest postings of the ids from first_id to last_id one by one, until the
+    // bound drops below the ties of the largest term frequency
+    auto erase_max_postings = [&](int first_id, int last_id, size_t erased_count) {
+        for (size_t i = 0; i < erased_count; ++i) {
+            const auto max_posting = std::max_element(appended_expected.lower_bound(first_id),
+                    appended_expected.upper_bound(last_id), [](const auto& lhs, const auto& rhs) {
+                return PostingTermFreq(lhs.first, lhs.second) < PostingTermFreq(rhs.first, rhs.second);
+            });
+            ASSERT(appended.Erase(max_posting->first, term_freq));
+            appended_expected.erase(max_posting);
+            AssertPostingList(appended, appended_expected, true);
+        }
+    };
+    const double old_max_term_freq = appended.GetMaxTermFreq();
+    erase_max_postings(std::numeric_limits<int>::min(), std::numeric_limits<int>::max(), 40);
+    ASSERT(appended.GetMaxTermFreq() < old_max_term_freq);
+    erase_max_postings(1'000, 1'100, 40);
+    ASSERT(!appended.Erase(-1, term_freq) && !appended.Erase(3'000, term_freq));
+    // erasing every posting of the first block removes the block
+    const std::vector<size_t> erased_block_sizes = AssertPostingList(appended, appended_expected, true);
+    for (size_t i = 0; i < erased_block_sizes.front(); ++i) {
+        ASSERT(appended.Erase(appended_expected.begin()->first, term_freq));
+        appended_expected.erase(appended_expected.begin());
+    }
+    ASSERT_EQUAL(AssertPostingList(appended, appended_expected, true).size(), erased_block_sizes.size() - 1);
+
+    // the batch erase drops whole blocks, thins out others and skips the absent ids
+    std::vector<int> erased_ids = {-3, 2'999, 3'000};
+    size_t present_count = 0;
+    for (const auto& [document_id, count] : appended_expected) {
+        if (document_id % 3 == 0 || (document_id >= 1'000 && document_id < 1'400)) {
+            erased_ids.push_back(document_id);
+            ++present_count;
+        }
+    }
+    std::sort(erased_ids.begin(), erased_ids.end());
+    ASSERT_EQUAL(appended.Erase(erased_ids, term_freq), present_count);
+    for (const int document_id : erased_ids) {
+        appended_expected.erase(document_id);
+    }
+    AssertPostingList(appended, appended_expected, true);
+    ASSERT_EQUAL(appended.Erase(erased_ids, term_freq), 0u);
+    // the copy taken before the erases kept its blocks
+    AssertPostingList(copy, copy_expected, true);
+
+    // Remap drops the ids mapped to -1, renumbers the rest, packs the blocks full and
+    // recomputes the bounds for the new ids, also of the list with inexact bounds
+    std::vector<int> new_ids(3'000, -1);
+    int next_id = 0;
+    for (int document_id = 0; document_id < static_cast<int>(new_ids.size()); ++document_id) {
+        if (document_id % 4 != 1) {
+            new_ids[document_id] = next_id++;
+        }
+    }
+    for (auto [remapped_list, remapped_expected] : {std::pair{list, expected}, std::pair{appended, appended_expected}}) {
+        std::map<int, uint32_t> remapped;
+        for (const auto& [document_id, count] : remapped_expected) {
+            if (new_ids[document_id] >= 0) {
+                remapped[new_ids[document_id]] = count;
+            }
+        }
+        remapped_list.Remap(new_ids, term_freq);
+        const std::vector<size_t> remapped_sizes = AssertPostingList(remapped_list, remapped, true);
+        for (size_t i = 0; i + 1 < remapped_sizes.size(); ++i) {
+            ASSERT_EQUAL(remapped_sizes[i], block_size);
+        }
+    }
+    // a list left empty by Remap takes new postings
+    list.Remap(std::vector<int>(3'000, -1), term_freq);
+    expected.clear();
+    AssertPostingList(list, expected, true);
+    insert(list, expected, 5, 2);
+    AssertPostingList(list, expected, true);
+    std::cerr << "TestPostingList - OK\n";
+}
+
+void TestScoreAccumulator() {
+    // one-byte stamps wrap every 255 queries, the search runs the same code with four-byte ones
+    BasicScoreAccumulator<uint8_t> accumulator;
+    std::mt19937 generator(3);
+    auto get_scores = [&accumulator]() {
+        std::map<int, double> scores;
+        accumulator.ForEach([&scores](int ordinal, double score) {
+            ASSERT(scores.emplace(ordinal, score).second);
+        });
+        return scores;
+    };
+
+    // ordinal 7 is stamped with the first epoch and not touched until the epoch comes back
+    // after the wrap, when a stale stamp would bring back its score
+    int ordinal_count = 50;
+    accumulator.Reset(ordinal_count);
+    accumulator.Add(7, 100.0);
+    ASSERT(get_scores() == (std::map<int, double>{{7, 100.0}}));
+    for (int query = 1; query < 3 * 256; ++query) {
+        // new slots come in with a stamp of no epoch
+        if (query % 100 == 0) {
+            ordinal_count += 10;
+        }
+        accumulator.Reset(ordinal_count);
+        ASSERT_HINT(get_scores().empty(), std::to_string(query));
+        std::map<int, double> expected;
+        if (query % 255 == 0) {
+            accumulator.Add(7, 2.0);
+            expected[7] = 2.0;
+        }
+        // few slots per query, so most keep the stamp of an old epoch
+        const int add_count = std::uniform_int_distribution(0, 6)(generator);
+        for (int i = 0; i < add_count; ++i) {
+            const int ordinal = std::uniform_int_distribution(8, ordinal_count - 1)(generator);
+            const double score = std::uniform_int_distribution(1, 9)(generator);
+            accumulator.Add(ordinal, score);
+            expected[ordinal] += score;
+        }
+        if (!expected.empty() && query % 3 == 0) {
+            accumulator.Exclude(expected.rbegin()->first);
+            expected.erase(std::prev(expected.end()));
+        }
+        ASSERT_HINT(get_scores() == expected, std::to_string(query));
+    }
+    std::cerr << "TestScoreAccumulator - OK\n";
+}
+
+void TestForwardIndexMove() {
+    auto add_document = [](ForwardIndex& index, TermId first_term_id, size_t entry_count) {
+        ForwardIndex::Entry* entries = index.Add(entry_count);
+        for (size_t i = 0; i < entry_count; ++i) {
+            entries[i] = {first_term_id + static_cast<TermId>(i), 0, 1.0 / entry_count};
+        }
+    };
+    auto assert_document = [](const ForwardIndex& index, int ordinal, TermId first_term_id, size_t entry_count) {
+        ASSERT_EQUAL(index.GetEntryCount(ordinal), entry_count);
+        for (size_t i = 0; i < entry_count; ++i) {
+            ASSERT_EQUAL(index.GetEntries(ordinal)[i].term_id, first_term_id + static_cast<TermId>(i));
+        }
+    };
+    // the source chunk has room left, so a stale chunk pointer would be written through
+    ForwardIndex source;
+    add_document(source, 100, 10);
+    ForwardIndex moved(std::move(source));
+    ForwardIndex assigned;
+    add_document(assigned, 500, 3);
+    assigned = std::move(moved);
+    for (ForwardIndex* moved_from : {&source, &moved}) {
+        ASSERT_EQUAL(moved_from->GetOrdinalCount(), 0u);
+        add_document(*moved_from, 200, 10);
+        ASSERT_EQUAL(moved_from->GetOrdinalCount(), 1u);
+        assert_document(*moved_from, 0, 200, 10);
+    }
+    ASSERT_EQUAL(assigned.GetOrdinalCount(), 1u);
+    assert_document(assigned, 0, 100, 10);
+    add_document(assigned, 300, 5);
+    assert_document(assigned, 0, 100, 10);
+    assert_document(assigned, 1, 300, 5);
+    assert_document(source, 0, 200, 10);
+    assert_document(moved, 0, 200, 10);
+    std::cerr << "TestForwardIndexMove - OK\n";
+}
+
+void AssertSameIndex(const SearchServer& expected, const SearchServer& actual, const std::vector<std::string>& queries) {
+    ASSERT_EQUAL(actual.GetDocumentCount(), expected.GetDocumentCount());
+    ASSERT(std::equal(actual.begin(), actual.end(), expected.begin(), expected.end()));
+    for (const int document_id : expected) {
+        const WordFrequencies expected_frequencies = expected.GetWordFrequencies(document_id);
+        const WordFrequencies actual_frequencies = actual.GetWordFrequencies(document_id);
+        ASSERT_HINT(std::equal(actual_frequencies.begin(), actual_frequencies.end(),
+                expected_frequencies.begin(), expected_frequencies.end()), std::to_string(document_id));
+    }
+    for (const std::string& query : queries) {
+        ASSERT_EQUAL_HINT(actual.FindTopDocuments(query), expected.FindTopDocuments(query), query);
+        ASSERT_EQUAL_HINT(actual.FindTopDocuments(query, DocumentStatus::BANNED, 20),
+                expected.FindTopDocuments(query, DocumentStatus::BANNED, 20), query);
+        for (auto it = expected.begin(); it != expected.end(); ++it) {
+            ASSERT_EQUAL_HINT(actual.MatchDocument(query, *it), expected.MatchDocument(query, *it), query);
+            // every 50th document is enough to catch a damaged posting list
+            for (int i = 0; i < 49 && it != expected.end(); ++i) {
+                ++it;
+            }
+            if (it == expected.end()) {
+                break;
+            }
+        }
+    }
+}
+
+void TestStopWordSet() {
+    using namespace std::string_view_literals;
+
+    constexpr StaticStopWordSet STOP_WORDS({"and"sv, "in"sv, "at"sv, "with"sv, "the"sv, "of"sv});
+    static_assert(STOP_WORDS.size() == 6);
+    static_assert(STOP_WORDS.Contains("and"sv) && STOP_WORDS.Contains("with"sv) && STOP_WORDS.Contains("of"sv));
+    static_assert(!STOP_WORDS.Contains("an"sv) && !STOP_WORDS.Contains("within"sv) && !STOP_WORDS.Contains(""sv));
+
+    // the table built by the compiler gives the same index as the stop words in a string
+    std::mt19937 generator(18);
+    std::vector<std::string> dictionary = GenerateDictionary(generator, 200, 6);
+    dictionary.insert(dictionary.end(), {"and"s, "in"s, "at"s, "with"s, "the"s, "of"s});
+    const std::vector<std::string> documents = GenerateQueries(generator, dictionary, 300, 15);
+    SearchServer static_server(STOP_WORDS);
+    SearchServer string_server("the of and in at with"s);
+    for (int document_id = 0; document_id < static_cast<int>(documents.size()); ++document_id) {
+        static_server.AddDocument(document_id, documents[document_id], DocumentStatus::ACTUAL, {document_id % 7});
+        string_server.AddDocument(document_id, documents[document_id], DocumentStatus::ACTUAL, {document_id % 7});
+    }
+    std::vector<std::string> queries = GenerateQueries(generator, dictionary, 100, 5);
+    queries.insert(queries.end(), {"and the"s, "-with "s + dictionary[0], "of "s + dictionary[1] + " -at"s});
+    AssertSameIndex(string_server, static_server, queries);
+    ASSERT(static_server.FindTopDocuments("and the"s).empty());
+
+    // the copy of the compile time table finds the same words and iterates in sorted order
+    const StopWordSet copied(STOP_WORDS);
+    const std::vector<std::string> sorted_words = {"and"s, "at"s, "in"s, "of"s, "the"s, "with"s};
+    ASSERT(std::equal(copied.begin(), copied.end(), sorted_words.begin(), sorted_words.end()));
+    for (const std::string& word : sorted_words) {
+        ASSERT_HINT(copied.Contains(word), word);
+    }
+    ASSERT(!copied.Contains("a"sv) && !copied.Contains("andd"sv) && !copied.Contains("th"sv));
+
+    ASSERT_EQUAL(StopWordSet().size(), 0u);
+    ASSERT(!StopWordSet().Contains("a"sv) && !StopWordSet().Contains(""sv));
+    // empty words are skipped and repeated ones are kept once
+    const StopWordSet deduplicated(std::vector<std::string>{"b"s, ""s, "a"s, "b"s});
+    ASSERT_EQUAL(std::vector<std::string>(deduplicated.begin(), deduplicated.end()), (std::vector<std::string>{"a"s, "b"s}));
+    ASSERT(!deduplicated.Contains(""sv));
+
+    for (const int word_count : {1, 2, 3, 7, 64, 1000}) {
+        const std::vector<std::string> words = GenerateDictionary(generator, word_count, 6);
+        const std::set<std::string, std::less<>> expected(words.begin(), words.end());
+        const StopWordSet stop_words(words);
+        ASSERT_EQUAL(stop_words.size(), words.size());
+        ASSERT(std::equal(stop_words.begin(), stop_words.end(), words.begin(), words.end()));
+
+        // a lookup first goes to the bucket of the word, the buckets holding several words
+        // and the misses landing in the bucket of a stop word are the cases to check
+        const uint64_t bucket_mask = GetStopWordBucketCount(words.size()) - 1;
+        std::vector<size_t> bucket_sizes(bucket_mask + 1);
+        for (const std::string& word : words) {
+            ASSERT_HINT(stop_words.Contains(word), word);
+            ++bucket_sizes[HashStopWord(word) & bucket_mask];
+        }
+        size_t bucket_misses = 0;
+        for (int i = 0; i < 5000; ++i) {
+            const std::string word = GenerateWord(generator, 7);
+            ASSERT_EQUAL_HINT(stop_words.Contains(word), expected.count(word) > 0, word);
+            bucket_misses += expected.count(word) == 0 && bucket_sizes[HashStopWord(word) & bucket_mask] > 0;
+        }
+        for (const std::string& word : words) {
+            for (const std::string& near_word : {word + "a"s, word.substr(1)}) {
+                ASSERT_EQUAL_HINT(stop_words.Contains(near_word), expected.count(near_word) > 0, near_word);
+            }
+        }
+        ASSERT(bucket_misses > 0);
+        if (word_count >= 64) {
+            ASSERT(*std::max_element(bucket_sizes.begin(), bucket_sizes.end()) > 1);
+        }
+    }
+    std::cerr << "TestStopWordSet - OK\n";
+}
+
+void TestRemoveDocuments() {
+    std::mt19937 generator(15);
+    const auto dictionary = GenerateDictionary(generator, 2'000, 8);
+    const auto documents = GenerateQueries(generator, dictionary, 3'000, 20);
+    const auto queries = GenerateQueries(generator, dictionary, 100, 4);
+    const int base_count = 2'500;
+    auto add_document = [&documents](SearchServer& server, int document_id) {
+        const DocumentStatus status = document_id % 4 == 0 ? DocumentStatus::BANNED : DocumentStatus::ACTUAL;
+        server.AddDocument(document_id, documents[document_id], status, {document_id % 7});
+    };
+    SearchServer base_server(dictionary[0]);
+    for (int document_id = 0; document_id < base_count; ++document_id) {
+        add_document(base_server, document_id);
+    }
+
+    // a batch removal with the seq and par policies leaves the index of a loop of single removals
+    // and of a server never holding the removed documents, which has no ordinals to compact.
+    // The documents added afterwards get the ordinals following the removal
+    auto assert_same_removal = [&](std::vector<int> removed_ids) {
+        SearchServer fresh_server(dictionary[0]);
+        const std::set<int> removed_set(removed_ids.begin(), removed_ids.end());
+        for (int document_id = 0; document_id < base_count; ++document_id) {
+            if (removed_set.count(document_id) == 0) {
+                add_document(fresh_server, document_id);
+            }
+        }
+        removed_ids.insert(removed_ids.end(), {-1, base_count, 100'000, removed_ids.front(), removed_ids.back()});
+        std::shuffle(removed_ids.begin(), removed_ids.end(), generator);
+        SearchServer loop_server = base_server;
+        for (const int document_id : removed_ids) {
+            loop_server.RemoveDocument(document_id);
+        }
+        SearchServer seq_server = base_server;
+        seq_server.RemoveDocuments(std::execution::seq, removed_ids);
+        SearchServer par_server = base_server;
+        par_server.RemoveDocuments(std::execution::par, removed_ids);
+        for (const SearchServer* server : {&loop_server, &seq_server, &par_server}) {
+            AssertSameIndex(fresh_server, *server, queries);
+        }
+        for (int document_id = base_count; document_id < static_cast<int>(documents.size()); ++document_id) {
+            for (SearchServer* server : {&fresh_server, &loop_server, &seq_server, &par_server}) {
+                add_document(*server, document_id);
+            }
+        }
+        for (const SearchServer* server : {&loop_server, &seq_server, &par_server}) {
+            AssertSameIndex(fresh_server, *server, queries);
+        }
+    };
+
+    // fewer removed ordinals than COMPACTION_MIN_REMOVED_ORDINALS, nothing is compacted
+    std::vector<int> removed_ids;
+    for (int document_id = 0; document_id < base_count; document_id += 7) {
+        removed_ids.push_back(document_id);
+    }
+    assert_same_removal(removed_ids);
+
+    // 2000 removed ordinals against 500 stored documents: the batch compacts the ordinals
+    // inside the same call, the loop of single removals does it in the middle
+    removed_ids.clear();
+    for (int document_id = 0; document_id < base_count; ++document_id) {
+        if (document_id % 5 != 0) {
+            removed_ids.push_back(document_id);
+        }
+    }
+    assert_same_removal(removed_ids);
+
+    // every document is removed and compacted
+    removed_ids.resize(base_count);
+    std::iota(removed_ids.begin(), removed_ids.end(), 0);
+    assert_same_removal(removed_ids);
+    std::cerr << "TestRemoveDocuments - OK\n";
+}
+
+std::string ReadFile(const std::string& path) {
+    std::ifstream input(path, std::ios::binary);
+    return {std::istreambuf_iterator<char>(input), std::istreambuf_iterator<char>()};
+}
+
+void WriteFile(const std::string& path, const std::string& data) {
+    std::ofstream output(path, std::ios::binary | std::ios::trunc);
+    output.write(data.data(), data.size());
+}
+
+// True if LoadIndex throws std::runtime_error for the file
+bool IsLoadRejected(const std::string& path, bool verify_checksum) {
+    try {
+        SearchServer::LoadIndex(path, verify_checksum);
+    } catch (const std::runtime_error&) {
+        return true;
+    }
+    return false;
+}
+
+// The relevance of a document found by a single word is TF * IDF, and the IDF must be
+// log(document count / documents with the word) computed from the index as it is now
+void AssertInverseDocumentFreqs(const SearchServer& search_server, const std::vector<std::string>& words) {
+    const int document_count = search_server.GetDocumentCount();
+    std::map<std::string_view, std::map<int, double>> word_to_document_freqs;
+    for (const int document_id : search_server) {
+        for (const auto& [word, term_freq] : search_server.GetWordFrequencies(document_id)) {
+            word_to_document_freqs[word][document_id] = term_freq;
+        }
+    }
+    for (const std::string& word : words) {
+        const std::vector<Document> documents = search_server.FindTopDocuments(word, DocumentStatus::ACTUAL, document_count);
+        const auto it = word_to_document_freqs.find(word);
+        if (it == word_to_document_freqs.end()) {
+            ASSERT_HINT(documents.empty(), word);
+            continue;
+        }
+        ASSERT_EQUAL_HINT(documents.size(), it->second.size(), word);
+        const double inverse_document_freq = std::log(static_cast<double>(document_count) / it->second.size());
+        for (const Document& document : documents) {
+            const double expected_relevance = it->second.at(document.id) * inverse_document_freq;
+            ASSERT_HINT(std::abs(document.relevance - expected_relevance) <= 1e-12 * std::max(1.0, expected_relevance),
+                    word + " "s + std::to_string(document.id));
+        }
+    }
+}
+
+void TestInverseDocumentFreq() {
+    std::mt19937 generator(9);
+    const auto dictionary = GenerateDictionary(generator, 300, 6);
+    const auto documents = GenerateQueries(generator, dictionary, 1'800, 10);
+    const std::vector<std::string> words(dictionary.begin() + 1, dictionary.end());
+    SearchServer search_server(dictionary[0]);
+    for (int document_id = 0; document_id < 1'000; ++document_id) {
+        search_server.AddDocument(document_id, documents[document_id], DocumentStatus::ACTUAL, {1});
+    }
+    std::vector<RawDocument> raw_documents;
+    for (int document_id = 1'000; document_id < 1'500; ++document_id) {
+        raw_documents.push_back({document_id, documents[document_id], DocumentStatus::ACTUAL, {1}});
+    }
+    search_server.AddDocuments(std::execution::par, raw_documents);
+    AssertInverseDocumentFreqs(search_server, words);
+
+    for (int document_id = 0; document_id < 300; document_id += 3) {
+        search_server.RemoveDocument(document_id);
+        search_server.RemoveDocument(std::execution::par, document_id + 1);
+    }
+    AssertInverseDocumentFreqs(search_server, words);
+    std::vector<int> removed_ids;
+    for (int document_id = 300; document_id < 1'500; document_id += 5) {
+        removed_ids.push_back(document_id);
+    }
+    search_server.RemoveDocuments(std::execution::par, removed_ids);
+    AssertInverseDocumentFreqs(search_server, words);
+
+    // more than half of the ordinals are removed, at least 1024 of them, so they are compacted
+    removed_ids.clear();
+    for (int document_id = 0; document_id < 1'300; ++document_id) {
+        removed_ids.push_back(document_id);
+    }
+    search_server.RemoveDocuments(removed_ids);
+    AssertInverseDocumentFreqs(search_server, words);
+    for (int document_id = 1'500; document_id < 1'800; ++document_id) {
+        search_server.AddDocument(document_id, documents[document_id], DocumentStatus::ACTUAL, {1});
+    }
+    AssertInverseDocumentFreqs(search_server, words);
+
+    // the logarithms loaded from a snapshot, then updated by the changes after the load
+    const std::string path = (std::filesystem::temp_directory_path() / "search_server_idf_test.index").string();
+    search_server.SaveIndex(path);
+    for (const bool verify_checksum : {true, false}) {
+        SearchServer loaded_server = SearchServer::LoadIndex(path, verify_checksum);
+        AssertInverseDocumentFreqs(loaded_server, words);
+        for (int document_id = 1'300; document_id < 1'800; document_id += 4) {
+            loaded_server.RemoveDocument(document_id);
+        }
+        loaded_server.AddDocument(2'000, dictionary[1] + " "s + dictionary[2], DocumentStatus::ACTUAL, {1});
+        AssertInverseDocumentFreqs(loaded_server, words);
+    }
+    std::filesystem::remove(path);
+    std::cerr << "TestInverseDocumentFreq - OK\n";
+}
+
+void TestSaveLoadIndex() {
+    std::mt19937 generator(5);
+    const auto dictionary = GenerateDictionary(generator, 2000, 10);
+    const auto documents = GenerateQueries(generator, dictionary, 3'000, 40);
+    const auto queries = GenerateQueries(generator, dictionary, 30, 8);
+    SearchServer search_server(dictionary[0]);
+    for (size_t i = 0; i < documents.size(); ++i) {
+        search_server.AddDocument(i, documents[i], static_cast<DocumentStatus>(i % 4), {static_cast<int>(i % 9)});
+    }
+    // removed documents leave their ordinals behind in the snapshot
+    for (int document_id = 0; document_id < 300; document_id += 2) {
+        search_server.RemoveDocument(document_id);
+    }
+    const std::string path = (std::filesystem::temp_directory_path() / "search_server_test.index").string();
+    search_server.SaveIndex(path);
+
+    for (const bool verify_checksum : {true, false}) {
+        SearchServer loaded_server = SearchServer::LoadIndex(path, verify_checksum);
+        AssertSameIndex(search_server, loaded_server, queries);
+
+        // new documents mix new terms with the ones of the mapped dictionary and postings
+        SearchServer expected_server = search_server;
+        for (int i = 0; i < 200; ++i) {
+            const int document_id = static_cast<int>(documents.size()) + i;
+            const std::string text = GenerateQuery(generator, dictionary, 20) + " newword"s + std::to_string(i % 10);
+            expected_server.AddDocument(document_id, text, DocumentStatus::ACTUAL, {i});
+            loaded_server.AddDocument(document_id, text, DocumentStatus::ACTUAL, {i});
+        }
+        for (int document_id = 1; document_id < 3'000; document_id += 7) {
+            expected_server.RemoveDocument(document_id);
+            loaded_server.RemoveDocument(document_id);
+        }
+        std::vector<std::string> new_queries = queries;
+        new_queries.push_back("newword1 newword2 -newword3"s);
+        AssertSameIndex(expected_server, loaded_server, new_queries);
+    }
+
+    const std::string snapshot = ReadFile(path);
+    WriteFile(path, snapshot.substr(0, snapshot.size() / 2));
+    ASSERT_HINT(IsLoadRejected(path, true) && IsLoadRejected(path, false), "truncated snapshot"s);
+    std::string corrupted = snapshot;
+    corrupted[corrupted.size() / 2] ^= 0x5a;
+    WriteFile(path, corrupted);
+    ASSERT_HINT(IsLoadRejected(path, true), "corrupted snapshot"s);
+    corrupted = snapshot;
+    corrupted[0] ^= 0x5a;
+    WriteFile(path, corrupted);
+    ASSERT_HINT(IsLoadRejected(path, true) && IsLoadRejected(path, false), "corrupted header"s);
+    // a posting block beyond the ordinals is rejected without the checksum as well: the
+    // postings section starts with the count of the lists, the lists of four 8-byte fields
+    // and the count of the blocks, last_id is the second field of a block
+    SnapshotHeader header;
+    std::memcpy(&header, snapshot.data(), sizeof(header));
+    const size_t postings_offset = header.sections[static_cast<size_t>(SnapshotSection::POSTINGS)].offset;
+    uint64_t list_count = 0;
+    std::memcpy(&list_count, snapshot.data() + postings_offset, sizeof(list_count));
+    const int32_t out_of_range_id = 1 << 30;
+    corrupted = snapshot;
+    std::memcpy(&corrupted[postings_offset + 8 + list_count * 32 + 8 + 4], &out_of_range_id, sizeof(out_of_range_id));
+    WriteFile(path, corrupted);
+    ASSERT_HINT(IsLoadRejected(path, true) && IsLoadRejected(path, false), "posting ordinal out of range"s);
+    std::filesystem::remove(path);
+    std::cerr << "TestSaveLoadIndex - OK\n";
+}
+
+// A mutation as the log records it, a batch call records one per document
+struct LoggedMutation {
+    MutationType type;
+    int document_id;
+    std::string text;
+};
+
+void ApplyMutations(SearchServer& search_server, const std::vector<LoggedMutation>& mutations, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        if (mutations[i].type == MutationType::ADD) {
+            search_server.AddDocument(mutations[i].document_id, mutations[i].text, DocumentStatus::ACTUAL, {mutations[i].document_id % 7});
+        } else {
+            search_server.RemoveDocument(mutations[i].document_id);
+        }
+    }
+}
+
+void TestMutationLog() {
+    std::mt19937 generator(7);
+    const auto dictionary = GenerateDictionary(generator, 500, 10);
+    const auto documents = GenerateQueries(generator, dictionary, 900, 30);
+    const auto queries = GenerateQueries(generator, dictionary, 30, 6);
+    const std::filesystem::path directory = std::filesystem::temp_directory_path();
+    const std::string snapshot_path = (directory / "search_server_test_log.index").string();
+    const std::string log_path = (directory / "search_server_test.log").string();
+    const std::string crash_path = (directory / "search_server_test_crash.log").string();
+    std::filesystem::remove(log_path);
+
+    const int base_count = 300;
+    auto make_base_server = [&]() {
+        SearchServer search_server(dictionary[0]);
+        for (int document_id = 0; document_id < base_count; ++document_id) {
+            search_server.AddDocument(document_id, documents[document_id], DocumentStatus::ACTUAL, {document_id % 7});
+        }
+        return search_server;
+    };
+    SearchServer search_server = make_base_server();
+    const auto log = std::make_shared<MutationLog>(log_path);
+    ASSERT_EQUAL(search_server.AttachMutationLog(log), 0u);
+    const size_t header_size = ReadFile(log_path).size();
+    search_server.Checkpoint(snapshot_path);
+
+    // single and batch calls, the batch removal is logged in the order of ids
+    std::vector<LoggedMutation> mutations;
+    for (int document_id = base_count; document_id < 400; ++document_id) {
+        mutations.push_back({MutationType::ADD, document_id, documents[document_id]});
+    }
+    for (int document_id = 0; document_id < 400; document_id += 5) {
+        mutations.push_back({MutationType::REMOVE, document_id, {}});
+    }
+    const size_t batch_begin = mutations.size();
+    for (int document_id = 400; document_id < 600; ++document_id) {
+        mutations.push_back({MutationType::ADD, document_id, documents[document_id]});
+    }
+    const size_t batch_removal_begin = mutations.size();
+    for (int document_id = 1; document_id < 600; document_id += 3) {
+        if (document_id % 5 != 0) {
+            mutations.push_back({MutationType::REMOVE, document_id, {}});
+        }
+    }
+    ApplyMutations(search_server, mutations, batch_begin);
+    std::vector<RawDocument> raw_documents;
+    for (size_t i = batch_begin; i < batch_removal_begin; ++i) {
+        raw_documents.push_back({mutations[i].document_id, mutations[i].text, DocumentStatus::ACTUAL, {mutations[i].document_id % 7}});
+    }
+    search_server.AddDocuments(std::execution::par, raw_documents);
+    // duplicates and absent ids write no records
+    std::vector<int> removed_ids = {100'000, 1, 1};
+    for (size_t i = batch_removal_begin; i < mutations.size(); ++i) {
+        removed_ids.push_back(mutations[i].document_id);
+    }
+    std::shuffle(removed_ids.begin(), removed_ids.end(), generator);
+    search_server.RemoveDocuments(std::execution::par, removed_ids);
+
+    // a rejected mutation writes no record
+    try {
+        search_server.AddDocument(2, "present id"s, DocumentStatus::ACTUAL, {1});
+        ASSERT_HINT(false, "present id accepted"s);
+    } catch (const std::invalid_argument&) {
+    }
+
+    // a crash after a sync: the whole log is replayed
+    log->Sync();
+    const std::string log_data = ReadFile(log_path);
+    WriteFile(crash_path, log_data);
+    {
+        SearchServer loaded_server = SearchServer::LoadIndex(snapshot_path);
+        ASSERT_EQUAL(loaded_server.AttachMutationLog(std::make_shared<MutationLog>(crash_path)), mutations.size());
+        AssertSameIndex(search_server, loaded_server, queries);
+    }
+
+    // a crash in the middle of an append: the torn record is dropped, the ones before it are replayed
+    std::uniform_int_distribution<size_t> cut_distribution(1, log_data.size() - 1);
+    std::vector<size_t> cuts = {log_data.size() - 1};
+    for (int i = 0; i < 6; ++i) {
+        cuts.push_back(cut_distribution(generator));
+    }
+    for (const size_t cut : cuts) {
+        WriteFile(crash_path, log_data.substr(0, cut));
+        SearchServer loaded_server = SearchServer::LoadIndex(snapshot_path);
+        std::shared_ptr<MutationLog> crash_log;
+        size_t replayed_count;
+        try {
+            crash_log = std::make_shared<MutationLog>(crash_path);
+            replayed_count = loaded_server.AttachMutationLog(crash_log);
+        } catch (const std::runtime_error&) {
+            // only a torn header is not a log
+            ASSERT(cut < header_size);
+            continue;
+        }
+        ASSERT(replayed_count < mutations.size());
+        SearchServer expected_server = make_base_server();
+        ApplyMutations(expected_server, mutations, replayed_count);
+        AssertSameIndex(expected_server, loaded_server, queries);
+
+        // the torn tail is cut off, so a record appended after it is replayed too
+        loaded_server.AddDocument(800, documents[800], DocumentStatus::ACTUAL, {1});
+        crash_log->Sync();
+        expected_server.AddDocument(800, documents[800], DocumentStatus::ACTUAL, {1});
+        SearchServer reloaded_server = SearchServer::LoadIndex(snapshot_path);
+        ASSERT_EQUAL(reloaded_server.AttachMutationLog(std::make_shared<MutationLog>(crash_path)), replayed_count + 1);
+        AssertSameIndex(expected_server, reloaded_server, queries);
+    }
+
+    // Checkpoint drops the saved records, the next ones continue the numbering
+    WriteFile(crash_path, ReadFile(snapshot_path));
+    search_server.Checkpoint(snapshot_path);
+    search_server.AddDocument(801, documents[801], DocumentStatus::ACTUAL, {1});
+    log->Sync();
+    WriteFile(crash_path + ".log"s, ReadFile(log_path));
+    {
+        SearchServer loaded_server = SearchServer::LoadIndex(snapshot_path);
+        ASSERT_EQUAL(loaded_server.AttachMutationLog(std::make_shared<MutationLog>(crash_path + ".log"s)), 1u);
+        AssertSameIndex(search_server, loaded_server, queries);
+        // the snapshot before the checkpoint misses the dropped records
+        SearchServer stale_server = SearchServer::LoadIndex(crash_path);
+        try {
+            stale_server.AttachMutationLog(std::make_shared<MutationLog>(crash_path + ".log"s));
+            ASSERT_HINT(false, "stale snapshot accepted"s);
+        } catch (const std::runtime_error&) {
+        }
+    }
+#if defined(__linux__)
+    // a write failing in the middle of a batch: the part of the batch which reached
+    // the disk is dropped on replay, as the server never applied the batch
+    {
+        const std::string failing_path = (directory / "search_server_test_failing.log").string();
+        std::filesystem::remove(failing_path);
+        SearchServer live_server = make_base_server();
+        const auto failing_log = std::make_shared<MutationLog>(failing_path);
+        live_server.AttachMutationLog(failing_log);
+        live_server.AddDocument(base_count, documents[base_count], DocumentStatus::ACTUAL, {1});
+        live_server.RemoveDocuments({0, 1, 2});
+        failing_log->Sync();
+        const uint64_t synced_size = std::filesystem::file_size(failing_path);
+        std::vector<RawDocument> batch;
+        for (int document_id = 400; document_id < 600; ++document_id) {
+            batch.push_back({document_id, documents[document_id], DocumentStatus::ACTUAL, {1}});
+        }
+        // writes past the limit fail with EFBIG instead of raising SIGXFSZ
+        rlimit saved_limit;
+        getrlimit(RLIMIT_FSIZE, &saved_limit);
+        rlimit limit = saved_limit;
+        limit.rlim_cur = synced_size + 1'000;
+        const auto saved_handler = std::signal(SIGXFSZ, SIG_IGN);
+        setrlimit(RLIMIT_FSIZE, &limit);
+        bool is_rejected = false;
+        try {
+            live_server.AddDocuments(batch);
+        } catch (const std::runtime_error&) {
+            is_rejected = true;
+        }
+        setrlimit(RLIMIT_FSIZE, &saved_limit);
+        std::signal(SIGXFSZ, saved_handler);
+        ASSERT(is_rejected);
+        ASSERT(std::filesystem::file_size(failing_path) > synced_size);
+        ASSERT_EQUAL(live_server.GetDocumentCount(), base_count + 1 - 3);
+        SearchServer replayed_server = make_base_server();
+        ASSERT_EQUAL(replayed_server.AttachMutationLog(std::make_shared<MutationLog>(failing_path)), 4u);
+        AssertSameIndex(live_server, replayed_server, queries);
+        std::filesystem::remove(failing_path);
+    }
+#endif
+
+    for (const std::string& path : {snapshot_path, log_path, crash_path, crash_path + ".log"s}) {
+        std::filesystem::remove(path);
+    }
+    std::cerr << "TestMutationLog - OK\n";
+}
+
+void TestConcurrentSearchServer() {
+    std::mt19937 generator(11);
+    const auto dictionary = GenerateDictionary(generator, 300, 8);
+    const auto documents = GenerateQueries(generator, dictionary, 1'500, 20);
+    const auto queries = GenerateQueries(generator, dictionary, 20, 3);
+    const int initial_count = 500;
+    const int version_count = 20;
+    SearchServer search_server(dictionary[0]);
+    for (int document_id = 0; document_id < initial_count; ++document_id) {
+        search_server.AddDocument(document_id, documents[document_id], DocumentStatus::ACTUAL, {document_id % 5});
+    }
+    // version v adds 50 documents and removes 20 of the older ones
+    auto mutate = [&documents](auto& server, int version) {
+        for (int document_id = initial_count + version * 50; document_id < initial_count + (version + 1) * 50; ++document_id) {
+            server.AddDocument(document_id, documents[document_id], DocumentStatus::ACTUAL, {document_id % 5});
+        }
+        for (int document_id = version * 40; document_id < (version + 1) * 40; document_id += 2) {
+            server.RemoveDocument(document_id);
+        }
+    };
+    // what a reader may see: the document count and the results of all queries in one version
+    struct VersionResults {
+        int document_count;
+        std::vector<std::vector<Document>> results;
+
+        bool operator==(const VersionResults& other) const {
+            return document_count == other.document_count && results == other.results;
+        }
+    };
+    auto read_version = [&queries](const SearchServer& server) {
+        VersionResults version_results{server.GetDocumentCount(), {}};
+        for (const std::string& query : queries) {
+            version_results.results.push_back(server.FindTopDocuments(query));
+        }
+        return version_results;
+    };
+    std::vector<VersionResults> expected;
+    {
+        SearchServer expected_server = search_server;
+        expected.push_back(read_version(expected_server));
+        for (int version = 0; version < version_count; ++version) {
+            mutate(expected_server, version);
+            expected.push_back(read_version(expected_server));
+        }
+    }
+
+    ConcurrentSearchServer concurrent_server(search_server);
+    std::atomic<bool> is_done{false};
+    std::atomic<int> unpublished_reads{0};
+    std::atomic<int> read_count{0};
+    std::vector<std::thread> readers;
+    for (int reader = 0; reader < 3; ++reader) {
+        readers.emplace_back([&]() {
+            // versions are published in order, so a reader never goes back
+            size_t last_version = 0;
+            while (!is_done.load()) {
+                const VersionResults actual = concurrent_server.Read(read_version);
+                const auto it = std::find(expected.begin() + last_version, expected.end(), actual);
+                if (it == expected.end()) {
+                    ++unpublished_reads;
+                } else {
+                    last_version = it - expected.begin();
+                }
+                ++read_count;
+            }
+        });
+    }
+    for (int version = 0; version < version_count; ++version) {
+        mutate(concurrent_server, version);
+        concurrent_server.Publish();
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    is_done = true;
+    for (std::thread& reader : readers) {
+        reader.join();
+    }
+    ASSERT_EQUAL(unpublished_reads.load(), 0);
+    ASSERT(read_count.load() > 0);
+    ASSERT(concurrent_server.Read(read_version) == expected.back());
+    std::cerr << "TestConcurrentSearchServer - OK\n";
+}
+
+void TestQueryResultCache() {
+    std::mt19937 generator(13);
+    const auto dictionary = GenerateDictionary(generator, 200, 8);
+    const auto documents = GenerateQueries(generator, dictionary, 400, 20);
+    SearchServer expected_server(dictionary[0]);
+    for (int document_id = 0; document_id < 300; ++document_id) {
+        expected_server.AddDocument(document_id, documents[document_id], DocumentStatus::ACTUAL, {document_id % 5});
+    }
+    SearchServer search_server = expected_server;
+    auto cache = std::make_shared<QueryResultCache>(64, 1);
+    search_server.AttachResultCache(cache);
+    const std::vector<std::string> queries = {
+        dictionary[1] + " "s + dictionary[2],
+        dictionary[3] + " -"s + dictionary[4],
+        dictionary[5],
+    };
+    auto assert_same_results = [&]() {
+        for (const std::string& query : queries) {
+            ASSERT_EQUAL(search_server.FindTopDocuments(query), expected_server.FindTopDocuments(query));
+        }
+    };
+
+    assert_same_results();
+    ASSERT_EQUAL(cache->GetStats().misses, queries.size());
+    ASSERT_EQUAL(cache->GetStats().hits, 0u);
+    assert_same_results();
+    ASSERT_EQUAL(cache->GetStats().hits, queries.size());
+    // the key is made of the parsed words, so the word order and repeats don't matter
+    ASSERT_EQUAL(search_server.FindTopDocuments(dictionary[2] + " "s + dictionary[1] + " "s + dictionary[2]),
+            expected_server.FindTopDocuments(queries[0]));
+    ASSERT_EQUAL(cache->GetStats().hits, queries.size() + 1);
+    // the prepared query shares the key of the raw one
+    ASSERT_EQUAL(search_server.FindTopDocuments(search_server.Prepare(queries[1])), expected_server.FindTopDocuments(queries[1]));
+    ASSERT_EQUAL(cache->GetStats().hits, queries.size() + 2);
+    // a different status or page is another entry
+    search_server.FindTopDocuments(queries[0], DocumentStatus::BANNED);
+    search_server.FindTopDocuments(queries[0], DocumentStatus::ACTUAL, 2);
+    ASSERT_EQUAL(cache->GetStats().misses, queries.size() + 2);
+
+    // every change of the index makes the cached results stale
+    for (int document_id = 300; document_id < 400; ++document_id) {
+        expected_server.AddDocument(document_id, documents[document_id], DocumentStatus::ACTUAL, {document_id % 5});
+        search_server.AddDocument(document_id, documents[document_id], DocumentStatus::ACTUAL, {document_id % 5});
+    }
+    uint64_t misses = cache->GetStats().misses;
+    assert_same_results();
+    ASSERT_EQUAL(cache->GetStats().misses, misses + queries.size());
+    for (int document_id = 0; document_id < 400; document_id += 3) {
+        expected_server.RemoveDocument(document_id);
+        search_server.RemoveDocument(document_id);
+    }
+    misses = cache->GetStats().misses;
+    assert_same_results();
+    ASSERT_EQUAL(cache->GetStats().misses, misses + queries.size());
+    assert_same_results();
+    ASSERT_EQUAL(cache->GetStats().misses, misses + queries.size());
+
+    // the least recently used entry is evicted first
+    auto small_cache = std::make_shared<QueryResultCache>(2, 1);
+    search_server.AttachResultCache(small_cache);
+    search_server.FindTopDocuments(queries[0]);
+    search_server.FindTopDocuments(queries[1]);
+    search_server.FindTopDocuments(queries[0]);
+    search_server.FindTopDocuments(queries[2]);
+    ASSERT_EQUAL(small_cache->GetStats().hits, 1u);
+    ASSERT_EQUAL(small_cache->GetStats().size, 2u);
+    search_server.FindTopDocuments(queries[0]);
+    ASSERT_EQUAL(small_cache->GetStats().hits, 2u);
+    search_server.FindTopDocuments(queries[1]);
+    ASSERT_EQUAL(small_cache->GetStats().hits, 2u);
+    ASSERT_EQUAL(small_cache->GetStats().misses, 4u);
+
+    // a late result of an older generation doesn't replace the newer one, a result of the same
+    // or a newer generation does
+    QueryResultCache generation_cache(4, 1);
+    const std::vector<Document> old_documents = {Document(1, 0.5, 1)};
+    const std::vector<Document> new_documents = {Document(2, 0.7, 2), Document(3, 0.1, 3)};
+    generation_cache.Insert("key"s, 5, new_documents);
+    generation_cache.Insert("key"s, 4, old_documents);
+    ASSERT(!generation_cache.Find("key"s, 4));
+    ASSERT_EQUAL(generation_cache.Find("key"s, 5).value(), new_documents);
+    generation_cache.Insert("key"s, 5, old_documents);
+    ASSERT_EQUAL(generation_cache.Find("key"s, 5).value(), old_documents);
+    generation_cache.Insert("key"s, 6, new_documents);
+    ASSERT(!generation_cache.Find("key"s, 5));
+    ASSERT_EQUAL(generation_cache.Find("key"s, 6).value(), new_documents);
+    ASSERT_EQUAL(generation_cache.GetStats().size, 1u);
+    std::cerr << "TestQueryResultCache - OK\n";
+}
+
+template <typename ExecutionPolicy>
+void BenchmarkAddDocumentsParalley(std::string_view mark, const std::string& stop_words, const std::vector<RawDocument>& documents, ExecutionPolicy&& policy) {
+    LOG_DURATION(mark);
+    SearchServer search_server(stop_words);
+    const IndexingStats stats = search_server.AddDocuments(policy, documents);
+    std::cerr << mark << ": "s << static_cast<int>(stats.documents_per_second) << " documents/s"s << std::endl;
+    std::cout << search_server.GetDocumentCount() << " documents\n";
+}
+
+#define BENCHMARK_ADD_DOCUMENTS_PARALLEY(policy) BenchmarkAddDocumentsParalley(#policy, dictionary[0], raw_documents, std::execution::policy)
+
+void BenchmarkAddDocumentsParalley() {
+    std::mt19937 generator;
+    const auto dictionary = GenerateDictionary(generator, 1000, 10);
+    const auto documents = GenerateQueries(generator, dictionary, 10'000, 70);
+    std::vector<RawDocument> raw_documents;
+    for (size_t i = 0; i < documents.size(); ++i) {
+        raw_documents.push_back({static_cast<int>(i), documents[i], DocumentStatus::ACTUAL, {1, 2, 3}});
+    }
+
+    BENCHMARK_ADD_DOCUMENTS_PARALLEY(seq);
+    BENCHMARK_ADD_DOCUMENTS_PARALLEY(par);
+}
+
+void TestAddDocumentsParalley() {
+    std::mt19937 generator;
+    const auto dictionary = GenerateDictionary(generator, 1000, 10);
+    const auto documents = GenerateQueries(generator, dictionary, 2'000, 70);
+    const auto queries = GenerateQueries(generator, dictionary, 50, 10);
+    std::vector<RawDocument> raw_documents;
+    SearchServer expected_server(dictionary[0]);
+    for (size_t i = 0; i < documents.size(); ++i) {
+        const DocumentStatus status = static_cast<DocumentStatus>(i % 4);
+        const std::vector<int> ratings = {static_cast<int>(i % 5), 3};
+        // ids out of order, the ordinals follow the order of the batch
+        const int document_id = static_cast<int>((i * 7919) % documents.size());
+        raw_documents.push_back({document_id, documents[i], status, ratings});
+        expected_server.AddDocument(document_id, documents[i], status, ratings);
+    }
+
+    SearchServer seq_server(dictionary[0]);
+    seq_server.AddDocuments(std::execution::seq, raw_documents);
+    SearchServer par_server(dictionary[0]);
+    par_server.AddDocuments(std::execution::par, raw_documents);
+    for (const SearchServer* search_server : {&seq_server, &par_server}) {
+        ASSERT_EQUAL(search_server->GetDocumentCount(), expected_server.GetDocumentCount());
+        ASSERT(std::equal(search_server->begin(), search_server->end(), expected_server.begin(), expected_server.end()));
+        for (const int document_id : expected_server) {
+            const WordFrequencies expected = expected_server.GetWordFrequencies(document_id);
+            const WordFrequencies actual = search_server->GetWordFrequencies(document_id);
+            ASSERT(std::equal(actual.begin(), actual.end(), expected.begin(), expected.end()));
+        }
+        for (const std::string& query : queries) {
+            ASSERT_EQUAL_HINT(search_server->FindTopDocuments(query, DocumentStatus::BANNED),
+                    expected_server.FindTopDocuments(query, DocumentStatus::BANNED), query);
+        }
+    }
+
+    // a rejected batch leaves the server as it was
+    try {
+        seq_server.AddDocuments({{static_cast<int>(documents.size()), "new document"s, DocumentStatus::ACTUAL, {1}},
+                                 {0, "present id"s, DocumentStatus::ACTUAL, {1}}});
+        ASSERT_HINT(false, "present id accepted"s);
+    } catch (const std::invalid_argument&) {
+    }
+    ASSERT_EQUAL(seq_server.GetDocumentCount(), expected_server.GetDocumentCount());
+    std::cerr << "TestAddDocumentsParalley - OK\n";
+}
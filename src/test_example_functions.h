@@ -6,6 +6,75 @@
 
 #include "search_server.h"
 
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+
+// Documents are equal if their ids and ratings are, and relevances differ by less than EPS
+bool operator==(const Document& lhs, const Document& rhs);
+
+bool operator!=(const Document& lhs, const Document& rhs);
+
+std::ostream& operator<<(std::ostream& output, DocumentStatus status);
+
+template <typename Element>
+std::ostream& operator<<(std::ostream& output, const std::vector<Element>& elements);
+
+template <typename... Elements>
+std::ostream& operator<<(std::ostream& output, const std::tuple<Elements...>& elements);
+
+template <typename Element>
+std::ostream& operator<<(std::ostream& output, const std::vector<Element>& elements) {
+    output << '[';
+    bool is_first = true;
+    for (const Element& element : elements) {
+        output << (is_first ? "" : ", ") << element;
+        is_first = false;
+    }
+    return output << ']';
+}
+
+template <typename... Elements>
+std::ostream& operator<<(std::ostream& output, const std::tuple<Elements...>& elements) {
+    output << '(';
+    std::apply([&output](const auto&... element) {
+        bool is_first = true;
+        ((output << (is_first ? "" : ", ") << element, is_first = false), ...);
+    }, elements);
+    return output << ')';
+}
+
+template <typename T, typename U>
+void AssertEqualImpl(const T& t, const U& u, const std::string& t_str, const std::string& u_str, const std::string& file,
+                     const std::string& func, unsigned line, const std::string& hint) {
+    if (t != u) {
+        std::cerr << std::boolalpha;
+        std::cerr << file << "(" << line << "): " << func << ": ";
+        std::cerr << "ASSERT_EQUAL(" << t_str << ", " << u_str << ") failed: ";
+        std::cerr << t << " != " << u << ".";
+        if (!hint.empty()) {
+            std::cerr << " Hint: " << hint;
+        }
+        std::cerr << std::endl;
+        std::abort();
+    }
+}
+
+#define ASSERT_EQUAL(a, b) AssertEqualImpl((a), (b), #a, #b, __FILE__, __FUNCTION__, __LINE__, "")
+
+#define ASSERT_EQUAL_HINT(a, b, hint) AssertEqualImpl((a), (b), #a, #b, __FILE__, __FUNCTION__, __LINE__, (hint))
+
+void AssertImpl(bool value, const std::string& expr_str, const std::string& file, const std::string& func, unsigned line,
+                const std::string& hint);
+
+#define ASSERT(expr) AssertImpl(!!(expr), #expr, __FILE__, __FUNCTION__, __LINE__, "")
+
+#define ASSERT_HINT(expr, hint) AssertImpl(!!(expr), #expr, __FILE__, __FUNCTION__, __LINE__, (hint))
+
 
 void AddDocument(SearchServer& search_server, int document_id, const std::string& document, DocumentStatus status,
                  const std::vector<int>& ratings);
@@ -16,14 +85,63 @@ void MatchDocuments(SearchServer& search_server, const std::string& query);
 
 void TestRemoveDuplicates();
 
+void TestScanWords();
+
+void TestStopWordSet();
+
+void TestFindDuplicates();
+
 void TestRequest();
 
+void TestConcurrentRequestQueue();
+
+void TestMetricsRegistry();
+
 void TestGetDocumentCount();
 
 void TestProcessQueries();
 
+void TestProcessQueryStream();
+
+void TestThreadPool();
+
 void TestRemoveDocumentParalley();
 
+void TestRemoveDocuments();
+
 void TestMatchDocumentParalley();
 
+void TestMatchDocuments();
+
+void TestPreparedQuery();
+
+void TestFindTopDocumentsParalley();
+
+void TestAddDocumentsParalley();
+
+void TestFindTopDocumentsPruned();
+
+void TestShardedSearchServer();
+
+void TestPostingList();
+
+void TestScoreAccumulator();
+
+void TestForwardIndexMove();
+
+void TestInverseDocumentFreq();
+
+void TestSaveLoadIndex();
+
+void TestMutationLog();
+
+void TestConcurrentSearchServer();
+
+void TestQueryResultCache();
+
+// Timings of the sequential and parallel versions, not a part of the tests
+void BenchmarkFindTopDocumentsParalley();
+
+void BenchmarkAddDocumentsParalley();
+
 void MyTest();
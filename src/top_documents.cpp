@@ -0,0 +1,50 @@
+#include "top_documents.h"
+
+#include <algorithm>
+#include <limits>
+
+
+TopDocuments::TopDocuments(size_t limit, size_t offset)
+    : capacity_(limit > std::numeric_limits<size_t>::max() - offset ? std::numeric_limits<size_t>::max() : limit + offset)
+    , offset_(offset) {
+}
+
+void TopDocuments::Push(const Document& document) {
+    if (capacity_ == 0) {
+        return;
+    }
+    if (heap_.size() < capacity_) {
+        heap_.push_back(document);
+        std::push_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+        return;
+    }
+    if (IsMoreRelevant(document, heap_.front())) {
+        std::pop_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+        heap_.back() = document;
+        std::push_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+    }
+}
+
+void TopDocuments::Merge(const TopDocuments& other) {
+    for (const Document& document : other.heap_) {
+        Push(document);
+    }
+}
+
+bool TopDocuments::IsFull() const {
+    return !heap_.empty() && heap_.size() == capacity_;
+}
+
+const Document& TopDocuments::GetWorst() const {
+    return heap_.front();
+}
+
+std::vector<Document> TopDocuments::Extract() {
+    std::sort_heap(heap_.begin(), heap_.end(), IsMoreRelevant);
+    std::vector<Document> result;
+    if (heap_.size() > offset_) {
+        result.assign(heap_.begin() + offset_, heap_.end());
+    }
+    heap_.clear();
+    return result;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include "document.h"
+
+#include <vector>
+
+
+// Selects the most relevant documents of a stream in O(M log K):
+// the bounded heap keeps the worst of the selected documents on top.
+class TopDocuments {
+public:
+    // Keeps offset + limit documents, the first offset of them are dropped by Extract()
+    TopDocuments(size_t limit, size_t offset = 0);
+
+    void Push(const Document& document);
+
+    // A full collection keeps a document only if it is more relevant than the worst
+    // one; a collection which keeps no documents at all is never full
+    bool IsFull() const;
+
+    // Pushes the documents kept by other, which must have the same limit and offset
+    void Merge(const TopDocuments& other);
+
+    // The least relevant of the kept documents, the collection must not be empty
+    const Document& GetWorst() const;
+
+    // Kept documents ordered by IsMoreRelevant without the first offset of them
+    std::vector<Document> Extract();
+
+private:
+    size_t capacity_;
+    size_t offset_;
+    std::vector<Document> heap_;
+};